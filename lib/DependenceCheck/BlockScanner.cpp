@@ -0,0 +1,85 @@
+// Author: Markus Kusano
+//
+// See BlockScanner.h for more information
+
+#include "BlockScanner.h"
+
+#include "llvm/IR/IntrinsicInst.h"
+
+BlockScanner::BlockScanner(AliasAnalysis &AA) : AA_(AA) { }
+
+void BlockScanner::reset() {
+  table_.clear();
+}
+
+BlockScanner::Entry *BlockScanner::find(const AliasAnalysis::Location &Loc) {
+  for (auto i = table_.begin(), e = table_.end(); i != e; ++i) {
+    if (i->Loc.Ptr == Loc.Ptr && i->Loc.Size == Loc.Size
+        && i->Loc.TBAATag == Loc.TBAATag)
+      return &*i;
+  }
+  return NULL;
+}
+
+void BlockScanner::clobber(Instruction *I,
+    const AliasAnalysis::Location *Loc) {
+  for (unsigned i = table_.size(); i-- > 0; ) {
+    bool keep;
+    if (Loc != NULL)
+      keep = AA_.alias(*Loc, table_[i].Loc) == AliasAnalysis::NoAlias;
+    else
+      keep = AA_.getModRefInfo(I, table_[i].Loc) == AliasAnalysis::NoModRef;
+    if (!keep)
+      table_.erase(table_.begin() + i);
+  }
+}
+
+bool BlockScanner::scan(Instruction *I, MemDepResult &Result) {
+  LoadInst *LI = dyn_cast<LoadInst>(I);
+  StoreInst *SI = dyn_cast<StoreInst>(I);
+
+  // MemoryDependenceAnalysis treats these specially (e.g., a lifetime
+  // start is the Def of the memory it covers); start over after them
+  if ((LI && !LI->isUnordered()) || (SI && !SI->isUnordered())) {
+    reset();
+    return false;
+  }
+  if (IntrinsicInst *II = dyn_cast<IntrinsicInst>(I)) {
+    switch (II->getIntrinsicID()) {
+      case Intrinsic::lifetime_start:
+      case Intrinsic::lifetime_end:
+      case Intrinsic::invariant_start:
+      case Intrinsic::invariant_end:
+        reset();
+        return false;
+      default:
+        break;
+    }
+  }
+
+  if (LI == NULL && SI == NULL) {
+    clobber(I, NULL);
+    return false;
+  }
+
+  AliasAnalysis::Location loc = LI ? AA_.getLocation(LI) : AA_.getLocation(SI);
+
+  // Nothing since the entry may access loc, so the backward scan of
+  // MemoryDependenceAnalysis stops at the entry: a must-aliased load or
+  // store is the Def of both loads and stores. Accesses to constant memory
+  // are left to MemoryDependenceAnalysis (stores ignore loads of it).
+  bool known = false;
+  if (Entry *E = find(loc)) {
+    if (!AA_.pointsToConstantMemory(loc)) {
+      Result = MemDepResult::getDef(E->Inst);
+      known = true;
+    }
+  }
+
+  clobber(I, &loc);
+  if (table_.size() == MaxLocations)
+    table_.erase(table_.begin());
+  Entry e = { loc, I };
+  table_.push_back(e);
+  return known;
+}
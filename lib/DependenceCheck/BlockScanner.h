@@ -0,0 +1,76 @@
+// Author: Markus Kusano
+//
+// Forward scanner finding local dependencies of loads and stores in a
+// single pass over each basic block.
+//
+// MemoryDependenceAnalysis::getDependency() scans backwards from each
+// query, so a block with n memory instructions can cost O(n^2) alias
+// queries. The scanner walks the block forwards once and keeps a small
+// table of the most recent load or store of each location (same pointer,
+// size and TBAA tag). A later access to exactly the same location depends
+// on that instruction (a Def, as MemoryDependenceAnalysis reports it) as
+// long as nothing in between may touch the location. Every memory
+// instruction is checked against the entries of the table and removes the
+// ones it may alias (or read or write, for calls), so the cost is at most
+// MaxLocations alias queries per instruction.
+//
+// The scanner only answers when it is sure of the result MemoryDependence
+// Analysis would give; everything else (no entry, calls, va_arg, free(),
+// atomic and volatile accesses, and all non-local results) is left to
+// MemoryDependenceAnalysis.
+//
+//  BlockScanner S(AA);
+//  for each block BB:
+//    S.reset();
+//    for each memory instruction I in BB, in order:
+//      MemDepResult R;
+//      if (!S.scan(I, R))
+//        R = MDA.getDependency(I);
+
+#ifndef BLOCK_SCANNER_H
+#define BLOCK_SCANNER_H
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/IR/Instruction.h"
+
+using namespace llvm;
+
+class BlockScanner {
+  public:
+    // Size of the location table. When it is full the oldest entry is
+    // dropped.
+    static const unsigned MaxLocations = 8;
+
+    explicit BlockScanner(AliasAnalysis &AA);
+
+    // Clears the table. Must be called at the start of every block.
+    void reset();
+
+    // Processes the next memory instruction I of the current block. Returns
+    // true and sets Result to the local dependence of I if it is known.
+    // Every memory instruction of the block must be passed, in order, even
+    // those whose dependence is calculated elsewhere.
+    bool scan(Instruction *I, MemDepResult &Result);
+
+  private:
+    struct Entry {
+      AliasAnalysis::Location Loc;
+      Instruction *Inst;
+    };
+
+    AliasAnalysis &AA_;
+
+    // Most recent access of each location, oldest first
+    SmallVector<Entry, MaxLocations> table_;
+
+    // Returns the entry of exactly Loc in table_, or NULL
+    Entry *find(const AliasAnalysis::Location &Loc);
+
+    // Removes the entries I may access. Loc is the location accessed by the
+    // load or store I; NULL for other instructions.
+    void clobber(Instruction *I, const AliasAnalysis::Location *Loc);
+};
+
+#endif // BLOCK_SCANNER_H
@@ -4,12 +4,63 @@
  * See ControlDependences.h for more information
  */
 
+#define DEBUG_TYPE "depcheck"
 #include "ControlDependence.h"
+#include "DepTimers.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/TimeValue.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cctype>
+#include <set>
 #include <vector>
 
 // Enable debugging to stderr
-#define MK_DEBUG
+//#define MK_DEBUG
+
+STATISTIC(NumNonPDomEdges, "Number of CFG edges in the set S");
+STATISTIC(NumPDTSteps, "Number of post-dominator tree steps walked");
+STATISTIC(NumFrontierEntries, "Number of reverse dominance frontier entries");
+STATISTIC(NumCDEdges, "Number of control dependence edges");
+STATISTIC(NumCDBranches, "Number of control dependence branches");
+STATISTIC(NumCDRegions, "Number of control dependence regions");
+STATISTIC(NumCDRegionEdges, "Number of controller to region edges");
+STATISTIC(NumDenseControllers, "Number of controllers with dense sets");
+
+// Orders CDBranches by dependent, controller and successor
+static bool branchLess(const CDBranch &A, const CDBranch &B) {
+  if (A.Dependent != B.Dependent)
+    return A.Dependent < B.Dependent;
+  if (A.Controller != B.Controller)
+    return A.Controller < B.Controller;
+  return A.Successor < B.Successor;
+}
+
+static bool branchEqual(const CDBranch &A, const CDBranch &B) {
+  return A.Dependent == B.Dependent && A.Controller == B.Controller
+    && A.Successor == B.Successor;
+}
+
+// Orders CDBranches and CDConditions by controller and successor only
+template <typename T>
+static bool conditionLess(const T &A, const T &B) {
+  if (A.Controller != B.Controller)
+    return A.Controller < B.Controller;
+  return A.Successor < B.Successor;
+}
+
+template <typename T, typename U>
+static bool conditionEqual(const T &A, const U &B) {
+  return A.Controller == B.Controller && A.Successor == B.Successor;
+}
 
 // From Ferrante et al. the algorithm for obtaining control dependency
 // information is:
@@ -33,22 +84,408 @@
 // tree until we reach A's parent (if it exists). We mark every node as control
 // dependent on A.
 
+ControlDependence::ControlDependence() {
+  engine_ = Ferrante;
+  pendingSEdges_ = 0;
+  pendingSteps_ = 0;
+}
+
+void ControlDependence::setEngine(Engine E) {
+  engine_ = E;
+}
+
+ControlDependence::Engine ControlDependence::getEngine() const {
+  return engine_;
+}
+
 void ControlDependence::getControlDependencies(Function &F, PostDominatorTree &PDT) {
-  // All edges in the CFG (A->B) such that B does not post-dominate A
-  vector<CFGEdge> S;
+  getControlDependencies(F, *PDT.DT);
+}
+
+void ControlDependence::getControlDependencies(Function &F,
+    DominatorTreeBase<BasicBlock> &PDT) {
+  sys::TimeValue start = sys::TimeValue::now();
+  pendingSEdges_ = 0;
+  pendingSteps_ = 0;
 
-  S = getNonPDomEdges(F, PDT);
+  if (engine_ == Frontier) {
+    updateFromFrontiers(F, PDT);
+  }
+  else {
+    // All edges in the CFG (A->B) such that B does not post-dominate A
+    vector<CFGEdge> S;
+
+    S = getNonPDomEdges(F, PDT);
+    pendingSEdges_ = S.size();
 
 #ifdef MK_DEBUG
-  errs() << "[DEBUG] Size of set S: " << S.size() << '\n';
+    errs() << "[DEBUG] Size of set S: " << S.size() << '\n';
 #endif
 
-  updateControlDependencies(S, PDT);
+    updateControlDependencies(S, PDT);
+  }
 
+  buildCompactCDG(F);
+  functionCDGs_[functionIndex_.lookup(&F)].buildMicros_ =
+    (sys::TimeValue::now() - start).usec();
+}
+
+bool ControlDependence::verify(Function &F,
+    DominatorTreeBase<BasicBlock> &PDT) const {
+  const CompactCDG *cdg = getCompactCDG(&F);
+  assert(cdg && "function was not analyzed");
+
+  ControlDependence ref;
+  ref.setEngine(engine_ == Ferrante ? Frontier : Ferrante);
+  ref.getControlDependencies(F, PDT);
+  const CompactCDG *refCDG = ref.getCompactCDG(&F);
+
+  // Both CDGs number the blocks and regions in function order and sort
+  // their rows, so equal dependencies have equal arrays. Everything else is
+  // derived from the regions and their conditions.
+  if (cdg->regionOf_ != refCDG->regionOf_
+      || cdg->conditionOffsets_ != refCDG->conditionOffsets_)
+    return false;
+  return std::equal(cdg->conditions_.begin(), cdg->conditions_.end(),
+      refCDG->conditions_.begin(), conditionEqual<CDCondition, CDCondition>);
+}
+
+void ControlDependence::buildCompactCDG(Function &F) {
+  CompactCDG cdg;
+  cdg.F_ = &F;
+
+  // Number the blocks in function order
+  for (auto BBi = F.begin(), BBe = F.end(); BBi != BBe; ++BBi) {
+    BasicBlock *BB = &(*BBi);
+    cdg.ids_[BB] = cdg.blocks_.size();
+    cdg.blocks_.push_back(BB);
+  }
+  unsigned numBlocks = cdg.blocks_.size();
+  cdg.structureHash_ = hashBlockStructure(F);
+
+  // The CFG edges, to check the CDG against the CFG before reuse
+  cdg.succOffsets_.reserve(numBlocks + 1);
+  cdg.succOffsets_.push_back(0);
+  for (unsigned i = 0; i < numBlocks; ++i) {
+    const TerminatorInst *T = cdg.blocks_[i]->getTerminator();
+    if (T == NULL)
+      cdg.succTargets_.push_back(CompactCDG::NoTerminator);
+    for (unsigned s = 0; T && s < T->getNumSuccessors(); ++s)
+      cdg.succTargets_.push_back(cdg.ids_.lookup(T->getSuccessor(s)));
+    cdg.succOffsets_.push_back(cdg.succTargets_.size());
+  }
+  cdg.numSEdges_ = pendingSEdges_;
+  cdg.numWalkSteps_ = pendingSteps_;
+  pendingSEdges_ = 0;
+  pendingSteps_ = 0;
+
+  // The graph is built from the branches recorded by the engine. Sorting
+  // them by dependent gives the conditions of each block, sorted by
+  // controller and successor.
+  vector<CDBranch> branches;
+  branches.reserve(pendingBranches_.size());
+  for (auto j = pendingBranches_.begin(), ej = pendingBranches_.end();
+      j != ej; ++j) {
+    // The virtual root of the post-dominator tree has no block
+    if (j->Dependent == NULL)
+      continue;
+
+    CDBranch b;
+    bool found = cdg.getId(j->Controller, b.Controller)
+      && cdg.getId(j->Dependent, b.Dependent)
+      && cdg.getId(j->Successor, b.Successor);
+    assert(found && "control dependence crosses function boundary");
+    (void)found;
+    branches.push_back(b);
+  }
+  vector<BlockBranch>().swap(pendingBranches_);
+
+  std::sort(branches.begin(), branches.end(), branchLess);
+  branches.erase(std::unique(branches.begin(), branches.end(), branchEqual),
+      branches.end());
+
+  vector<unsigned> rowOffsets(numBlocks + 1, 0);
+  for (auto j = branches.begin(), ej = branches.end(); j != ej; ++j)
+    ++rowOffsets[j->Dependent + 1];
+  for (unsigned i = 0; i < numBlocks; ++i)
+    rowOffsets[i + 1] += rowOffsets[i];
+
+  // Group the blocks with equal rows: after sorting the blocks by their
+  // rows equal rows are adjacent
+  auto rowLess = [&](unsigned A, unsigned B) {
+    return std::lexicographical_compare(
+        branches.begin() + rowOffsets[A], branches.begin() + rowOffsets[A + 1],
+        branches.begin() + rowOffsets[B], branches.begin() + rowOffsets[B + 1],
+        conditionLess<CDBranch>);
+  };
+  auto rowEqual = [&](unsigned A, unsigned B) {
+    return rowOffsets[A + 1] - rowOffsets[A]
+        == rowOffsets[B + 1] - rowOffsets[B]
+      && std::equal(branches.begin() + rowOffsets[A],
+          branches.begin() + rowOffsets[A + 1],
+          branches.begin() + rowOffsets[B],
+          conditionEqual<CDBranch, CDBranch>);
+  };
+
+  vector<unsigned> order(numBlocks);
+  for (unsigned i = 0; i < numBlocks; ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), rowLess);
+
+  // Number the groups by their first block so region IDs follow the
+  // function order. The first block of each sorted group is its smallest.
+  const unsigned NoRegion = ~0u;
+  vector<unsigned> group(numBlocks);
+  vector<unsigned> groupRegion;
+  for (unsigned i = 0; i < numBlocks; ++i) {
+    if (i == 0 || !rowEqual(order[i - 1], order[i]))
+      groupRegion.push_back(NoRegion);
+    group[order[i]] = groupRegion.size() - 1;
+  }
+
+  cdg.regionOf_.resize(numBlocks);
+  vector<unsigned> leaders;
+  for (unsigned i = 0; i < numBlocks; ++i) {
+    unsigned &region = groupRegion[group[i]];
+    if (region == NoRegion) {
+      region = leaders.size();
+      leaders.push_back(i);
+    }
+    cdg.regionOf_[i] = region;
+  }
+  unsigned numRegions = leaders.size();
+
+  // Members of each region
+  cdg.memberOffsets_.assign(numRegions + 1, 0);
+  for (unsigned i = 0; i < numBlocks; ++i)
+    ++cdg.memberOffsets_[cdg.regionOf_[i] + 1];
+  for (unsigned r = 0; r < numRegions; ++r)
+    cdg.memberOffsets_[r + 1] += cdg.memberOffsets_[r];
+  cdg.members_.resize(numBlocks);
+  {
+    vector<unsigned> next(cdg.memberOffsets_.begin(),
+        cdg.memberOffsets_.end() - 1);
+    for (unsigned i = 0; i < numBlocks; ++i)
+      cdg.members_[next[cdg.regionOf_[i]]++] = i;
+  }
+
+  // Conditions and controllers of each region, taken from its first block
+  vector<unsigned> numDependentRegions(numBlocks + 1, 0);
+  cdg.numEdges_ = 0;
+  cdg.numBranches_ = 0;
+  cdg.conditionOffsets_.reserve(numRegions + 1);
+  cdg.controllerOffsets_.reserve(numRegions + 1);
+  for (unsigned r = 0; r < numRegions; ++r) {
+    cdg.conditionOffsets_.push_back(cdg.conditions_.size());
+    cdg.controllerOffsets_.push_back(cdg.controllers_.size());
+
+    unsigned b = leaders[r];
+    for (unsigned j = rowOffsets[b]; j < rowOffsets[b + 1]; ++j) {
+      CDCondition c;
+      c.Controller = branches[j].Controller;
+      c.Successor = branches[j].Successor;
+      cdg.conditions_.push_back(c);
+      if (j == rowOffsets[b] || branches[j - 1].Controller != c.Controller) {
+        cdg.controllers_.push_back(c.Controller);
+        ++numDependentRegions[c.Controller + 1];
+      }
+    }
+
+    unsigned members = cdg.memberOffsets_[r + 1] - cdg.memberOffsets_[r];
+    cdg.numEdges_ += members
+      * (cdg.controllers_.size() - cdg.controllerOffsets_.back());
+    cdg.numBranches_ += members * (rowOffsets[b + 1] - rowOffsets[b]);
+  }
+  cdg.conditionOffsets_.push_back(cdg.conditions_.size());
+  cdg.controllerOffsets_.push_back(cdg.controllers_.size());
+
+  // Controller -> region edges. Filling them in region order keeps the rows
+  // sorted.
+  for (unsigned i = 0; i < numBlocks; ++i)
+    numDependentRegions[i + 1] += numDependentRegions[i];
+  cdg.regionOffsets_ = numDependentRegions;
+  cdg.regionTargets_.resize(cdg.controllers_.size());
+  {
+    vector<unsigned> next(cdg.regionOffsets_.begin(),
+        cdg.regionOffsets_.end() - 1);
+    for (unsigned r = 0; r < numRegions; ++r) {
+      for (unsigned j = cdg.controllerOffsets_[r];
+          j < cdg.controllerOffsets_[r + 1]; ++j)
+        cdg.regionTargets_[next[cdg.controllers_[j]]++] = r;
+    }
+  }
+
+  NumCDEdges += cdg.numEdges_;
+  NumCDBranches += cdg.numBranches_;
+  NumCDRegions += numRegions;
+  NumCDRegionEdges += cdg.regionTargets_.size();
+
+  // Dense sets for the controllers of large functions with many dependents
+  cdg.denseIndex_.assign(numBlocks, CompactCDG::NoDenseSet);
+  if (numBlocks >= CompactCDG::DenseMinBlocks) {
+    for (unsigned i = 0; i < numBlocks; ++i) {
+      unsigned count = 0;
+      ArrayRef<unsigned> regions = cdg.dependentRegions(i);
+      for (auto j = regions.begin(), ej = regions.end(); j != ej; ++j)
+        count += cdg.regionBlocks(*j).size();
+      if (count == 0 || count * CompactCDG::DenseRatio < numBlocks)
+        continue;
+
+      cdg.denseIndex_[i] = cdg.denseSets_.size();
+      cdg.denseSets_.push_back(BitVector(numBlocks));
+      BitVector &set = cdg.denseSets_.back();
+      for (auto j = regions.begin(), ej = regions.end(); j != ej; ++j) {
+        ArrayRef<unsigned> blocks = cdg.regionBlocks(*j);
+        for (auto k = blocks.begin(), ek = blocks.end(); k != ek; ++k)
+          set.set(*k);
+      }
+    }
+  }
+  NumDenseControllers += cdg.denseSets_.size();
+
+  // Replace the CDG if this function has been analyzed before
+  auto fi = functionIndex_.find(&F);
+  if (fi != functionIndex_.end()) {
+    functionCDGs_[fi->second] = cdg;
+    return;
+  }
+  functionIndex_[&F] = functionCDGs_.size();
+  functionCDGs_.push_back(cdg);
+}
+
+void ControlDependence::restoreFunction(Function &F,
+    ArrayRef<unsigned> Offsets, ArrayRef<unsigned> Targets,
+    ArrayRef<CDBranch> Branches) {
+  vector<BasicBlock *> blocks;
+  for (auto BBi = F.begin(), BBe = F.end(); BBi != BBe; ++BBi)
+    blocks.push_back(&(*BBi));
+  assert(Offsets.size() == blocks.size() + 1 && "function changed");
+
+  // The branches hold every dependence; the CSR rows are only checked
+  assert(Targets.size() == Offsets.back() && "malformed control dependencies");
+  (void)Targets;
+
+  pendingBranches_.clear();
+  for (auto j = Branches.begin(), ej = Branches.end(); j != ej; ++j)
+    addBranch(blocks[j->Controller], blocks[j->Dependent],
+        blocks[j->Successor]);
+
+  buildCompactCDG(F);
+}
+
+void ControlDependence::moveFunction(ControlDependence &Other,
+    const Function *F) {
+  auto ofi = Other.functionIndex_.find(F);
+  assert(ofi != Other.functionIndex_.end() && "function was not analyzed");
+  CompactCDG &cdg = Other.functionCDGs_[ofi->second];
+
+  auto fi = functionIndex_.find(F);
+  if (fi != functionIndex_.end()) {
+    functionCDGs_[fi->second].swap(cdg);
+  }
+  else {
+    functionIndex_[F] = functionCDGs_.size();
+    functionCDGs_.push_back(CompactCDG());
+    functionCDGs_.back().swap(cdg);
+  }
+
+  // Leave an empty CDG behind in Other
+  cdg = CompactCDG();
+}
+
+bool ControlDependence::releaseCompactCDG(const Function *F,
+    CompactCDG &Out) {
+  auto fi = functionIndex_.find(F);
+  if (fi == functionIndex_.end())
+    return false;
+  Out.swap(functionCDGs_[fi->second]);
+  invalidate(F);
+  return true;
+}
+
+void ControlDependence::invalidate(const Function *F) {
+  auto fi = functionIndex_.find(F);
+  if (fi == functionIndex_.end())
+    return;
+  unsigned index = fi->second;
+
+  functionCDGs_.erase(functionCDGs_.begin() + index);
+  functionIndex_.erase(fi);
+  for (auto i = functionIndex_.begin(), e = functionIndex_.end(); i != e; ++i) {
+    if (i->second > index)
+      --i->second;
+  }
+}
+
+uint64_t ControlDependence::hashBlockStructure(const Function &F) {
+  DenseMap<const BasicBlock *, unsigned> ids;
+  hash_code h = hash_value(F.size());
+  for (auto BBi = F.begin(), BBe = F.end(); BBi != BBe; ++BBi) {
+    unsigned id = ids.size();
+    ids[&*BBi] = id;
+    h = hash_combine(h, &*BBi);
+  }
+
+  for (auto BBi = F.begin(), BBe = F.end(); BBi != BBe; ++BBi) {
+    const TerminatorInst *T = BBi->getTerminator();
+    if (T == NULL) {
+      h = hash_combine(h, ~0u);
+      continue;
+    }
+    h = hash_combine(h, T->getNumSuccessors());
+    for (unsigned s = 0; s < T->getNumSuccessors(); ++s)
+      h = hash_combine(h, ids.lookup(T->getSuccessor(s)));
+  }
+  return h;
+}
+
+bool ControlDependence::sameBlockStructure(const Function &F) const {
+  const CompactCDG *cdg = getCompactCDG(&F);
+  if (cdg == NULL || cdg->blockStructureHash() != hashBlockStructure(F)
+      || cdg->blocks_.size() != F.size())
+    return false;
+
+  // The hash includes the block pointers, which can be reused after a
+  // block is deleted, so equal hashes are confirmed edge by edge
+  unsigned id = 0;
+  for (auto BBi = F.begin(), BBe = F.end(); BBi != BBe; ++BBi, ++id) {
+    if (cdg->blocks_[id] != &*BBi)
+      return false;
+
+    const unsigned *row = cdg->succTargets_.data() + cdg->succOffsets_[id];
+    unsigned rowSize = cdg->succOffsets_[id + 1] - cdg->succOffsets_[id];
+    const TerminatorInst *T = BBi->getTerminator();
+    if (T == NULL) {
+      if (rowSize != 1 || row[0] != CompactCDG::NoTerminator)
+        return false;
+      continue;
+    }
+    if (rowSize != T->getNumSuccessors())
+      return false;
+    for (unsigned s = 0; s < rowSize; ++s) {
+      unsigned succ;
+      if (!cdg->getId(T->getSuccessor(s), succ) || succ != row[s])
+        return false;
+    }
+  }
+  return true;
+}
+
+const vector<CompactCDG> &ControlDependence::getCompactCDGs() const {
+  return functionCDGs_;
+}
+
+const CompactCDG *ControlDependence::getCompactCDG(const Function *F) const {
+  auto fi = functionIndex_.find(F);
+  if (fi == functionIndex_.end())
+    return NULL;
+  return &functionCDGs_[fi->second];
 }
 
 vector<ControlDependence::CFGEdge> ControlDependence::getNonPDomEdges(
-    Function &F, const PostDominatorTree &PDT) const {
+    Function &F, const DominatorTreeBase<BasicBlock> &PDT) const {
+  TimeRegion T(getPhaseTimer(PhaseGetNonPDomEdges));
+
   std::vector<CFGEdge> S;
   for (auto BBi = F.begin(), BBe = F.end(); BBi != BBe; ++BBi) {
     BasicBlock *A = &(*BBi);
@@ -71,6 +508,7 @@ vector<ControlDependence::CFGEdge> ControlDependence::getNonPDomEdges(
         e.head = B;
         e.tail = A; // head refers to the head of the arrow
         S.push_back(e);
+        ++NumNonPDomEdges;
       }
     }
   }
@@ -79,7 +517,9 @@ vector<ControlDependence::CFGEdge> ControlDependence::getNonPDomEdges(
 }
 
 void ControlDependence::updateControlDependencies(const vector<ControlDependence::CFGEdge> &S, 
-    PostDominatorTree &PDT) {
+    DominatorTreeBase<BasicBlock> &PDT) {
+  TimeRegion T(getPhaseTimer(PhaseUpdateControlDependencies));
+
   BasicBlock *L;
 
   for (vector<CFGEdge>::size_type i = 0; i < S.size(); ++i) {
@@ -131,39 +571,175 @@ void ControlDependence::updateControlDependencies(const vector<ControlDependence
     curNode = domNodeB;
 
     // For an edge (A->B) we are building up the nodes that are control
-    // dependent on A. We only need to do one query of the map to get the set
-    // of nodes dependent on A, add more nodes to it, and then re-insert it
-    // into the map
-    std::set<BasicBlock *> &depSet = controlDeps_[A];
-
-    // Operator[] should return a reference to the value referred to by the key
-    // A. If there is no value then it should insert one and use the default
-    // ctor (emtpy set).
-    //depSet = controlDeps_[A];
-
+    // dependent on A. Duplicates (from other edges of A) are removed when the
+    // compact CDG is built.
     while (curNode != parentA) {
 #ifdef MK_DEBUG
       errs() << "[DEBUG] Iterating up dom tree\n";
 #endif
       // Mark each node visited on our way to the parent of A, but not A's
       // parent, as control dependent on A
-      depSet.insert(curNode->getBlock());
+      addBranch(A, curNode->getBlock(), B);
+      ++NumPDTSteps;
+      ++pendingSteps_;
 
       // Update cur
       curNode = curNode->getIDom();
     } // end while (cur != parentA)
-    // Because std::map::operator[] returns a reference to the set then I
-    // believe we do not need to do any insertions
-#ifdef MK_DEBUG
-    errs() << "[DEBUG] size of depSet: " << depSet.size() << '\n';
-    errs() << "[DEBUG] size of map value: " << controlDeps_[A].size() << '\n';
-    assert(depSet.size() == controlDeps_[A].size() && "map size mis-match");
-#endif
-
   } // end for(vector<>)
 }
 
-void ControlDependence::toDot(std::string name) const {
+void ControlDependence::updateFromFrontiers(Function &F,
+    DominatorTreeBase<BasicBlock> &PDT) {
+  TimeRegion T(getPhaseTimer(PhaseFrontiers));
+
+  DomTreeNode *root = PDT.getRootNode();
+  if (root == NULL)
+    return;
+
+  // Post-order of the post-dominator tree (children before parents)
+  vector<DomTreeNode *> order;
+  {
+    vector<std::pair<DomTreeNode *, DomTreeNode::iterator> > stack;
+    stack.push_back(std::make_pair(root, root->begin()));
+    while (!stack.empty()) {
+      DomTreeNode *node = stack.back().first;
+      DomTreeNode::iterator &child = stack.back().second;
+      if (child != node->end()) {
+        DomTreeNode *next = *child;
+        ++child;
+        stack.push_back(std::make_pair(next, next->begin()));
+        continue;
+      }
+      order.push_back(node);
+      stack.pop_back();
+    }
+  }
+
+  DenseMap<DomTreeNode *, unsigned> index;
+  for (unsigned i = 0; i < order.size(); ++i)
+    index[order[i]] = i;
+
+  // The reverse dominance frontier of each node, indexed by post-order.
+  // Every entry is a block Y together with the successor of Y through which
+  // the node is reached, so the branch of each dependence is known.
+  typedef std::pair<BasicBlock *, BasicBlock *> FrontierEntry;
+  vector<vector<FrontierEntry> > frontiers(order.size());
+
+  for (unsigned i = 0; i < order.size(); ++i) {
+    DomTreeNode *X = order[i];
+    BasicBlock *XB = X->getBlock();
+    vector<FrontierEntry> &DF = frontiers[i];
+    DenseSet<FrontierEntry> inDF;
+
+    // DF_local: the CFG predecessors not immediately post-dominated by X
+    if (XB != NULL) {
+      for (pred_iterator Pi = pred_begin(XB), Pe = pred_end(XB); Pi != Pe;
+          ++Pi) {
+        DomTreeNode *Y = PDT.getNode(*Pi);
+        if (Y == NULL)
+          continue;
+        FrontierEntry entry(*Pi, XB);
+        if (Y->getIDom() != X && inDF.insert(entry).second)
+          DF.push_back(entry);
+      }
+    }
+
+    // DF_up: the frontiers of the children not immediately post-dominated
+    // by X. The children are never needed again afterwards.
+    for (auto ci = X->begin(), ce = X->end(); ci != ce; ++ci) {
+      vector<FrontierEntry> &childDF = frontiers[index[*ci]];
+      for (auto j = childDF.begin(), ej = childDF.end(); j != ej; ++j) {
+        DomTreeNode *Y = PDT.getNode(j->first);
+        if (Y->getIDom() != X && inDF.insert(*j).second)
+          DF.push_back(*j);
+      }
+      vector<FrontierEntry>().swap(childDF);
+    }
+    NumFrontierEntries += DF.size();
+    pendingSteps_ += DF.size();
+
+    // The virtual root of a function with several exits has no block and
+    // nothing is control dependent on it
+    if (XB == NULL)
+      continue;
+
+    // X is control dependent on every block in its frontier
+    for (auto j = DF.begin(), ej = DF.end(); j != ej; ++j) {
+      BasicBlock *Y = j->first;
+      DomTreeNode *parentY = PDT.getNode(Y)->getIDom();
+
+      // The Ferrante walk skips the edges (Y->B) whose least common ancestor
+      // is the virtual root of the tree, which drops the dependencies of
+      // blocks that Y does not post-dominate when the parent of Y is the
+      // virtual root. Do the same so both engines agree.
+      if (parentY != NULL && parentY->getBlock() == NULL &&
+          !PDT.dominates(Y, XB))
+        continue;
+
+      addBranch(Y, XB, j->second);
+    }
+  }
+}
+
+void ControlDependence::addBranch(BasicBlock *Controller,
+    BasicBlock *Dependent, BasicBlock *Successor) {
+  BlockBranch b;
+  b.Controller = Controller;
+  b.Dependent = Dependent;
+  b.Successor = Successor;
+  pendingBranches_.push_back(b);
+}
+
+namespace {
+  // Output stream adaptor that escapes everything written to it for use in a
+  // double quoted graphviz record label and forwards it to another stream.
+  //
+  // Newlines become \l (left aligned lines) and the characters with a
+  // meaning in record labels are backslash escaped. This is done in a single
+  // pass while the text is written so the label is never built up in memory.
+  class DotEscapeStream : public raw_ostream {
+    public:
+      explicit DotEscapeStream(raw_ostream &out) : out_(out), pos_(0) { }
+
+      ~DotEscapeStream() {
+        flush();
+      }
+
+    private:
+      raw_ostream &out_;
+      uint64_t pos_;
+
+      virtual void write_impl(const char *Ptr, size_t Size) {
+        pos_ += Size;
+
+        // Copy runs of characters that need no escaping in one write
+        const char *run = Ptr;
+        for (const char *c = Ptr, *e = Ptr + Size; c != e; ++c) {
+          switch (*c) {
+            case '\n': case '"': case '\\': case '{': case '}': case '<':
+            case '>': case '|':
+              break;
+            default:
+              continue;
+          }
+          out_.write(run, c - run);
+          if (*c == '\n')
+            out_ << "\\l";
+          else
+            out_ << '\\' << *c;
+          run = c + 1;
+        }
+        out_.write(run, Ptr + Size - run);
+      }
+
+      virtual uint64_t current_pos() const {
+        return pos_;
+      }
+  };
+} // end namespace
+
+void ControlDependence::toDot(std::string name, bool Compact) const {
   if (name.empty()) {
 #ifdef MK_DEBUG
     errs() << "[DEBUG] dot file name is empty\n";
@@ -171,13 +747,7 @@ void ControlDependence::toDot(std::string name) const {
     name = "controldeps.dot";
   }
 
-  // The set of nodes that have already been inserted into the dot file. This
-  // is used so we don't define the same node twice in the file
-  std::set<BasicBlock *> insertedNodes;
-
-  // attempt to open output stream
- // std::ofstream out;
-  //out.open(name, std::ios::out);
+  TimeRegion T(getPhaseTimer(PhaseToDot));
 
   std::string errInfo;
   raw_fd_ostream out(name.c_str(), errInfo);
@@ -192,35 +762,23 @@ void ControlDependence::toDot(std::string name) const {
   out << "digraph \"CDG for " << name << " module\" {\n";
 
 #ifdef MK_DEBUG
-  errs() << "[DEBUG] making dot file controlDeps_.size(): " << controlDeps_.size() << '\n';
+  errs() << "[DEBUG] making dot file functionCDGs_.size(): " << functionCDGs_.size() << '\n';
 #endif
 
-  // create an edge for each dependency
-  for (auto i = controlDeps_.begin(), 
-      ei = controlDeps_.end(); i != ei; ++i) {
-    BasicBlock *tail;
-    tail = i->first;
-
-
-    std::set<BasicBlock *> depSet;
-    depSet = i->second;
-
-    for (auto j = depSet.begin(), ej = depSet.end(); j != ej; ++j) {
-      // In a CDG, Y is a descendent of X iff Y is control dependent on X
-      // everything in the depset in control dependent up tail. So in this case
-      // depset is Y and tail is X. Edges should go from tail -> depset[j]
-      
-      // insert the node if necessary
-      if (insertedNodes.find(*j) == insertedNodes.end()) {
-        // We've never encountered this basicblock before so create a node with
-        // it in the file
-        insertedNodes.insert(*j);
-        insertDotNode(out, *j);
-      }
-
-      // Insert the edge: TODO: I'm not sure if there is a chance the same edge
-      // will be added twice
-      insertDotEdge(out, tail, *j);
+  // create an edge for each dependency, in module order so the file does
+  // not depend on the order the functions were analyzed in. The node names
+  // are prefixed with the index of the function in its module since all the
+  // functions share one graph.
+  if (!functionCDGs_.empty()) {
+    const Module *M = functionCDGs_.front().getFunction()->getParent();
+    unsigned index = 0;
+    for (auto fi = M->begin(), fe = M->end(); fi != fe; ++fi, ++index) {
+      const CompactCDG *cdg = getCompactCDG(&*fi);
+      if (cdg == NULL)
+        continue;
+      std::string prefix;
+      raw_string_ostream(prefix) << "Node" << index << '_';
+      writeDotBody(out, *cdg, prefix, Compact);
     }
   }
 
@@ -231,42 +789,396 @@ void ControlDependence::toDot(std::string name) const {
   out.close();
 }
 
-void ControlDependence::insertDotNode(raw_fd_ostream &out, BasicBlock *node) const {
-  // Use the pointer value to make each node name unique. The label for the
-  // node is the contents of the basicblock
-  out << "Node" << node << " [shape=record, label=\""; 
+void ControlDependence::toDotFiles(const std::string &Dir,
+    const vector<std::string> &Functions, bool Compact) const {
+  TimeRegion T(getPhaseTimer(PhaseToDot));
 
-  // change newlines to \l for left alrignment in graphviz node
-  std::string bbstr;
-  raw_string_ostream bbo(bbstr);
-  bbo << *node;
+  std::set<std::string> selected(Functions.begin(), Functions.end());
 
-  std::size_t hit;
-  hit = bbstr.find('\n');
+  for (auto fi = functionCDGs_.begin(), fe = functionCDGs_.end(); fi != fe;
+      ++fi) {
+    StringRef fname = fi->getFunction()->getName();
+    if (!selected.empty() && selected.count(fname) == 0)
+      continue;
 
-  while (hit != std::string::npos) {
-#ifdef MK_DEBUG
-    errs() << "[DEBUG} \\n found at pos: " << hit << '\n';
-#endif
-    bbstr.erase(hit, 1);
-    bbstr.insert(hit, "\\l");
-    hit = bbstr.find('\n');
+    // Keep the function name file system friendly
+    std::string base = "cdg.";
+    for (auto c = fname.begin(), ce = fname.end(); c != ce; ++c)
+      base += (isalnum(*c) || *c == '.' || *c == '_' || *c == '-') ? *c : '_';
+    base += ".dot";
+
+    SmallString<128> path(Dir);
+    sys::path::append(path, base);
+
+    std::string errInfo;
+    raw_fd_ostream out(path.c_str(), errInfo);
+    if (!errInfo.empty()) {
+      errs() <<  "[Warning] Error opening output file: " << errInfo << '\n';
+      continue;
+    }
+
+    writeDot(out, *fi, Compact);
   }
+}
+
+void ControlDependence::writeDot(raw_ostream &out, const CompactCDG &cdg,
+    bool Compact) {
+  out << "digraph \"CDG for '";
+  out.write_escaped(cdg.getFunction()->getName());
+  out << "' function\" {\n";
+  writeDotBody(out, cdg, "Node", Compact);
+  out << "}\n";
+}
+
+void ControlDependence::writeDotBody(raw_ostream &out, const CompactCDG &cdg,
+    StringRef Prefix, bool Compact) {
+  // The nodes that have already been inserted into the dot file. This is
+  // used so we don't define the same node twice in the file.
+  BitVector insertedNodes(cdg.size());
 
-  // label body to dot file
-  out << bbstr;
+  SmallVector<unsigned, 16> deps;
+  for (unsigned tail = 0; tail < cdg.size(); ++tail) {
+    deps.clear();
+    cdg.dependents(tail, deps);
+    if (deps.empty())
+      continue;
+
+    if (!insertedNodes.test(tail)) {
+      insertedNodes.set(tail);
+      insertDotNode(out, cdg, tail, Prefix, Compact);
+    }
+
+    for (auto j = deps.begin(), ej = deps.end(); j != ej; ++j) {
+      // In a CDG, Y is a descendent of X iff Y is control dependent on X
+      // everything in deps in control dependent up tail. So in this case
+      // deps is Y and tail is X. Edges should go from tail -> deps[j]
+
+      // insert the node if necessary
+      if (!insertedNodes.test(*j)) {
+        // We've never encountered this basicblock before so create a node
+        // with it in the file
+        insertedNodes.set(*j);
+        insertDotNode(out, cdg, *j, Prefix, Compact);
+      }
+
+      // Each edge appears once since the rows of a CompactCDG have no
+      // duplicates
+      insertDotEdge(out, tail, *j, Prefix);
+    }
+  }
+}
+
+void ControlDependence::insertDotNode(raw_ostream &out, const CompactCDG &cdg,
+    unsigned Id, StringRef Prefix, bool Compact) {
+  // Nodes are named by their dense ID. The label for the node is the
+  // contents of the basicblock, or just its name in compact mode
+  out << Prefix << Id << " [shape=record, label=\"";
+
+  BasicBlock *node = cdg.getBlock(Id);
+  {
+    // change newlines to \l for left alignment in graphviz node. The stream
+    // is flushed into out when it goes out of scope.
+    DotEscapeStream label(out);
+    if (!Compact)
+      label << *node;
+    else if (node->hasName())
+      label << node->getName();
+    else
+      label << "<bb " << Id << '>';
+  }
 
   // Close the label and the node
   out << "\"];\n";
 }
 
 
-void ControlDependence::insertDotEdge(raw_fd_ostream &out, BasicBlock *A, BasicBlock *B) const {
-  // Nodes are named by their address
-  out << "Node" << A << "->" << "Node" << B << '\n';
+void ControlDependence::insertDotEdge(raw_ostream &out, unsigned A, unsigned B,
+    StringRef Prefix) {
+  out << Prefix << A << "->" << Prefix << B << '\n';
 }
 
 ControlDependence::CFGEdge::CFGEdge() {
   tail = NULL;
   head = NULL;
 }
+
+CompactCDG::CompactCDG() {
+  F_ = NULL;
+  numEdges_ = 0;
+  numBranches_ = 0;
+  structureHash_ = 0;
+  numSEdges_ = 0;
+  numWalkSteps_ = 0;
+  buildMicros_ = 0;
+}
+
+void CompactCDG::swap(CompactCDG &Other) {
+  std::swap(F_, Other.F_);
+  blocks_.swap(Other.blocks_);
+  ids_.swap(Other.ids_);
+  regionOf_.swap(Other.regionOf_);
+  memberOffsets_.swap(Other.memberOffsets_);
+  members_.swap(Other.members_);
+  conditionOffsets_.swap(Other.conditionOffsets_);
+  conditions_.swap(Other.conditions_);
+  controllerOffsets_.swap(Other.controllerOffsets_);
+  controllers_.swap(Other.controllers_);
+  regionOffsets_.swap(Other.regionOffsets_);
+  regionTargets_.swap(Other.regionTargets_);
+  edgeOffsets_.swap(Other.edgeOffsets_);
+  edges_.swap(Other.edges_);
+  succOffsets_.swap(Other.succOffsets_);
+  succTargets_.swap(Other.succTargets_);
+  std::swap(numEdges_, Other.numEdges_);
+  std::swap(numBranches_, Other.numBranches_);
+  std::swap(structureHash_, Other.structureHash_);
+  std::swap(numSEdges_, Other.numSEdges_);
+  std::swap(numWalkSteps_, Other.numWalkSteps_);
+  std::swap(buildMicros_, Other.buildMicros_);
+  denseIndex_.swap(Other.denseIndex_);
+  denseSets_.swap(Other.denseSets_);
+}
+
+uint64_t CompactCDG::blockStructureHash() const {
+  return structureHash_;
+}
+
+unsigned CompactCDG::numSEdges() const {
+  return numSEdges_;
+}
+
+unsigned CompactCDG::numWalkSteps() const {
+  return numWalkSteps_;
+}
+
+uint64_t CompactCDG::buildMicros() const {
+  return buildMicros_;
+}
+
+size_t CompactCDG::memoryBytes() const {
+  size_t bytes = blocks_.capacity() * sizeof(BasicBlock *)
+    + ids_.getMemorySize()
+    + (regionOf_.capacity() + memberOffsets_.capacity() + members_.capacity()
+        + conditionOffsets_.capacity() + controllerOffsets_.capacity()
+        + controllers_.capacity() + regionOffsets_.capacity()
+        + regionTargets_.capacity() + edgeOffsets_.capacity()
+        + succOffsets_.capacity() + succTargets_.capacity()
+        + denseIndex_.capacity()) * sizeof(unsigned)
+    + conditions_.capacity() * sizeof(CDCondition)
+    + edges_.capacity() * sizeof(CDEdge);
+  for (auto i = denseSets_.begin(), e = denseSets_.end(); i != e; ++i)
+    bytes += (i->size() + 7) / 8;
+  return bytes;
+}
+
+const Function *CompactCDG::getFunction() const {
+  return F_;
+}
+
+unsigned CompactCDG::size() const {
+  return blocks_.size();
+}
+
+unsigned CompactCDG::numEdges() const {
+  return numEdges_;
+}
+
+BasicBlock *CompactCDG::getBlock(unsigned Id) const {
+  assert(Id < blocks_.size() && "block ID out of range");
+  return blocks_[Id];
+}
+
+bool CompactCDG::getId(const BasicBlock *BB, unsigned &Id) const {
+  auto it = ids_.find(BB);
+  if (it == ids_.end())
+    return false;
+  Id = it->second;
+  return true;
+}
+
+void CompactCDG::dependents(unsigned Id,
+    SmallVectorImpl<unsigned> &Deps) const {
+  unsigned first = Deps.size();
+  ArrayRef<unsigned> regions = dependentRegions(Id);
+  for (auto i = regions.begin(), e = regions.end(); i != e; ++i) {
+    ArrayRef<unsigned> blocks = regionBlocks(*i);
+    Deps.append(blocks.begin(), blocks.end());
+  }
+
+  // Every region is sorted but their blocks interleave
+  if (regions.size() > 1)
+    std::sort(Deps.begin() + first, Deps.end());
+}
+
+ArrayRef<unsigned> CompactCDG::controllers(unsigned Id) const {
+  return regionControllers(regionOf(Id));
+}
+
+ArrayRef<CDCondition> CompactCDG::conditions(unsigned Id) const {
+  return regionConditions(regionOf(Id));
+}
+
+unsigned CompactCDG::numBranches() const {
+  return numBranches_;
+}
+
+void CompactCDG::buildEdges() const {
+  unsigned numRegions = this->numRegions();
+  edgeOffsets_.reserve(numRegions + 1);
+  for (unsigned r = 0; r < numRegions; ++r) {
+    edgeOffsets_.push_back(edges_.size());
+    ArrayRef<CDCondition> conds = regionConditions(r);
+    for (auto i = conds.begin(), e = conds.end(); i != e; ++i) {
+      TerminatorInst *T = blocks_[i->Controller]->getTerminator();
+      BasicBlock *succ = blocks_[i->Successor];
+      unsigned first = edges_.size();
+      for (unsigned s = 0, se = T->getNumSuccessors(); s != se; ++s) {
+        if (T->getSuccessor(s) != succ)
+          continue;
+        CDEdge edge;
+        edge.Controller = i->Controller;
+        edge.Index = s;
+        edges_.push_back(edge);
+      }
+      assert(edges_.size() > first && "condition is not a CFG edge");
+      (void)first;
+    }
+  }
+  edgeOffsets_.push_back(edges_.size());
+}
+
+ArrayRef<CDEdge> CompactCDG::controllingEdges(unsigned Id) const {
+  if (edgeOffsets_.empty())
+    buildEdges();
+  unsigned r = regionOf(Id);
+  return ArrayRef<CDEdge>(edges_).slice(edgeOffsets_[r],
+      edgeOffsets_[r + 1] - edgeOffsets_[r]);
+}
+
+ArrayRef<CDEdge> CompactCDG::controllingEdges(const Instruction *I) const {
+  unsigned id;
+  if (!getId(I->getParent(), id))
+    return ArrayRef<CDEdge>();
+  return controllingEdges(id);
+}
+
+TerminatorInst *CompactCDG::getTerminator(const CDEdge &E) const {
+  return getBlock(E.Controller)->getTerminator();
+}
+
+bool CompactCDG::sameConditions(unsigned A, unsigned B) const {
+  return regionOf(A) == regionOf(B);
+}
+
+unsigned CompactCDG::numRegions() const {
+  return memberOffsets_.empty() ? 0 : memberOffsets_.size() - 1;
+}
+
+unsigned CompactCDG::regionOf(unsigned Id) const {
+  assert(Id < regionOf_.size() && "block ID out of range");
+  return regionOf_[Id];
+}
+
+ArrayRef<unsigned> CompactCDG::regionBlocks(unsigned Region) const {
+  assert(Region < numRegions() && "region out of range");
+  return ArrayRef<unsigned>(members_).slice(memberOffsets_[Region],
+      memberOffsets_[Region + 1] - memberOffsets_[Region]);
+}
+
+ArrayRef<unsigned> CompactCDG::regionControllers(unsigned Region) const {
+  assert(Region < numRegions() && "region out of range");
+  return ArrayRef<unsigned>(controllers_).slice(controllerOffsets_[Region],
+      controllerOffsets_[Region + 1] - controllerOffsets_[Region]);
+}
+
+ArrayRef<CDCondition> CompactCDG::regionConditions(unsigned Region) const {
+  assert(Region < numRegions() && "region out of range");
+  return ArrayRef<CDCondition>(conditions_).slice(conditionOffsets_[Region],
+      conditionOffsets_[Region + 1] - conditionOffsets_[Region]);
+}
+
+ArrayRef<unsigned> CompactCDG::dependentRegions(unsigned Id) const {
+  assert(Id + 1 < regionOffsets_.size() && "block ID out of range");
+  return ArrayRef<unsigned>(regionTargets_).slice(regionOffsets_[Id],
+      regionOffsets_[Id + 1] - regionOffsets_[Id]);
+}
+
+unsigned CompactCDG::numRegionEdges() const {
+  return regionTargets_.size();
+}
+
+bool CompactCDG::isDense(unsigned Id) const {
+  assert(Id < denseIndex_.size() && "block ID out of range");
+  return denseIndex_[Id] != NoDenseSet;
+}
+
+bool CompactCDG::isDependent(unsigned Controller, unsigned Dependent) const {
+  if (isDense(Controller)) {
+    assert(Dependent < size() && "block ID out of range");
+    return denseSets_[denseIndex_[Controller]].test(Dependent);
+  }
+  ArrayRef<unsigned> ctrls = controllers(Dependent);
+  return std::binary_search(ctrls.begin(), ctrls.end(), Controller);
+}
+
+void CompactCDG::dependentSet(unsigned Id, BitVector &Set) const {
+  if (Set.size() < size())
+    Set.resize(size());
+
+  if (isDense(Id)) {
+    Set |= denseSets_[denseIndex_[Id]];
+    return;
+  }
+
+  ArrayRef<unsigned> regions = dependentRegions(Id);
+  for (auto i = regions.begin(), e = regions.end(); i != e; ++i) {
+    ArrayRef<unsigned> blocks = regionBlocks(*i);
+    for (auto j = blocks.begin(), ej = blocks.end(); j != ej; ++j)
+      Set.set(*j);
+  }
+}
+
+void CompactCDG::dependentSet(ArrayRef<unsigned> Ids, BitVector &Set) const {
+  if (Set.size() < size())
+    Set.resize(size());
+  for (auto i = Ids.begin(), e = Ids.end(); i != e; ++i)
+    dependentSet(*i, Set);
+}
+
+void CompactCDG::commonDependents(unsigned A, unsigned B,
+    BitVector &Set) const {
+  Set.clear();
+  Set.resize(size());
+  if (isDense(A) && isDense(B)) {
+    Set = denseSets_[denseIndex_[A]];
+    Set &= denseSets_[denseIndex_[B]];
+    return;
+  }
+
+  // Walk the sparse side. The blocks of a region share their controllers
+  // so one test per region is enough.
+  if (isDense(A))
+    std::swap(A, B);
+  ArrayRef<unsigned> regions = dependentRegions(A);
+  for (auto i = regions.begin(), e = regions.end(); i != e; ++i) {
+    ArrayRef<unsigned> blocks = regionBlocks(*i);
+    if (!isDependent(B, blocks.front()))
+      continue;
+    for (auto j = blocks.begin(), ej = blocks.end(); j != ej; ++j)
+      Set.set(*j);
+  }
+}
+
+unsigned CompactCDG::numCommonDependents(unsigned A, unsigned B) const {
+  BitVector common;
+  commonDependents(A, B, common);
+  return common.count();
+}
+
+void CompactCDG::controllerSet(unsigned Id, BitVector &Set) const {
+  if (Set.size() < size())
+    Set.resize(size());
+  ArrayRef<unsigned> ctrls = controllers(Id);
+  for (auto i = ctrls.begin(), e = ctrls.end(); i != e; ++i)
+    Set.set(*i);
+}
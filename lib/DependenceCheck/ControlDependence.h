@@ -6,7 +6,20 @@
  * ``The Program Dependence Graph and Its Use
  * in Optimization'' Ferrante et al. 1987
  *
- * This code currently does not implement region nodes as described in the paper.
+ * Blocks with identical control dependencies are grouped into region nodes
+ * as described in the paper (see CompactCDG).
+ *
+ * Two engines are available. The default (Ferrante) is the algorithm from the
+ * paper above: for every edge (A->B) where B does not post-dominate A, the
+ * post-dominator tree is walked from B up to the parent of A. The second
+ * engine (Frontier) computes the control dependencies as the reverse
+ * dominance frontiers of:
+ *
+ * ``Efficiently Computing Static Single Assignment Form and the Control
+ * Dependence Graph'' Cytron et al. 1991
+ *
+ * in one bottom-up pass over the post-dominator tree. Both produce the same
+ * result; the Ferrante walk is kept as the reference (see verify()).
  *
  * This class requires the PostDominatorTree.
  *
@@ -16,19 +29,269 @@
  * internal data structures with control depenendencies based on the analysis.
  */
 
+#ifndef CONTROL_DEPENDENCE_H
+#define CONTROL_DEPENDENCE_H
+
 #include "llvm/IR/Function.h"
 #include "llvm/Analysis/PostDominators.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
 
-#include <map>
-#include <set>
+#include <stdint.h>
 #include <string>
 
 using namespace llvm;
 
 using std::vector;
-  
+
+// A control dependence together with the CFG edge that creates it: the
+// block Dependent is control dependent on Controller through the branch from
+// Controller to Successor. All three are dense block IDs (see CompactCDG).
+// A dependence has one CDBranch for each such edge (e.g., several cases of a
+// switch).
+struct CDBranch {
+  unsigned Controller;
+  unsigned Dependent;
+  unsigned Successor;
+};
+
+// A CDBranch without its dependent block: the condition "the branch from
+// Controller to Successor is taken". The conditions of a block are the
+// CDBranches whose Dependent is the block.
+struct CDCondition {
+  unsigned Controller;
+  unsigned Successor;
+};
+
+// A CDCondition at the instruction level: the terminator of the block with
+// the ID Controller takes its successor number Index. A condition has one
+// CDEdge for each successor index leading to its successor block (e.g.,
+// several cases of a switch).
+struct CDEdge {
+  unsigned Controller;
+  unsigned Index;
+};
+
+// Compact, read-only control dependence graph (CDG) of a single function.
+//
+// BasicBlocks are numbered densely (0 to size() - 1) in the order they appear
+// in the function. Blocks with the same set of conditions (see CDCondition),
+// i.e., blocks that execute under exactly the same control conditions, share
+// one region node as in Ferrante et al. Regions are numbered densely (0 to
+// numRegions() - 1) in the order of their first block. The entry's region
+// holds the blocks that are not control dependent on anything.
+//
+// The graph is stored over the regions in compressed sparse row (CSR) form:
+//
+//  - regionOf(i) is the region of the block with ID i
+//  - regionBlocks(r) are the blocks of region r, sorted by ID
+//  - regionConditions(r) and regionControllers(r) are the conditions of the
+//    blocks of region r (sorted by controller and successor) and their
+//    unique controllers
+//  - dependentRegions(i) are the regions control dependent on the block
+//    with ID i, sorted by region ID
+//
+// so a block with a large control dependent area, or many blocks with the
+// same conditions, cost one edge per region instead of one per block. Two
+// blocks execute under the same conditions iff they are in the same region.
+//
+// In functions with at least DenseMinBlocks blocks, the dependents of a
+// controller with at least size() / DenseRatio of them are also kept as a
+// BitVector indexed by block ID (see isDense()). The set queries below use
+// these word-parallel sets when they can and fall back to the regions
+// otherwise.
+//
+// Instances are built by ControlDependence after the control dependencies of
+// a function have been calculated and are not modified afterwards.
+class CompactCDG {
+  public:
+    CompactCDG();
+
+    // Exchange the contents of this and Other
+    void swap(CompactCDG &Other);
+
+    // The function this CDG was built for
+    const Function *getFunction() const;
+
+    // Number of BasicBlocks in the function
+    unsigned size() const;
+
+    // Total number of control dependence edges between blocks in the
+    // function (the edges of the graph without regions)
+    unsigned numEdges() const;
+
+    // Returns the BasicBlock with the dense ID Id
+    BasicBlock *getBlock(unsigned Id) const;
+
+    // Sets Id to the dense ID of BB. Returns false if BB is not part of this
+    // CDG's function.
+    bool getId(const BasicBlock *BB, unsigned &Id) const;
+
+    // Appends the IDs of all the blocks control dependent on the block with
+    // the dense ID Id to Deps, sorted by ID.
+    void dependents(unsigned Id, SmallVectorImpl<unsigned> &Deps) const;
+
+    // Returns the IDs of all the blocks the block with the dense ID Id is
+    // control dependent on
+    ArrayRef<unsigned> controllers(unsigned Id) const;
+
+    // Returns the conditions of the block with the dense ID Id
+    ArrayRef<CDCondition> conditions(unsigned Id) const;
+
+    // Total number of CDBranches in the function
+    unsigned numBranches() const;
+
+    // Returns the terminator successors that control the block with the
+    // dense ID Id, sorted by controller and index: the instruction-level
+    // view of conditions(Id). The edges of all the regions are expanded
+    // from the conditions on the first call and kept, one row per region.
+    // The first call must not race with other calls.
+    ArrayRef<CDEdge> controllingEdges(unsigned Id) const;
+
+    // Same as above for the block of I. Returns an empty array if I is not
+    // part of this CDG's function.
+    ArrayRef<CDEdge> controllingEdges(const Instruction *I) const;
+
+    // Returns the terminator of the controller of E
+    TerminatorInst *getTerminator(const CDEdge &E) const;
+
+    // Returns true if the blocks with the IDs A and B are control dependent
+    // on the same branches (they are in the same region)
+    bool sameConditions(unsigned A, unsigned B) const;
+
+    // Region queries (see class comment)
+    unsigned numRegions() const;
+    unsigned regionOf(unsigned Id) const;
+    ArrayRef<unsigned> regionBlocks(unsigned Region) const;
+    ArrayRef<unsigned> regionControllers(unsigned Region) const;
+    ArrayRef<CDCondition> regionConditions(unsigned Region) const;
+    ArrayRef<unsigned> dependentRegions(unsigned Id) const;
+
+    // Number of controller -> region edges
+    unsigned numRegionEdges() const;
+
+    // Functions smaller than this never use dense sets
+    static const unsigned DenseMinBlocks = 1024;
+
+    // A controller uses a dense set if it has at least size() / DenseRatio
+    // dependents, i.e., when the set is no larger than the list of IDs
+    static const unsigned DenseRatio = 32;
+
+    // Returns true if the dependents of the block with ID Id are kept as a
+    // dense set
+    bool isDense(unsigned Id) const;
+
+    // Returns true if the block with ID Dependent is control dependent on
+    // the block with ID Controller. O(1) for dense controllers, otherwise
+    // O(log(number of controllers of Dependent)).
+    bool isDependent(unsigned Controller, unsigned Dependent) const;
+
+    // Adds the dependents of the block with ID Id to Set (Set |=
+    // dependents). Set is resized to size() bits if it is smaller.
+    void dependentSet(unsigned Id, BitVector &Set) const;
+
+    // Adds the dependents of all the blocks in Ids to Set
+    void dependentSet(ArrayRef<unsigned> Ids, BitVector &Set) const;
+
+    // Sets Set to the blocks control dependent on both A and B
+    void commonDependents(unsigned A, unsigned B, BitVector &Set) const;
+
+    // Returns the number of blocks control dependent on both A and B
+    unsigned numCommonDependents(unsigned A, unsigned B) const;
+
+    // Adds the controllers of the block with ID Id to Set
+    void controllerSet(unsigned Id, BitVector &Set) const;
+
+    // Hash of the blocks and CFG edges of the function when this CDG was
+    // built (see ControlDependence::hashBlockStructure()). Only a fast
+    // reject: sameBlockStructure() compares the edges themselves.
+    uint64_t blockStructureHash() const;
+
+    // Cost of building this CDG (see DepTelemetry.h): the size of the set S
+    // (Ferrante engine only), the post-dominator tree steps walked, or
+    // frontier entries for the Frontier engine, and the time taken in
+    // microseconds. All 0 for a restored CDG.
+    unsigned numSEdges() const;
+    unsigned numWalkSteps() const;
+    uint64_t buildMicros() const;
+
+    // Bytes held by the arrays and maps of this CDG
+    size_t memoryBytes() const;
+
+  private:
+    friend class ControlDependence;
+
+    const Function *F_;
+
+    // Dense ID -> BasicBlock
+    vector<BasicBlock *> blocks_;
+
+    // BasicBlock -> Dense ID
+    DenseMap<const BasicBlock *, unsigned> ids_;
+
+    // Block ID -> region
+    vector<unsigned> regionOf_;
+
+    // CSR rows of each region (see class comment)
+    vector<unsigned> memberOffsets_;
+    vector<unsigned> members_;
+    vector<unsigned> conditionOffsets_;
+    vector<CDCondition> conditions_;
+    vector<unsigned> controllerOffsets_;
+    vector<unsigned> controllers_;
+
+    // CSR rows of each block: the regions dependent on it
+    vector<unsigned> regionOffsets_;
+    vector<unsigned> regionTargets_;
+
+    // CSR rows of each region: its CDEdges (see controllingEdges()). Empty
+    // until first used. Only block IDs and successor indices are kept, so
+    // the rows stay valid as long as the block structure does.
+    mutable vector<unsigned> edgeOffsets_;
+    mutable vector<CDEdge> edges_;
+    void buildEdges() const;
+
+    // CSR rows of each block: the IDs of its successors when this CDG was
+    // built (NoTerminator for a block without a terminator)
+    static const unsigned NoTerminator = ~0u;
+    vector<unsigned> succOffsets_;
+    vector<unsigned> succTargets_;
+
+    unsigned numEdges_;
+    unsigned numBranches_;
+    uint64_t structureHash_;
+    unsigned numSEdges_;
+    unsigned numWalkSteps_;
+    uint64_t buildMicros_;
+
+    // Block ID -> index into denseSets_, or NoDenseSet
+    static const unsigned NoDenseSet = ~0u;
+    vector<unsigned> denseIndex_;
+    vector<BitVector> denseSets_;
+};
+
 class ControlDependence {
   public:
+    // Algorithm used to calculate the control dependencies (see the file
+    // comment)
+    enum Engine {
+      Ferrante = 0,
+      Frontier = 1
+    };
+
+    ControlDependence();
+
+    // Select the engine used by getControlDependencies(). The default is
+    // Ferrante.
+    void setEngine(Engine E);
+    Engine getEngine() const;
+
+    // Recalculates the control dependencies of F with the engine that is not
+    // selected and compares them to the compact CDG of F held by this object.
+    // Returns true if both engines agree. F must have been analyzed.
+    bool verify(Function &F, DominatorTreeBase<BasicBlock> &PDT) const;
 
     // An edge in the CFG. This is an edge from tail to head (tail->head). 
     //
@@ -47,26 +310,118 @@ class ControlDependence {
     // update internal data structures with the control dependency information.
     void getControlDependencies(Function &F, PostDominatorTree &PDT);
 
-    // Map from BasicBlock to a set of BasicBlocks.
+    // Same as above but takes the post-dominator tree directly. This can be
+    // used when the tree is built without the pass manager, for example with
     //
-    // The returned set from the map query contains all the basicblocks control
-    // dependent on A
+    //  DominatorTreeBase<BasicBlock> PDT(true);
+    //  PDT.recalculate(F);
     //
-    // This can be used to ask the question: "What is control dependent on the
-    // basicblock A?"
-    std::map<BasicBlock *, std::set<BasicBlock *> > controlDeps_;
+    // Only F is read, so different ControlDependence objects can process
+    // different functions in parallel.
+    void getControlDependencies(Function &F, DominatorTreeBase<BasicBlock> &PDT);
+
+    // Sets the control dependencies of F from CSR arrays and the branches
+    // over the dense block IDs of F (see CompactCDG), replacing any earlier
+    // results of F. Used to restore results calculated elsewhere (e.g.,
+    // loaded from a cache).
+    void restoreFunction(Function &F, ArrayRef<unsigned> Offsets,
+        ArrayRef<unsigned> Targets, ArrayRef<CDBranch> Branches);
+
+    // Drops the control dependencies of F, e.g., after its CFG changed. F
+    // may be deleted already; its blocks are not accessed.
+    void invalidate(const Function *F);
+
+    // Hash of the blocks of F (in order) and the CFG edges between them.
+    // The control dependencies of F only change if this does.
+    static uint64_t hashBlockStructure(const Function &F);
+
+    // Returns true if F has been analyzed and its blocks and CFG edges are
+    // the same as when its compact CDG was built, i.e., the CDG can be
+    // reused after the instructions of F changed. The hashes are compared
+    // first; if they are equal the blocks and the successors of each block
+    // are compared exactly, so a collision never keeps a stale CDG.
+    bool sameBlockStructure(const Function &F) const;
+
+    // Moves the control dependencies of F from Other into this object. F
+    // must have been analyzed by Other. This is used to merge the results of
+    // ControlDependence objects that were filled by different threads.
+    void moveFunction(ControlDependence &Other, const Function *F);
 
-    // Dump the contents of controlDeps_ to a .dot file with the given name. If
-    // name is empty then the name will be "controldeps.dot"
-    void toDot(std::string name) const;
+    // Moves the control dependencies of F into Out and drops them from this
+    // object, as invalidate() does. Returns false (and leaves Out alone) if
+    // F has not been analyzed. Used to release the results of a function
+    // once they have been written.
+    bool releaseCompactCDG(const Function *F, CompactCDG &Out);
+
+    // Compact CDGs of all the functions passed to getControlDependencies(),
+    // in the order they were analyzed. They are the only copy of the
+    // results; everything in them is ordered by dense block ID, never by
+    // pointer, so iterating them gives the same order on every run.
+    //
+    // To ask "what is control dependent on the basicblock A?" use
+    // CompactCDG::dependents().
+    const vector<CompactCDG> &getCompactCDGs() const;
+
+    // Returns the compact CDG of F, or NULL if F has not been analyzed
+    const CompactCDG *getCompactCDG(const Function *F) const;
+
+    // Dump the CDGs of all the functions to a .dot file with the given name,
+    // in the order of the functions in their module. If name is empty then
+    // the name will be "controldeps.dot". With Compact the nodes are labeled
+    // with the block names instead of the full IR.
+    void toDot(std::string name, bool Compact = false) const;
+
+    // Dump the CDG of each function to its own .dot file named
+    // Dir/cdg.<function>.dot. If Functions is not empty only the functions
+    // with these names are written.
+    void toDotFiles(const std::string &Dir,
+        const vector<std::string> &Functions, bool Compact) const;
+
+    // Write the CDG of one function as a complete dot graph to out. The
+    // output is streamed; nothing is buffered per block. Only cdg and its
+    // function are read, so this can be used on a CDG released with
+    // releaseCompactCDG().
+    static void writeDot(raw_ostream &out, const CompactCDG &cdg,
+        bool Compact);
 
   private:
+    // See setEngine()
+    Engine engine_;
+
+    // See getCompactCDGs()
+    vector<CompactCDG> functionCDGs_;
+
+    // Function -> index into functionCDGs_
+    DenseMap<const Function *, unsigned> functionIndex_;
+
+    // The CDBranches found by the engines for the function being analyzed
+    // (Controller, Dependent, Successor)
+    struct BlockBranch {
+      BasicBlock *Controller;
+      BasicBlock *Dependent;
+      BasicBlock *Successor;
+    };
+    vector<BlockBranch> pendingBranches_;
+
+    // Costs of the function being analyzed (see CompactCDG::numSEdges())
+    unsigned pendingSEdges_;
+    unsigned pendingSteps_;
+
+    // Records the branch of a dependence: Dependent is control dependent on
+    // Controller through the edge (Controller->Successor)
+    void addBranch(BasicBlock *Controller, BasicBlock *Dependent,
+        BasicBlock *Successor);
+
+    // Builds the compact CDG of F from pendingBranches_. This must be called
+    // after updateControlDependencies() has processed F.
+    void buildCompactCDG(Function &F);
+
     // Returns the set S as described in Ferrante et al. (see
     // ControlDependence.cpp for a description of the algorithm)
     //
     // This is the set S of CFG edges (A->B) where B does not post dominate A.
     vector<CFGEdge> getNonPDomEdges(Function &F, 
-        const PostDominatorTree &PDT) const ;
+        const DominatorTreeBase<BasicBlock> &PDT) const ;
 
     // Updates class internal control dependency information with the set S
     // (see getNonPDomEdges()) and the PostDominatorTree.
@@ -82,12 +437,35 @@ class ControlDependence {
     // including A and B, should be made control dependent on A. (This case
     // captures loop dependence.)
     void updateControlDependencies(const vector<CFGEdge> &S, 
-        PostDominatorTree &PDT);
+        DominatorTreeBase<BasicBlock> &PDT);
+
+    // Frontier engine: updates class internal control dependency information
+    // with the reverse dominance frontiers of the blocks of F.
+    //
+    // The frontier of each node X is computed from its children in a
+    // post-order walk of the post-dominator tree:
+    //
+    // DF(X) = { Y in preds(X) : ipdom(Y) != X }
+    //         U { Y in DF(Z) : Z child of X, ipdom(Y) != X }
+    //
+    // X is then control dependent on every Y in DF(X). Each frontier is freed
+    // as soon as its parent has been processed.
+    void updateFromFrontiers(Function &F, DominatorTreeBase<BasicBlock> &PDT);
 
 
-    // Inserts a properly formatted .dot (graphviz) node into the raw_fd_ostream 
-    void insertDotNode(raw_fd_ostream &out, BasicBlock *node) const;
+    // Writes the nodes and edges of cdg (without the graph header). Node
+    // names are Prefix followed by the dense block ID.
+    static void writeDotBody(raw_ostream &out, const CompactCDG &cdg,
+        StringRef Prefix, bool Compact);
 
-    // Inserts an edge from A to B (A->B) in dot syntax in the passed raw_fd_ostream
-    void insertDotEdge(raw_fd_ostream &out, BasicBlock *A, BasicBlock *B) const;
+    // Inserts a properly formatted .dot (graphviz) node for the block with
+    // the dense ID Id into the stream
+    static void insertDotNode(raw_ostream &out, const CompactCDG &cdg,
+        unsigned Id, StringRef Prefix, bool Compact);
+
+    // Inserts an edge from A to B (A->B) in dot syntax in the passed stream
+    static void insertDotEdge(raw_ostream &out, unsigned A, unsigned B,
+        StringRef Prefix);
 };
+
+#endif // CONTROL_DEPENDENCE_H
@@ -2,38 +2,209 @@
 //
 // See DataDependencies.h for more information
 
+#define DEBUG_TYPE "depcheck"
 #include "DataDependence.h"
+#include "DepTimers.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/MemoryBuiltins.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/CallSite.h"
 #include "llvm/Support/InstIterator.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <utility>
+
 // Enable debugging output to stderr
 //#define MK_DEBUG
 
+STATISTIC(NumMemInsts, "Number of memory instructions queried");
+STATISTIC(NumLocalDeps, "Number of local dependencies");
+STATISTIC(NumNonLocalQueries, "Number of non-local dependence queries");
+STATISTIC(NumNonLocalResults, "Number of non-local dependence results");
+STATISTIC(MaxNonLocalResults, "Most non-local results of a single query");
+STATISTIC(NumNonLocalBytes, "Bytes used to store non-local results");
+STATISTIC(NumCallQueries, "Number of non-local call dependence queries");
+STATISTIC(NumSharedCallQueries,
+    "Number of non-local call queries answered by an identical call");
+STATISTIC(NumSkippedCallClobbers,
+    "Number of call clobbers skipped using mod/ref summaries");
+STATISTIC(NumTruncatedQueries,
+    "Number of non-local queries over budget recorded as Unknown");
+STATISTIC(NumScannedLocalDeps,
+    "Number of local dependencies found by the forward block scanner");
+
+// Sets Preds to the predecessors of BB, sorted and without duplicates
+static void predecessorSet(BasicBlock *BB,
+    SmallVectorImpl<BasicBlock *> &Preds) {
+  Preds.clear();
+  Preds.append(pred_begin(BB), pred_end(BB));
+  std::sort(Preds.begin(), Preds.end());
+  Preds.erase(std::unique(Preds.begin(), Preds.end()), Preds.end());
+}
+
+// Hash of the predecessor set of the block, the callee and the operands of a
+// call. Calls with equal keys are candidates for sharing their non-local
+// results (see DataDependence::CallBatch).
+static size_t callKey(Instruction *Call, ArrayRef<BasicBlock *> Preds) {
+  hash_code h = hash_combine_range(Preds.begin(), Preds.end());
+  for (auto oi = Call->op_begin(), oe = Call->op_end(); oi != oe; ++oi)
+    h = hash_combine(h, oi->get());
+  return h;
+}
+
 void DataDependence::getDataDependencies(Function &F, MemoryDependenceAnalysis &MDA,
-    AliasAnalysis &AA) {
+    AliasAnalysis &AA, const TargetLibraryInfo *TLI,
+    const ModRefSummaries *Summaries) {
   // Since MemoryDependenceAnalysis is a function pass, we need to pass the
   // function we are looking at to the pass
   //MemoryDependenceAnalysis &MDA = getAnalysis<MemoryDependenceAnalysis>(F);
 
+  FunctionDeps &FD = createFunctionDeps(F);
+  CallBatch calls;
+  Summaries_ = Summaries;
+
+  BlockScanner scanner(AA);
+  BlockScanner *scan = LocalEngine_ == Forward ? &scanner : NULL;
+  BasicBlock *scanBlock = NULL;
+
+  Steps_ = 0;
+  Start_ = sys::TimeValue::now();
+
+  TimeRegion T(getPhaseTimer(PhaseProcessDepResult));
+
+  // Assign the dense IDs first: non-local results can refer to blocks and
+  // instructions anywhere in the function (e.g., across loop back edges)
+  for (auto bi = F.begin(), be = F.end(); bi != be; ++bi) {
+    FD.BlockIds_[&*bi] = FD.Blocks_.size();
+    FD.Blocks_.push_back(&*bi);
+  }
   for (inst_iterator i = inst_begin(F); i != inst_end(F); ++i) {
+    FD.Ids_[&*i] = FD.Insts_.size();
+    FD.Insts_.push_back(&*i);
+  }
+  FD.Local_.resize(FD.Insts_.size());
+  FD.NonLocalOffsets_.reserve(FD.Insts_.size() + 1);
+
+  // The non-local results of an instruction are appended before any
+  // instruction with a higher ID is processed so the CSR offsets are in
+  // order.
+  Scratch_.clear();
+  for (unsigned id = 0; id < FD.Insts_.size(); ++id) {
     Instruction *inst;
-    inst = &*i;
+    inst = FD.Insts_[id];
+
+    FD.NonLocalOffsets_.push_back(Scratch_.size());
 
     // skip non memory accesses
     if (!inst->mayReadFromMemory() && !inst->mayWriteToMemory())
       continue;
 
-    processDepResult(inst, MDA, AA);
+    ++NumMemInsts;
+    ++FD.NumMemInsts_;
+    if (scan && inst->getParent() != scanBlock) {
+      scanBlock = inst->getParent();
+      scan->reset();
+    }
+    processDepResult(FD, id, MDA, AA, TLI, calls, scan);
 
   } // end for (inst_iterator)
+  FD.NonLocalOffsets_.push_back(Scratch_.size());
+
+  // One exactly sized allocation for all the results of F
+  FD.NonLocal_.assign(Scratch_.begin(), Scratch_.end());
+  Scratch_.clear();
+  NumNonLocalBytes += FD.NonLocal_.size() * sizeof(NonLocalDep);
+  Summaries_ = NULL;
+  FD.Micros_ = (sys::TimeValue::now() - Start_).usec();
 }
 
-void DataDependence::processDepResult(Instruction *inst, 
+bool DataDependence::getQueryLocation(Instruction *I, AliasAnalysis &AA,
+    const TargetLibraryInfo *TLI, AliasAnalysis::Location &Loc,
+    bool &IsLoad) {
+  IsLoad = false;
+  if (LoadInst *LI = dyn_cast<LoadInst>(I)) {
+    if (!LI->isUnordered())
+      return false;
+    Loc = AA.getLocation(LI);
+    IsLoad = true;
+  }
+  else if (StoreInst *SI = dyn_cast<StoreInst>(I)) {
+    if (!SI->isUnordered())
+      return false;
+    Loc = AA.getLocation(SI);
+  }
+  else if (VAArgInst *VI = dyn_cast<VAArgInst>(I)) {
+    Loc = AA.getLocation(VI);
+  }
+  else if (isFreeCall(I, TLI)) {
+    Loc = AliasAnalysis::Location(I->getOperand(0));
+  }
+  else {
+    return false;
+  }
+  return true;
+}
+
+MemDepResult DataDependence::skipCallClobbers(MemDepResult R,
+    const AliasAnalysis::Location &Loc, bool IsLoad, BasicBlock *BB,
     MemoryDependenceAnalysis &MDA, AliasAnalysis &AA) {
-  // TODO: This is probably a good place to check of the dependency
-  // information is calculated on-demand
-  MemDepResult Res = MDA.getDependency(inst);
+  // A load is only clobbered by writes; anything else by any access (this
+  // is how MemoryDependenceAnalysis classifies calls)
+  unsigned need = IsLoad ? unsigned(ModRefSummaries::Mod)
+                         : unsigned(ModRefSummaries::ModRef);
+  while (R.isClobber()) {
+    ImmutableCallSite CS(R.getInst());
+    if (!CS || Summaries_->mayAccess(CS, Loc, need, AA))
+      break;
+
+    ++NumSkippedCallClobbers;
+    R = MDA.getPointerDependencyFrom(Loc, IsLoad,
+        BasicBlock::iterator(R.getInst()), BB);
+  }
+  return R;
+}
+
+void DataDependence::appendNonLocal(const FunctionDeps &FD, BasicBlock *BB,
+    MemDepResult R, Value *Address) {
+  DepInfo info = getDepInfo(R);
+
+  unsigned block;
+  bool found = FD.getBlockId(BB, block);
+  assert(found && "non-local result outside of the function");
+  (void)found;
+
+  unsigned depInst = NonLocalDep::NoInst;
+  if (info.DepInst_ != NULL) {
+    found = FD.getId(info.DepInst_, depInst);
+    assert(found && "non-local result outside of the function");
+  }
+
+  Scratch_.push_back(NonLocalDep(block, depInst, info.Type_, Address));
+}
+
+void DataDependence::processDepResult(FunctionDeps &FD, unsigned Id,
+    MemoryDependenceAnalysis &MDA, AliasAnalysis &AA,
+    const TargetLibraryInfo *TLI, CallBatch &Calls, BlockScanner *Scanner) {
+  Instruction *inst;
+  inst = FD.Insts_[Id];
 
+  MemDepResult Res;
+  if (Scanner && Scanner->scan(inst, Res))
+    ++NumScannedLocalDeps;
+  else
+    Res = MDA.getDependency(inst);
+
+  // A skipped call can leave no dependence in the block, in which case the
+  // non-local query below continues in the predecessors
+  AliasAnalysis::Location queryLoc;
+  bool isLoad = false;
+  bool refine = Summaries_ != NULL
+    && getQueryLocation(inst, AA, TLI, queryLoc, isLoad);
+  if (refine && Res.isClobber())
+    Res = skipCallClobbers(Res, queryLoc, isLoad, inst->getParent(), MDA, AA);
 
   if (!Res.isNonLocal()) {
     // local results (not-non-local) can be simply handled. They are just
@@ -51,9 +222,11 @@ void DataDependence::processDepResult(Instruction *inst,
     }
 #endif
 
-    // Save into map
+    // Save the result
     assert(newInfo.valid());
-    LocalDeps_[inst] = newInfo;
+    FD.Local_[Id] = newInfo;
+    ++FD.NumLocal_;
+    ++NumLocalDeps;
   }
   else {
     // Handle NonLocal dependencies. The function call
@@ -67,7 +240,20 @@ void DataDependence::processDepResult(Instruction *inst,
     assert(newInfo.Type_ == NonLocal);
     assert(Res.isNonLocal());
 
-    SmallVector<NonLocalDepResult, 4> NLDep;
+    // Query_ is reused so the results of a query are only copied to
+    // Scratch_, never allocated per instruction
+    SmallVectorImpl<NonLocalDepResult> &NLDep = Query_;
+    NLDep.clear();
+
+    // Calls check the budget themselves once they are known not to share
+    // the results of another call
+    bool isCall = (isa<CallInst>(inst) || isa<InvokeInst>(inst))
+      && !isFreeCall(inst, TLI);
+    if (!isCall && overBudget(inst->getParent())) {
+      truncate(FD, Id);
+      return;
+    }
+
     if (LoadInst *LI = dyn_cast<LoadInst>(inst)) {
       if (!LI->isUnordered()) {
         // FIXME: Handle atomic/volatile loads.
@@ -98,6 +284,16 @@ void DataDependence::processDepResult(Instruction *inst,
       MDA.getNonLocalPointerDependency(Loc, false, VI->getParent(), 
           NLDep);
     } 
+    else if (isFreeCall(inst, TLI)) {
+      // MemoryDependenceAnalysis treats calls to free() as a store to the
+      // whole object
+      AliasAnalysis::Location Loc(inst->getOperand(0));
+      MDA.getNonLocalPointerDependency(Loc, false, inst->getParent(), NLDep);
+    }
+    else if (isa<CallInst>(inst) || isa<InvokeInst>(inst)) {
+      processCallDep(FD, Id, MDA, Calls);
+      return;
+    }
     else {
       llvm_unreachable("Unknown memory instruction!");
     }
@@ -105,12 +301,132 @@ void DataDependence::processDepResult(Instruction *inst,
 #ifdef MK_DEBUG
     errs() << "[DEBUG] NLDep.size() == " << NLDep.size() << '\n';
 #endif
-    for (auto I = NLDep.begin(), E = NLDep.end(); I != E; ++I) {
-      NonLocalDeps_[inst].push_back(*I);
+    ++NumNonLocalQueries;
+    Steps_ += NLDep.size();
+    if (Budget_.MaxQueryResults && NLDep.size() > Budget_.MaxQueryResults) {
+      truncate(FD, Id);
+      return;
     }
+
+    for (auto ri = NLDep.begin(), re = NLDep.end(); ri != re; ++ri) {
+      MemDepResult R = ri->getResult();
+      if (refine && R.isClobber() && ri->getAddress() != NULL) {
+        // The results are for the phi translated address
+        AliasAnalysis::Location loc = queryLoc.getWithNewPtr(ri->getAddress());
+        MemDepResult refined = skipCallClobbers(R, loc, isLoad, ri->getBB(),
+            MDA, AA);
+        if (!refined.isNonLocal())
+          R = refined;
+      }
+      appendNonLocal(FD, ri->getBB(), R, ri->getAddress());
+    }
+    if (!NLDep.empty())
+      ++FD.NumNonLocal_;
+
+    NumNonLocalResults += NLDep.size();
+    if (NLDep.size() > MaxNonLocalResults)
+      MaxNonLocalResults = NLDep.size();
   } // end else
 }
 
+void DataDependence::processCallDep(FunctionDeps &FD, unsigned Id,
+    MemoryDependenceAnalysis &MDA, CallBatch &Calls) {
+  Instruction *inst = FD.Insts_[Id];
+
+  // The non-local results of a call only depend on the callee, the operands
+  // and the predecessors of its block: nothing above the call in its block
+  // depends on it, and the scan continues at the end of each predecessor.
+  // An identical earlier call in a block with the same predecessors (e.g.,
+  // both arms of a diamond) shares its results. An identical call earlier in
+  // the same block never gets here; it is the local result of this one.
+  SmallVector<BasicBlock *, 4> preds, otherPreds;
+  predecessorSet(inst->getParent(), preds);
+  SmallVectorImpl<unsigned> &candidates = Calls[callKey(inst, preds)];
+  for (auto ci = candidates.begin(), ce = candidates.end(); ci != ce; ++ci) {
+    Instruction *other = FD.Insts_[*ci];
+    if (!other->isIdenticalToWhenDefined(inst))
+      continue;
+    predecessorSet(other->getParent(), otherPreds);
+    if (otherPreds != preds)
+      continue;
+
+    // The earlier call has a lower ID so its CSR row is complete. The
+    // results are copied from Scratch_ itself, so reserve before appending.
+    unsigned first = FD.NonLocalOffsets_[*ci];
+    unsigned last = FD.NonLocalOffsets_[*ci + 1];
+    Scratch_.reserve(Scratch_.size() + (last - first));
+    for (unsigned j = first; j < last; ++j)
+      Scratch_.push_back(Scratch_[j]);
+    if (last != first)
+      ++FD.NumNonLocal_;
+
+    ++NumSharedCallQueries;
+    NumNonLocalResults += last - first;
+    return;
+  }
+
+  if (overBudget(inst->getParent())) {
+    truncate(FD, Id);
+    return;
+  }
+
+  // Call results have no address; they are stored with a NULL address
+  const MemoryDependenceAnalysis::NonLocalDepInfo &deps =
+    MDA.getNonLocalCallDependency(CallSite(inst));
+  ++NumCallQueries;
+  Steps_ += deps.size();
+  if (Budget_.MaxQueryResults && deps.size() > Budget_.MaxQueryResults) {
+    truncate(FD, Id);
+    return;
+  }
+
+  // Only calls with complete results are shared
+  candidates.push_back(Id);
+  for (auto di = deps.begin(), de = deps.end(); di != de; ++di)
+    appendNonLocal(FD, di->getBB(), di->getResult(), NULL);
+  if (!deps.empty())
+    ++FD.NumNonLocal_;
+
+  NumNonLocalResults += deps.size();
+  if (deps.size() > MaxNonLocalResults)
+    MaxNonLocalResults = deps.size();
+}
+
+bool DataDependence::overBudget(BasicBlock *BB) const {
+  if (Budget_.MaxFunctionSteps && Steps_ >= Budget_.MaxFunctionSteps)
+    return true;
+  if (Budget_.MaxFunctionMillis
+      && (sys::TimeValue::now() - Start_).msec() >= Budget_.MaxFunctionMillis)
+    return true;
+  if (Budget_.MaxQueryBlocks == 0)
+    return false;
+
+  // Count the blocks BB can be reached from, stopping as soon as there are
+  // too many. The query cannot visit any other block.
+  SmallPtrSet<BasicBlock *, 32> seen;
+  SmallVector<BasicBlock *, 32> work;
+  seen.insert(BB);
+  work.push_back(BB);
+  while (!work.empty()) {
+    BasicBlock *B = work.pop_back_val();
+    for (pred_iterator pi = pred_begin(B), pe = pred_end(B); pi != pe; ++pi) {
+      if (!seen.insert(*pi))
+        continue;
+      if (seen.size() > Budget_.MaxQueryBlocks)
+        return true;
+      work.push_back(*pi);
+    }
+  }
+  return false;
+}
+
+void DataDependence::truncate(FunctionDeps &FD, unsigned Id) {
+  FD.Local_[Id] = DepInfo(NULL, Unknown);
+  ++FD.NumLocal_;
+  FD.Truncated_ = true;
+  ++NumTruncatedQueries;
+}
+
 const char *DataDependence::depTypeToString(DepType d) {
   // NOTE: Change this if you add more stuff to DepType
   switch (d) {
@@ -136,12 +452,37 @@ const char *DataDependence::depTypeToString(DepType d) {
   llvm_unreachable("unknown DepType encountered");
 }
 
+DataDependence::DataDependence() {
+  LocalEngine_ = MemDep;
+  Summaries_ = NULL;
+  Steps_ = 0;
+}
+
+void DataDependence::setLocalEngine(LocalEngine E) {
+  LocalEngine_ = E;
+}
+
+DataDependence::LocalEngine DataDependence::getLocalEngine() const {
+  return LocalEngine_;
+}
+
+DataDependence::Budget::Budget() {
+  MaxQueryBlocks = 0;
+  MaxQueryResults = 0;
+  MaxFunctionSteps = 0;
+  MaxFunctionMillis = 0;
+}
+
+void DataDependence::setBudget(const Budget &B) {
+  Budget_ = B;
+}
+
 DataDependence::DepInfo::DepInfo() {
   DepInst_ = NULL;
   Type_ = Invalid;
 }
 
-bool DataDependence::DepInfo::valid() {
+bool DataDependence::DepInfo::valid() const {
   if (Type_ == Invalid)
     return false;
   // For some dependencies, the dependent instruction is NULL (ie, for non
@@ -169,3 +510,230 @@ DataDependence::DepInfo DataDependence::getDepInfo(MemDepResult dep) {
     return DepInfo(dep.getInst(), NonLocal);
   llvm_unreachable("unknown dependence type");
 }
+
+DataDependence::FunctionDeps &DataDependence::createFunctionDeps(Function &F) {
+  // Replace the results if this function has been analyzed before
+  unsigned fid;
+  auto fi = FunctionIds_.find(&F);
+  if (fi != FunctionIds_.end()) {
+    fid = fi->second;
+    Functions_[fid] = FunctionDeps();
+  }
+  else {
+    fid = Functions_.size();
+    FunctionIds_[&F] = fid;
+    Functions_.push_back(FunctionDeps());
+  }
+  FunctionDeps &FD = Functions_[fid];
+  FD.F_ = &F;
+  return FD;
+}
+
+void DataDependence::invalidate(const Function *F) {
+  auto fi = FunctionIds_.find(F);
+  if (fi == FunctionIds_.end())
+    return;
+  unsigned fid = fi->second;
+
+  Functions_.erase(Functions_.begin() + fid);
+  FunctionIds_.erase(fi);
+  for (auto i = FunctionIds_.begin(), e = FunctionIds_.end(); i != e; ++i) {
+    if (i->second > fid)
+      --i->second;
+  }
+}
+
+bool DataDependence::releaseFunctionDeps(const Function *F,
+    FunctionDeps &Out) {
+  auto fi = FunctionIds_.find(F);
+  if (fi == FunctionIds_.end())
+    return false;
+  Out = std::move(Functions_[fi->second]);
+  invalidate(F);
+  return true;
+}
+
+const std::vector<DataDependence::FunctionDeps> &
+DataDependence::getFunctionDeps() const {
+  return Functions_;
+}
+
+const DataDependence::FunctionDeps *
+DataDependence::getFunctionDeps(const Function *F) const {
+  auto fi = FunctionIds_.find(F);
+  if (fi == FunctionIds_.end())
+    return NULL;
+  return &Functions_[fi->second];
+}
+
+const DataDependence::DepInfo *
+DataDependence::getLocalDep(const Instruction *I) const {
+  const FunctionDeps *FD = getFunctionDeps(I->getParent()->getParent());
+  unsigned id;
+  if (FD == NULL || !FD->getId(I, id))
+    return NULL;
+
+  const DepInfo &info = FD->getLocalDep(id);
+  if (!info.valid())
+    return NULL;
+  return &info;
+}
+
+ArrayRef<DataDependence::NonLocalDep>
+DataDependence::getNonLocalDeps(const Instruction *I) const {
+  const FunctionDeps *FD = getFunctionDeps(I->getParent()->getParent());
+  unsigned id;
+  if (FD == NULL || !FD->getId(I, id))
+    return ArrayRef<NonLocalDep>();
+  return FD->getNonLocalDeps(id);
+}
+
+unsigned DataDependence::numLocalDeps() const {
+  unsigned n = 0;
+  for (auto i = Functions_.begin(), e = Functions_.end(); i != e; ++i)
+    n += i->NumLocal_;
+  return n;
+}
+
+unsigned DataDependence::numNonLocalDeps() const {
+  unsigned n = 0;
+  for (auto i = Functions_.begin(), e = Functions_.end(); i != e; ++i)
+    n += i->NumNonLocal_;
+  return n;
+}
+
+DataDependence::FunctionDeps::FunctionDeps() {
+  F_ = NULL;
+  NumLocal_ = 0;
+  NumNonLocal_ = 0;
+  Truncated_ = false;
+  NumMemInsts_ = 0;
+  Micros_ = 0;
+}
+
+size_t DataDependence::FunctionDeps::memoryBytes() const {
+  return Blocks_.capacity() * sizeof(BasicBlock *)
+    + BlockIds_.getMemorySize()
+    + Insts_.capacity() * sizeof(Instruction *)
+    + Ids_.getMemorySize()
+    + Local_.capacity() * sizeof(DepInfo)
+    + NonLocalOffsets_.capacity() * sizeof(unsigned)
+    + NonLocal_.capacity() * sizeof(NonLocalDep);
+}
+
+unsigned DataDependence::FunctionDeps::size() const {
+  return Insts_.size();
+}
+
+bool DataDependence::FunctionDeps::getId(const Instruction *I,
+    unsigned &Id) const {
+  auto it = Ids_.find(I);
+  if (it == Ids_.end())
+    return false;
+  Id = it->second;
+  return true;
+}
+
+Instruction *DataDependence::FunctionDeps::getInst(unsigned Id) const {
+  assert(Id < Insts_.size() && "instruction ID out of range");
+  return Insts_[Id];
+}
+
+const DataDependence::DepInfo &
+DataDependence::FunctionDeps::getLocalDep(unsigned Id) const {
+  assert(Id < Local_.size() && "instruction ID out of range");
+  return Local_[Id];
+}
+
+ArrayRef<DataDependence::NonLocalDep>
+DataDependence::FunctionDeps::getNonLocalDeps(unsigned Id) const {
+  assert(Id + 1 < NonLocalOffsets_.size() && "instruction ID out of range");
+  return ArrayRef<NonLocalDep>(NonLocal_).slice(NonLocalOffsets_[Id],
+      NonLocalOffsets_[Id + 1] - NonLocalOffsets_[Id]);
+}
+
+void DataDependence::FunctionDeps::printLocalDep(raw_ostream &OS,
+    unsigned Id) const {
+  const DepInfo &info = getLocalDep(Id);
+  if (!info.valid())
+    return;
+
+  OS << "Instruction: " << *getInst(Id);
+  OS << "\n    has dependence\n";
+  if (info.DepInst_)
+    OS << "    with instruction " << *(info.DepInst_) << '\n';
+  else
+    OS << "    with instruction none\n";
+  OS << "    of type " << depTypeToString(info.Type_) << '\n';
+}
+
+void DataDependence::FunctionDeps::printNonLocalDeps(raw_ostream &OS,
+    unsigned Id) const {
+  ArrayRef<NonLocalDep> deps = getNonLocalDeps(Id);
+  if (deps.empty())
+    return;
+
+  OS << "Instruction: " << *getInst(Id)
+     << "\n    has non local dependence(s) with:\n";
+  for (auto j = deps.begin(); j != deps.end(); ++j) {
+    // Results of calls have no address
+    if (j->Address_)
+      OS << "    Address: " << *(j->Address_) << '\n';
+    else
+      OS << "    Call result in block: " << getBlock(*j)->getName() << '\n';
+  }
+}
+
+unsigned DataDependence::FunctionDeps::numBlocks() const {
+  return Blocks_.size();
+}
+
+BasicBlock *DataDependence::FunctionDeps::getBlock(unsigned Id) const {
+  assert(Id < Blocks_.size() && "block ID out of range");
+  return Blocks_[Id];
+}
+
+bool DataDependence::FunctionDeps::getBlockId(const BasicBlock *BB,
+    unsigned &Id) const {
+  auto it = BlockIds_.find(BB);
+  if (it == BlockIds_.end())
+    return false;
+  Id = it->second;
+  return true;
+}
+
+BasicBlock *
+DataDependence::FunctionDeps::getBlock(const NonLocalDep &R) const {
+  return getBlock(R.Block_);
+}
+
+Instruction *
+DataDependence::FunctionDeps::getDepInst(const NonLocalDep &R) const {
+  if (!R.hasDepInst())
+    return NULL;
+  return getInst(R.DepInst_);
+}
+
+DataDependence::NonLocalDep::NonLocalDep() {
+  Address_ = NULL;
+  Block_ = 0;
+  DepInst_ = NoInst;
+  Type_ = Unknown;
+}
+
+DataDependence::NonLocalDep::NonLocalDep(unsigned Block, unsigned DepInst,
+    DepType Type, Value *Address) {
+  assert(DepInst <= NoInst && Type <= Unknown && "result does not fit");
+  Address_ = Address;
+  Block_ = Block;
+  DepInst_ = DepInst;
+  Type_ = Type;
+}
+
+DataDependence::DepType DataDependence::NonLocalDep::getType() const {
+  return DepType(Type_);
+}
+
+bool DataDependence::NonLocalDep::hasDepInst() const {
+  return DepInst_ != NoInst;
+}
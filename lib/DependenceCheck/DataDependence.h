@@ -25,12 +25,30 @@
 //  }
 //
 //
-//  Two maps LocalDeps_ and NonLocalDeps_ contain the dependency information.
-//  You can call getDataDependencies() on all the functions in a module to
-//  build all the dependency information in these two maps.
+//  The dependency information is stored per function in a FunctionDeps
+//  object. Every instruction of the function is given a dense ID and the
+//  local and non-local results are kept in vectors indexed by that ID. You
+//  can call getDataDependencies() on all the functions in a module to build
+//  all the dependency information.
+
+#ifndef DATA_DEPENDENCE_H
+#define DATA_DEPENDENCE_H
 
 #include "llvm/IR/Module.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetLibraryInfo.h"
+
+#include "BlockScanner.h"
+#include "ModRefSummary.h"
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
 
 using namespace llvm;
 class DataDependence {
@@ -95,12 +113,67 @@ class DataDependence {
     // Print out the enum DepType to a string
     static const char *depTypeToString(DepType d);
 
+    // How local results are found. MemDep asks MemoryDependenceAnalysis
+    // for every instruction; Forward walks each block once with a
+    // BlockScanner and only asks MemoryDependenceAnalysis about the
+    // instructions the scanner cannot answer. Both give the same results.
+    enum LocalEngine {
+      MemDep = 0,
+      Forward = 1
+    };
+
+    DataDependence();
+
+    // Select the engine used by getDataDependencies(). The default is
+    // MemDep.
+    void setLocalEngine(LocalEngine E);
+    LocalEngine getLocalEngine() const;
+
+    // Limits on the cost of non-local queries. A query over budget is not
+    // made (or its results are dropped) and the instruction gets a local
+    // Unknown dependence with no instruction instead. 0 means no limit.
+    struct Budget {
+      Budget();
+
+      // Skip queries whose block can be reached from more than this many
+      // blocks (an upper bound on the blocks the query may visit)
+      unsigned MaxQueryBlocks;
+
+      // Drop the results of queries returning more than this many results
+      unsigned MaxQueryResults;
+
+      // Skip all queries of a function after it has this many non-local
+      // results
+      unsigned MaxFunctionSteps;
+
+      // Skip all queries of a function after this many milliseconds
+      unsigned MaxFunctionMillis;
+    };
+
+    // Set the budget used by getDataDependencies(). The default has no
+    // limits.
+    void setBudget(const Budget &B);
+
     // Get data dependencies. This function stores its results in class
     // internal data structures.
     //
     // MDA is assumed to be the MemoryDependenceAnalysis information of the
     // function F. AA is the alias analysis information for the current module.
-    void getDataDependencies(Function &F, MemoryDependenceAnalysis &MDA, AliasAnalysis &AA);
+    // TLI (may be NULL) is used to recognize calls to free(), which are
+    // queried like stores; it should be the TargetLibraryInfo seen by MDA.
+    //
+    // Calls and invokes with a non-local result are queried with
+    // getNonLocalCallDependency(). Their results are stored with the other
+    // non-local results but have a NULL address.
+    //
+    // If Summaries is not NULL, a call reported as the Clobber of a load,
+    // store, va_arg or free() is skipped when its callee's summary shows it
+    // cannot access the queried location; the scan continues above the
+    // call. A non-local Clobber is only replaced if the continued scan finds
+    // a result in the same block.
+    void getDataDependencies(Function &F, MemoryDependenceAnalysis &MDA,
+        AliasAnalysis &AA, const TargetLibraryInfo *TLI = NULL,
+        const ModRefSummaries *Summaries = NULL);
 
     // Dependence Information. Used in a map of Instruction -> DepInfo.
     // Depinfo contains the instruction that is depended on (depInst) and the
@@ -112,32 +185,248 @@ class DataDependence {
     struct DepInfo {
       DepInfo();
       DepInfo(Instruction *i, DepType d); 
-      bool valid();
+      bool valid() const;
 
       Instruction *DepInst_; // inst that is depended on
       DepType Type_;
 
     };
-    // The two following maps, when examined together, hold all the dependence
-    // information obtained from the MemoryDependenceAnalysis pass
-    
-    // Map of Instructions to DepInfo. DepInfo is the dependence information
-    // of the instruction, ie the instruction (template argument 1) depends
-    // on another instruction contained in DepInfo (template argument 2)
-    std::map<Instruction *, DepInfo> LocalDeps_;
-
-    // Map of instructions to vectors of NonLocalDepResults. This stores the
-    // data for non local dependencies
-    std::map<Instruction *, std::vector<NonLocalDepResult> > NonLocalDeps_;
 
-  private:
-    // Helper functions
-    // Processes MemoryDependenceAnalysis result for the given
-    // instruction and stores the information in class internal data structures
-    void processDepResult(Instruction *inst, MemoryDependenceAnalysis &MDA, AliasAnalysis &AA);
+    // A non-local result. Only the fields used by this pass are kept; the
+    // block and the instruction depended on are dense IDs of the function
+    // (see FunctionDeps) so a result takes 16 bytes instead of the 24 of a
+    // NonLocalDepResult.
+    struct NonLocalDep {
+      // DepInst_ of results without an instruction (e.g., NonFuncLocal)
+      static const unsigned NoInst = (1u << 29) - 1;
+
+      NonLocalDep();
+      NonLocalDep(unsigned Block, unsigned DepInst, DepType Type,
+          Value *Address);
+
+      DepType getType() const;
+      bool hasDepInst() const;
+
+      // Address of the dependence after phi translation. NULL for the
+      // results of calls.
+      Value *Address_;
+      unsigned Block_;
+      unsigned DepInst_ : 29;
+      unsigned Type_ : 3;
+    };
+
+    // Dependence information of a single function, obtained from the
+    // MemoryDependenceAnalysis pass.
+    //
+    // Every block and instruction in the function has a dense ID (0 to
+    // numBlocks() - 1 and 0 to size() - 1) assigned in function and
+    // inst_iterator order. Local results are stored in a vector indexed by
+    // the ID. Non-local results are stored in compressed sparse row form: the
+    // results of the instruction with ID i are NonLocal_[NonLocalOffsets_[i]]
+    // to NonLocal_[NonLocalOffsets_[i + 1] - 1]. NonLocal_ is allocated once
+    // at its final size when the function is done, so all the non-local
+    // results of a function live in one block of memory that is freed at
+    // once.
+    struct FunctionDeps {
+      FunctionDeps();
+
+      // Number of instructions in the function
+      unsigned size() const;
+
+      // Sets Id to the dense ID of I. Returns false if I is not part of this
+      // function
+      bool getId(const Instruction *I, unsigned &Id) const;
+
+      // Returns the instruction with the dense ID Id
+      Instruction *getInst(unsigned Id) const;
+
+      // Returns the local dependence of the instruction with the dense ID Id.
+      // The returned DepInfo is not valid() if the instruction has no local
+      // dependence.
+      const DepInfo &getLocalDep(unsigned Id) const;
+
+      // Returns the non-local results of the instruction with the dense ID Id
+      ArrayRef<NonLocalDep> getNonLocalDeps(unsigned Id) const;
+
+      // Write the local (non-local) results of the instruction with the
+      // dense ID Id as text, the format of DependenceCheck::print(). Nothing
+      // is written if it has none. A result without an instruction (e.g.,
+      // NonFuncLocal or a query cut short by the budget) is written as
+      // "none".
+      void printLocalDep(raw_ostream &OS, unsigned Id) const;
+      void printNonLocalDeps(raw_ostream &OS, unsigned Id) const;
+
+      // Number of blocks in the function
+      unsigned numBlocks() const;
+
+      // Returns the block with the dense ID Id
+      BasicBlock *getBlock(unsigned Id) const;
+
+      // Sets Id to the dense ID of BB. Returns false if BB is not part of
+      // this function
+      bool getBlockId(const BasicBlock *BB, unsigned &Id) const;
+
+      // Returns the block (instruction) of the non-local result R. The
+      // instruction is NULL if R has none.
+      BasicBlock *getBlock(const NonLocalDep &R) const;
+      Instruction *getDepInst(const NonLocalDep &R) const;
+
+      const Function *F_;
+
+      // Dense ID -> BasicBlock
+      std::vector<BasicBlock *> Blocks_;
+
+      // BasicBlock -> Dense ID
+      DenseMap<const BasicBlock *, unsigned> BlockIds_;
 
-    // Apated from MemDepPrinter(). This interprets the dependency result and
+      // Dense ID -> Instruction
+      std::vector<Instruction *> Insts_;
+
+      // Instruction -> Dense ID
+      DenseMap<const Instruction *, unsigned> Ids_;
+
+      // Local dependence of each instruction (see getLocalDep())
+      std::vector<DepInfo> Local_;
+
+      // Non-local dependence CSR arrays (see struct comment)
+      std::vector<unsigned> NonLocalOffsets_;
+      std::vector<NonLocalDep> NonLocal_;
+
+      // Number of instructions with a local dependence and with at least one
+      // non-local result
+      unsigned NumLocal_;
+      unsigned NumNonLocal_;
+
+      // True if the budget cut at least one query short, so the results are
+      // more conservative than those of an analysis without a budget
+      bool Truncated_;
+
+      // Cost of the analysis of the function (see DepTelemetry.h): the
+      // number of memory instructions queried and the time taken by
+      // getDataDependencies() in microseconds. Both are 0 for results
+      // restored from elsewhere (e.g., a cache).
+      unsigned NumMemInsts_;
+      uint64_t Micros_;
+
+      // Bytes held by the arrays and maps of the results
+      size_t memoryBytes() const;
+    };
+
+    // Returns an empty FunctionDeps for F, replacing any earlier results of
+    // F. Used by getDataDependencies() and to restore results calculated
+    // elsewhere (e.g., loaded from a cache); the caller fills in all fields.
+    FunctionDeps &createFunctionDeps(Function &F);
+
+    // Drops the dependence information of F, e.g., after it was changed by
+    // a transform. F may be deleted already.
+    void invalidate(const Function *F);
+
+    // Moves the dependence information of F into Out and drops it from this
+    // object, as invalidate() does. Returns false (and leaves Out alone) if
+    // F has not been analyzed. Used to release the results of a function
+    // once they have been written.
+    bool releaseFunctionDeps(const Function *F, FunctionDeps &Out);
+
+    // Dependence information of all the functions passed to
+    // getDataDependencies(), in the order they were analyzed
+    const std::vector<FunctionDeps> &getFunctionDeps() const;
+
+    // Returns the dependence information of F, or NULL if F has not been
+    // analyzed
+    const FunctionDeps *getFunctionDeps(const Function *F) const;
+
+    // Returns the local dependence of I, or NULL if I has none (or its
+    // function has not been analyzed)
+    const DepInfo *getLocalDep(const Instruction *I) const;
+
+    // Returns the non-local results of I. This is empty if I has none (or its
+    // function has not been analyzed)
+    ArrayRef<NonLocalDep> getNonLocalDeps(const Instruction *I) const;
+
+    // Adapted from MemDepPrinter(). This interprets the dependency result and
     // returns a pair of the instruction that is depended on 
     static DepInfo getDepInfo(MemDepResult dep);
 
+    // Total number of instructions with local and non-local dependencies
+    // over all analyzed functions
+    unsigned numLocalDeps() const;
+    unsigned numNonLocalDeps() const;
+
+  private:
+    // See getFunctionDeps()
+    std::vector<FunctionDeps> Functions_;
+
+    // Function -> index into Functions_
+    DenseMap<const Function *, unsigned> FunctionIds_;
+
+    // Calls of one function with non-local results, by hash of the
+    // predecessors of their block, callee and operands. Identical calls in
+    // blocks with the same predecessors have the same non-local results so
+    // only the first one is queried.
+    typedef std::unordered_map<size_t, SmallVector<unsigned, 2> > CallBatch;
+
+    // Non-local results of the function being analyzed. They are moved to
+    // FunctionDeps::NonLocal_ at the end of getDataDependencies(); the
+    // buffers keep their capacity for the next function.
+    std::vector<NonLocalDep> Scratch_;
+    SmallVector<NonLocalDepResult, 16> Query_;
+
+    // See setLocalEngine()
+    LocalEngine LocalEngine_;
+
+    // See setBudget()
+    Budget Budget_;
+
+    // Non-local results and start time of the function being analyzed,
+    // for Budget_
+    unsigned Steps_;
+    sys::TimeValue Start_;
+
+    // Returns true if a non-local query from BB would go over Budget_
+    bool overBudget(BasicBlock *BB) const;
+
+    // Records the instruction with the dense ID Id in FD as having an
+    // Unknown dependence because its query went over Budget_
+    void truncate(FunctionDeps &FD, unsigned Id);
+
+    // Summaries passed to getDataDependencies() for the function being
+    // analyzed, or NULL
+    const ModRefSummaries *Summaries_;
+
+    // Sets Loc and IsLoad to the location accessed by the load, store,
+    // va_arg or free() call I. Returns false for other instructions and for
+    // atomic or volatile accesses.
+    static bool getQueryLocation(Instruction *I, AliasAnalysis &AA,
+        const TargetLibraryInfo *TLI, AliasAnalysis::Location &Loc,
+        bool &IsLoad);
+
+    // While R is a Clobber by a call that cannot access Loc (see
+    // ModRefSummaries), continues the scan of BB above the call. Returns the
+    // first result that is not such a Clobber.
+    MemDepResult skipCallClobbers(MemDepResult R,
+        const AliasAnalysis::Location &Loc, bool IsLoad, BasicBlock *BB,
+        MemoryDependenceAnalysis &MDA, AliasAnalysis &AA);
+
+    // Appends the result R of a MemoryDependenceAnalysis query to Scratch_
+    void appendNonLocal(const FunctionDeps &FD, BasicBlock *BB,
+        MemDepResult R, Value *Address);
+
+    // Helper functions
+    // Processes MemoryDependenceAnalysis result for the instruction with the
+    // dense ID Id in FD and stores the information in FD. The non-local
+    // results are appended to Scratch_. If Scanner is not NULL it is asked
+    // for the local result first.
+    void processDepResult(FunctionDeps &FD, unsigned Id,
+        MemoryDependenceAnalysis &MDA, AliasAnalysis &AA,
+        const TargetLibraryInfo *TLI, CallBatch &Calls,
+        BlockScanner *Scanner);
+
+    // Appends the non-local results of the call with the dense ID Id to
+    // Scratch_, reusing the results of an identical call in Calls
+    void processCallDep(FunctionDeps &FD, unsigned Id,
+        MemoryDependenceAnalysis &MDA, CallBatch &Calls);
+
+
 };
+
+#endif // DATA_DEPENDENCE_H
@@ -0,0 +1,337 @@
+// Author: Markus Kusano
+//
+// See DepCache.h for more information
+
+#define DEBUG_TYPE "depcheck"
+#include "DepCache.h"
+#include "DepExport.h"
+#include "DepRecord.h"
+#include "FunctionHash.h"
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+
+#include <algorithm>
+#include <string.h>
+#include <unistd.h>
+#include <utility>
+
+STATISTIC(NumCacheHits, "Number of functions restored from the cache");
+STATISTIC(NumCacheMisses, "Number of functions not found in the cache");
+STATISTIC(NumCacheStores, "Number of functions written to the cache");
+STATISTIC(NumCacheInvalid, "Number of unusable cache entries");
+STATISTIC(NumCacheTruncated,
+    "Number of functions not cached because the budget cut them short");
+
+using namespace depformat;
+
+// Every entry starts with a header holding the full key and function hash;
+// the file name only has 64 bits of the key
+static const uint32_t CacheMagic = 0x43504544; // "DEPC"
+static const size_t HeaderSize = 2 * sizeof(uint32_t) + 2 * sizeof(StableDigest);
+
+static uint32_t readU32(const char *P) {
+  const unsigned char *u = reinterpret_cast<const unsigned char *>(P);
+  return uint32_t(u[0]) | (uint32_t(u[1]) << 8) | (uint32_t(u[2]) << 16)
+    | (uint32_t(u[3]) << 24);
+}
+
+static void writeU32(raw_ostream &Out, uint32_t V) {
+  char buf[4] = { char(V), char(V >> 8), char(V >> 16), char(V >> 24) };
+  Out.write(buf, 4);
+}
+
+// Returns the pointer operand of a load, store or va_arg, or NULL
+static Value *queryPointer(Instruction *I) {
+  if (LoadInst *LI = dyn_cast<LoadInst>(I))
+    return LI->getPointerOperand();
+  if (StoreInst *SI = dyn_cast<StoreInst>(I))
+    return SI->getPointerOperand();
+  if (VAArgInst *VI = dyn_cast<VAArgInst>(I))
+    return VI->getPointerOperand();
+  return NULL;
+}
+
+// Returns true if a result of the given type and instruction can come from
+// MemoryDependenceAnalysis
+static bool validResult(uint32_t Type, Instruction *I) {
+  switch (Type) {
+    case DataDependence::Clobber:
+    case DataDependence::Def:
+      return I != NULL;
+    case DataDependence::NonFuncLocal:
+    case DataDependence::NonLocal:
+    case DataDependence::Unknown:
+      return true;
+  }
+  return false;
+}
+
+// Returns true if the controllers of the branches of R are exactly the
+// control dependencies of R. Both are sorted by the dependent block.
+static bool hasAllBranches(const DepRecordView &R) {
+  std::vector<std::pair<uint32_t, uint32_t> > fromEdges, fromBranches;
+  for (uint32_t b = 0; b < R.numBlocks(); ++b) {
+    for (uint32_t j = R.cdOffsets()[b]; j < R.cdOffsets()[b + 1]; ++j)
+      fromEdges.push_back(std::make_pair(R.cdTargets()[j], b));
+  }
+  for (uint32_t i = 0; i < R.numCDBranches(); ++i) {
+    const depformat::CDBranch &b = R.cdBranches()[i];
+    fromBranches.push_back(std::make_pair(b.Dependent, b.Controller));
+  }
+  std::sort(fromEdges.begin(), fromEdges.end());
+  std::sort(fromBranches.begin(), fromBranches.end());
+  fromBranches.erase(std::unique(fromBranches.begin(), fromBranches.end()),
+      fromBranches.end());
+  return fromEdges == fromBranches;
+}
+
+DepCache::DepCache(const std::string &Dir, const StableDigest &Options)
+  : dir_(Dir), options_(Options), summaries_(NULL) { }
+
+void DepCache::setSummaries(const ModRefSummaries *Summaries) {
+  assert(keys_.empty() && "summaries set after the first lookup");
+  summaries_ = Summaries;
+}
+
+const DepCache::Key &DepCache::getKey(const Function &F) {
+  auto it = keys_.find(&F);
+  if (it != keys_.end())
+    return it->second;
+
+  Key &key = keys_[&F];
+  key.Function = hashFunction(F);
+  StableHasher H;
+  H.add(key.Function);
+  H.add(options_);
+  H.add(Version);
+  H.add(summaries_ != NULL);
+  if (summaries_ != NULL)
+    H.add(summaries_->hashCallees(F));
+  key.Entry = H.finish();
+  return key;
+}
+
+std::string DepCache::getPath(const Key &K) const {
+  std::string name;
+  raw_string_ostream nameStream(name);
+  nameStream << format("%016llx", (unsigned long long)K.Entry.low64())
+             << ".dep";
+  nameStream.flush();
+
+  SmallString<128> path(dir_);
+  sys::path::append(path, name);
+  return path.str();
+}
+
+bool DepCache::load(Function &F, DataDependence &Data,
+    ControlDependence &Control) {
+  const Key &key = getKey(F);
+  std::string path = getPath(key);
+
+  // Large entries are memory mapped; no null terminator is needed
+  OwningPtr<MemoryBuffer> buf;
+  if (MemoryBuffer::getFile(StringRef(path), buf, -1, false)) {
+    ++NumCacheMisses;
+    return false;
+  }
+
+  const char *start = buf->getBufferStart();
+  if (buf->getBufferSize() < HeaderSize || readU32(start) != CacheMagic
+      || readU32(start + 4) != Version) {
+    errs() << "[Warning] Ignoring malformed cache entry: " << path << '\n';
+    ++NumCacheInvalid;
+    return false;
+  }
+
+  // Another function (or options) whose key has the same first 64 bits
+  if (memcmp(start + 8, key.Entry.Bytes, sizeof(key.Entry.Bytes)) != 0
+      || memcmp(start + 8 + sizeof(StableDigest), key.Function.Bytes,
+        sizeof(key.Function.Bytes)) != 0) {
+    ++NumCacheMisses;
+    return false;
+  }
+
+  DepRecordView R;
+  if (!R.init(start + HeaderSize, buf->getBufferSize() - HeaderSize)) {
+    errs() << "[Warning] Ignoring malformed cache entry: " << path << '\n';
+    ++NumCacheInvalid;
+    return false;
+  }
+
+  // The record only holds IDs. Map them back to the values of F, checking
+  // that F has the shape of the function the record was written for.
+  std::vector<Argument *> args;
+  for (auto ai = F.arg_begin(), ae = F.arg_end(); ai != ae; ++ai)
+    args.push_back(&*ai);
+
+  DataDependence::FunctionDeps FD;
+  FD.F_ = &F;
+  for (auto bi = F.begin(), be = F.end(); bi != be; ++bi) {
+    FD.BlockIds_[&*bi] = FD.Blocks_.size();
+    FD.Blocks_.push_back(&*bi);
+  }
+  for (inst_iterator i = inst_begin(F); i != inst_end(F); ++i) {
+    FD.Ids_[&*i] = FD.Insts_.size();
+    FD.Insts_.push_back(&*i);
+  }
+
+  bool valid = R.numBlocks() == FD.Blocks_.size()
+    && R.numInsts() == FD.Insts_.size()
+    && R.numInsts() < DataDependence::NonLocalDep::NoInst;
+  for (uint32_t i = 0; valid && i < R.numBlocks(); ++i) {
+    valid = R.blockStarts()[i + 1] - R.blockStarts()[i]
+      == FD.Blocks_[i]->size();
+  }
+
+  // Local results
+  FD.Local_.resize(FD.Insts_.size());
+  const LocalDep *local = R.localDeps();
+  for (uint32_t i = 0; valid && i < R.numLocal(); ++i) {
+    Instruction *dep = local[i].DepInst == NoId
+      ? NULL : FD.Insts_[local[i].DepInst];
+    valid = validResult(local[i].Type, dep)
+      && local[i].Type != DataDependence::NonLocal;
+    FD.Local_[local[i].Inst] =
+      DataDependence::DepInfo(dep, DataDependence::DepType(local[i].Type));
+  }
+  FD.NumLocal_ = R.numLocal();
+
+  // Non-local results, appended in instruction order to build the CSR rows
+  FD.NonLocalOffsets_.reserve(FD.Insts_.size() + 1);
+  const NonLocalSpan *spans = R.nonLocalSpans();
+  const NonLocalDep *results = R.nonLocalResults();
+  uint32_t span = 0;
+  for (uint32_t i = 0; valid && i < FD.Insts_.size(); ++i) {
+    FD.NonLocalOffsets_.push_back(FD.NonLocal_.size());
+    if (span == R.numNonLocalInsts() || spans[span].Inst != i)
+      continue;
+
+    Instruction *query = FD.Insts_[i];
+    const NonLocalDep *r = results + spans[span].First;
+    const NonLocalDep *re = r + spans[span].Count;
+    for (; valid && r != re; ++r) {
+      Instruction *dep = r->DepInst == NoId ? NULL : FD.Insts_[r->DepInst];
+      valid = validResult(r->Type, dep);
+
+      Value *address = NULL;
+      if (r->Address == QueryPointer)
+        address = queryPointer(query);
+      else if (r->Address == NoId)
+        address = NULL;
+      else if (r->Address & ArgumentFlag) {
+        uint32_t argNo = r->Address & ~ArgumentFlag;
+        valid = valid && argNo < args.size();
+        address = valid ? args[argNo] : NULL;
+      }
+      else
+        address = FD.Insts_[r->Address];
+      valid = valid && (r->Address == NoId || address != NULL);
+
+      if (valid) {
+        FD.NonLocal_.push_back(DataDependence::NonLocalDep(r->Block,
+              r->DepInst == NoId ? DataDependence::NonLocalDep::NoInst
+                                 : r->DepInst,
+              DataDependence::DepType(r->Type), address));
+      }
+    }
+    ++span;
+  }
+  FD.NonLocalOffsets_.push_back(FD.NonLocal_.size());
+  FD.NumNonLocal_ = R.numNonLocalInsts();
+
+  if (!valid) {
+    errs() << "[Warning] Cache entry does not match function " << F.getName()
+           << ": " << path << '\n';
+    ++NumCacheInvalid;
+    return false;
+  }
+
+  // Every control dependence must have a branch; the CDG asserts this
+  if (!hasAllBranches(R)) {
+    errs() << "[Warning] Cache entry has inconsistent branches: " << path
+           << '\n';
+    ++NumCacheInvalid;
+    return false;
+  }
+  std::vector< ::CDBranch> branches(R.numCDBranches());
+  for (uint32_t i = 0; i < R.numCDBranches(); ++i) {
+    branches[i].Controller = R.cdBranches()[i].Controller;
+    branches[i].Dependent = R.cdBranches()[i].Dependent;
+    branches[i].Successor = R.cdBranches()[i].Successor;
+  }
+
+  Data.createFunctionDeps(F) = std::move(FD);
+  Control.restoreFunction(F,
+      ArrayRef<unsigned>(R.cdOffsets(), R.numBlocks() + 1),
+      ArrayRef<unsigned>(R.cdTargets(), R.numCDEdges()), branches);
+
+  ++NumCacheHits;
+  return true;
+}
+
+bool DepCache::store(const Function &F,
+    const DataDependence::FunctionDeps &Data, const CompactCDG &Control) {
+  if (!DepExportWriter::isRepresentable(Data))
+    return false;
+
+  // Whether a budget cuts a query short depends on the machine and the load
+  // (-depcheck-max-function-ms), so only complete results are stored
+  if (Data.Truncated_) {
+    ++NumCacheTruncated;
+    return false;
+  }
+
+  // Write to a temporary file first so concurrent runs never see a partial
+  // entry
+  const Key &key = getKey(F);
+  std::string path = getPath(key);
+  std::string tmpPath;
+  raw_string_ostream tmpStream(tmpPath);
+  tmpStream << path << ".tmp." << getpid();
+  tmpStream.flush();
+
+  {
+    std::string errInfo;
+    raw_fd_ostream out(tmpPath.c_str(), errInfo, raw_fd_ostream::F_Binary);
+    if (!errInfo.empty()) {
+      errs() << "[Warning] Error opening cache file: " << errInfo << '\n';
+      return false;
+    }
+
+    writeU32(out, CacheMagic);
+    writeU32(out, Version);
+    out.write(reinterpret_cast<const char *>(key.Entry.Bytes),
+        sizeof(key.Entry.Bytes));
+    out.write(reinterpret_cast<const char *>(key.Function.Bytes),
+        sizeof(key.Function.Bytes));
+    DepExportWriter::writeRecord(out, 0, F, &Data, &Control);
+    out.close();
+    if (out.has_error()) {
+      out.clear_error();
+      errs() << "[Warning] Error writing cache file: " << tmpPath << '\n';
+      bool existed;
+      sys::fs::remove(tmpPath, existed);
+      return false;
+    }
+  }
+
+  if (error_code ec = sys::fs::rename(tmpPath, path)) {
+    errs() << "[Warning] Error renaming cache file: " << ec.message() << '\n';
+    bool existed;
+    sys::fs::remove(tmpPath, existed);
+    return false;
+  }
+
+  ++NumCacheStores;
+  return true;
+}
@@ -0,0 +1,91 @@
+// Author: Markus Kusano
+//
+// Persistent on-disk cache of the dependence results of single functions.
+//
+// Each entry is a file <dir>/<key>.dep holding a header and one binary
+// function record (see DepFormat.h). The key is a StableDigest (see
+// StableHash.h) of the function's IR (see FunctionHash.h), the analysis
+// options that change the results (including the alias analyses), and the
+// format version, so an entry is only found for a function that has not
+// changed since it was stored. The file name has the first 64 bits of the
+// key; the header has the whole key and the hash of the function, which
+// load() checks:
+//
+//  u32 "DEPC", u32 Version, u8 Key[16], u8 FunctionHash[16]
+//
+// Entries are never updated in place: a changed function gets a new key.
+// Stale entries are not removed; the directory can be deleted at any time.
+//
+// Only results that no budget cut short are stored (see
+// DataDependence::Budget), so they are the same as those of an analysis
+// without a budget and the budgets are not part of the key.
+//
+// The cached results are only valid if the data dependencies of a function
+// depend on nothing but its own IR. This holds for function-local alias
+// analyses (e.g., -basicaa, -tbaa) but not for interprocedural ones (e.g.,
+// -globalsmodref-aa), with which the pass does not use the cache. Mod/ref
+// summaries (see ModRefSummary.h) are supported: with setSummaries() the
+// summaries of the callees of a function are part of its key.
+//
+//  DepCache C(Dir, Options);
+//  if (!C.load(F, DataDep, ControlDep)) {
+//    ... calculate DataDep and ControlDep for F ...
+//    C.store(F, *DataDep.getFunctionDeps(&F), *ControlDep.getCompactCDG(&F));
+//  }
+
+#ifndef DEP_CACHE_H
+#define DEP_CACHE_H
+
+#include "ControlDependence.h"
+#include "DataDependence.h"
+#include "StableHash.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <stdint.h>
+#include <string>
+
+using namespace llvm;
+
+class DepCache {
+  public:
+    // Dir must exist. Options is a hash of the analysis options the results
+    // were calculated with.
+    DepCache(const std::string &Dir, const StableDigest &Options);
+
+    // Restores the results of F from the cache into Data and Control.
+    // Returns false if there is no usable entry for F; Data and Control are
+    // not modified in that case.
+    bool load(Function &F, DataDependence &Data, ControlDependence &Control);
+
+    // Stores the results of F. Returns false if they cannot be cached (see
+    // DepExportWriter::isRepresentable()), a budget cut them short, or the
+    // entry could not be written.
+    bool store(const Function &F, const DataDependence::FunctionDeps &Data,
+        const CompactCDG &Control);
+
+    // Summaries the data dependencies are calculated with, or NULL. This
+    // must be set before the first load() or store().
+    void setSummaries(const ModRefSummaries *Summaries);
+
+  private:
+    std::string dir_;
+    StableDigest options_;
+    const ModRefSummaries *summaries_;
+
+    struct Key {
+      StableDigest Function; // hashFunction()
+      StableDigest Entry;    // of Function, the options and the summaries
+    };
+
+    // Function -> key. The hash of a function is calculated by the first
+    // load() or store() of the function and reused by the other.
+    DenseMap<const Function *, Key> keys_;
+
+    const Key &getKey(const Function &F);
+
+    // Path of the entry with the given key
+    std::string getPath(const Key &K) const;
+};
+
+#endif // DEP_CACHE_H
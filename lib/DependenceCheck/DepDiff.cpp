@@ -0,0 +1,503 @@
+// Author: Markus Kusano
+//
+// See DepDiff.h for more information
+
+#define DEBUG_TYPE "depcheck"
+#include "DepDiff.h"
+#include "DepExport.h"
+#include "DepFormat.h"
+#include "DepRecord.h"
+#include "FunctionDependence.h"
+#include "FunctionHash.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/Passes.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/ValueSymbolTable.h"
+#include "llvm/PassManager.h"
+#include "llvm/Target/TargetLibraryInfo.h"
+
+#include <algorithm>
+#include <map>
+#include <string.h>
+#include <tuple>
+#include <vector>
+
+using namespace depformat;
+
+STATISTIC(NumDiffUnchanged, "Number of functions skipped by their hash");
+STATISTIC(NumDiffAnalyzed, "Number of functions analyzed for the diff");
+STATISTIC(NumDiffRemoved, "Number of removed dependencies");
+STATISTIC(NumDiffAdded, "Number of added dependencies");
+
+namespace {
+  // Keeps the binary record (see DepFormat.h) of the last function it ran
+  // on. The results of FunctionDependence are released once the pass
+  // manager is done with a function, so they are encoded right away.
+  class RecordCollector : public FunctionPass {
+    public:
+      static char ID; // pass ID
+
+      RecordCollector() : FunctionPass(ID) { }
+
+      virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+        AU.addRequired<FunctionDependence>();
+        AU.setPreservesAll();
+      }
+
+      virtual bool runOnFunction(Function &F) {
+        FunctionDependence &FDep = getAnalysis<FunctionDependence>();
+        std::string bytes;
+        raw_string_ostream out(bytes);
+        DepExportWriter::writeRecord(out, 0, F, &FDep.getDataDeps(),
+            &FDep.getCDG());
+        out.flush();
+
+        // Words keep the record 4 byte aligned for DepRecordView
+        Record.assign((bytes.size() + 3) / 4, 0);
+        memcpy(&Record[0], bytes.data(), bytes.size());
+        return false;
+      }
+
+      std::vector<uint32_t> Record;
+  };
+
+  char RecordCollector::ID = 0;
+
+  // Analyzes single functions of one version of the module
+  class VersionAnalyzer {
+    public:
+      explicit VersionAnalyzer(Module &M) : fpm_(&M) {
+        if (!M.getDataLayout().empty())
+          fpm_.add(new DataLayout(&M));
+
+        // Without it memory builtins (e.g., free) are not recognized in
+        // either version, as they are by opt
+        fpm_.add(new TargetLibraryInfo(Triple(M.getTargetTriple())));
+        fpm_.add(createTypeBasedAliasAnalysisPass());
+        fpm_.add(createBasicAliasAnalysisPass());
+        collector_ = new RecordCollector();
+        fpm_.add(collector_);
+        fpm_.doInitialization();
+      }
+
+      ~VersionAnalyzer() {
+        fpm_.doFinalization();
+      }
+
+      // Analyzes F and sets View to its record, which stays valid until
+      // the next call. Returns false if the record cannot be read.
+      bool analyze(Function &F, std::vector<uint32_t> &Record,
+          DepRecordView &View) {
+        fpm_.run(F);
+        Record.swap(collector_->Record);
+        return View.init(reinterpret_cast<const char *>(&Record[0]),
+            Record.size() * 4);
+      }
+
+    private:
+      FunctionPassManager fpm_;
+      RecordCollector *collector_; // owned by fpm_
+  };
+
+  // A dependence in the IDs of one version, with unused fields 0
+  typedef std::tuple<uint32_t, uint32_t, uint32_t, uint32_t, uint32_t> DepKey;
+
+  // Old ID -> matched new ID (or NoId) of the blocks and instructions of a
+  // function
+  struct Matching {
+    std::vector<uint32_t> Blocks;
+    std::vector<uint32_t> Insts;
+
+    // Translates an instruction ID; NoId stays NoId. Sets Ok to false if
+    // the instruction is not matched.
+    uint32_t inst(uint32_t Id, bool &Ok) const {
+      if (Id == NoId)
+        return NoId;
+      uint32_t to = Id < Insts.size() ? Insts[Id] : NoId;
+      Ok &= to != NoId;
+      return to;
+    }
+
+    uint32_t block(uint32_t Id, bool &Ok) const {
+      uint32_t to = Id < Blocks.size() ? Blocks[Id] : NoId;
+      Ok &= to != NoId;
+      return to;
+    }
+
+    // Translates an encoded address (see DepFormat.h). Arguments are
+    // matched by position.
+    uint32_t address(uint32_t Address, bool &Ok) const {
+      if (Address == NoId || Address == QueryPointer
+          || (Address & ArgumentFlag))
+        return Address;
+      return inst(Address, Ok);
+    }
+  };
+} // end namespace
+
+// Hash of the opcodes of a block, used to match unnamed blocks
+static size_t hashBlock(const BasicBlock &BB) {
+  hash_code h = hash_value(BB.size());
+  for (auto ii = BB.begin(), ie = BB.end(); ii != ie; ++ii)
+    h = hash_combine(h, ii->getOpcode());
+  return h;
+}
+
+// Fills M with the matching of the blocks and instructions of Old to those
+// of New (see DepDiff.h)
+static void matchFunctions(const Function &Old, const Function &New,
+    Matching &M) {
+  std::vector<const BasicBlock *> oldBlocks, newBlocks;
+  DenseMap<const Value *, unsigned> newIds; // blocks and instructions
+  std::vector<unsigned> oldFirst, newFirst; // first instruction of a block
+  unsigned numOld = 0, numNew = 0;
+  for (auto bi = Old.begin(), be = Old.end(); bi != be; ++bi) {
+    oldBlocks.push_back(&*bi);
+    oldFirst.push_back(numOld);
+    numOld += bi->size();
+  }
+  for (auto bi = New.begin(), be = New.end(); bi != be; ++bi) {
+    newIds[&*bi] = newBlocks.size();
+    newBlocks.push_back(&*bi);
+    newFirst.push_back(numNew);
+    for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii)
+      newIds[&*ii] = numNew++;
+  }
+  M.Blocks.assign(oldBlocks.size(), NoId);
+  M.Insts.assign(numOld, NoId);
+  std::vector<bool> newMatched(newBlocks.size(), false);
+  const ValueSymbolTable &symbols = New.getValueSymbolTable();
+
+  // Blocks by name
+  for (unsigned i = 0; i < oldBlocks.size(); ++i) {
+    if (!oldBlocks[i]->hasName())
+      continue;
+    Value *V = symbols.lookup(oldBlocks[i]->getName());
+    if (V == NULL || !isa<BasicBlock>(V))
+      continue;
+    unsigned to = newIds.lookup(V);
+    M.Blocks[i] = to;
+    newMatched[to] = true;
+  }
+
+  // The other blocks by a hash that is unique on both sides: hash ->
+  // (number of blocks, last block) of each side
+  std::map<size_t, std::pair<unsigned, unsigned> > oldHashes, newHashes;
+  for (unsigned i = 0; i < oldBlocks.size(); ++i) {
+    if (M.Blocks[i] != NoId)
+      continue;
+    std::pair<unsigned, unsigned> &entry = oldHashes[hashBlock(*oldBlocks[i])];
+    ++entry.first;
+    entry.second = i;
+  }
+  for (unsigned i = 0; i < newBlocks.size(); ++i) {
+    if (newMatched[i])
+      continue;
+    std::pair<unsigned, unsigned> &entry = newHashes[hashBlock(*newBlocks[i])];
+    ++entry.first;
+    entry.second = i;
+  }
+  for (auto hi = oldHashes.begin(), he = oldHashes.end(); hi != he; ++hi) {
+    auto nhi = newHashes.find(hi->first);
+    if (hi->second.first == 1 && nhi != newHashes.end()
+        && nhi->second.first == 1)
+      M.Blocks[hi->second.second] = nhi->second.second;
+  }
+
+  // Instructions by name, then the unnamed ones of matched blocks by opcode
+  // and position among the unnamed instructions with that opcode
+  for (unsigned i = 0; i < oldBlocks.size(); ++i) {
+    DenseMap<unsigned, SmallVector<unsigned, 4> > unnamed; // opcode -> IDs
+    if (M.Blocks[i] != NoId) {
+      const BasicBlock *NB = newBlocks[M.Blocks[i]];
+      unsigned id = newFirst[M.Blocks[i]];
+      for (auto ii = NB->begin(), ie = NB->end(); ii != ie; ++ii, ++id) {
+        if (!ii->hasName())
+          unnamed[ii->getOpcode()].push_back(id);
+      }
+    }
+
+    DenseMap<unsigned, unsigned> seen; // opcode -> unnamed so far
+    unsigned id = oldFirst[i];
+    for (auto ii = oldBlocks[i]->begin(), ie = oldBlocks[i]->end(); ii != ie;
+        ++ii, ++id) {
+      if (ii->hasName()) {
+        Value *V = symbols.lookup(ii->getName());
+        if (V != NULL && isa<Instruction>(V))
+          M.Insts[id] = newIds.lookup(V);
+        continue;
+      }
+
+      unsigned n = seen[ii->getOpcode()]++;
+      auto ui = unnamed.find(ii->getOpcode());
+      if (ui != unnamed.end() && n < ui->second.size())
+        M.Insts[id] = ui->second[n];
+    }
+  }
+}
+
+// The dependencies of a record as keys, in record order. Each category is
+// translated with Match if it is not NULL; a dependence that cannot be
+// translated gets the flag false in Ok.
+namespace {
+  struct RecordKeys {
+    std::vector<DepKey> Local, NonLocal, Edges, Branches;
+    std::vector<bool> LocalOk, NonLocalOk, EdgesOk, BranchesOk;
+
+    RecordKeys(const DepRecordView &R, const Matching *Match) {
+      for (uint32_t i = 0; i < R.numLocal(); ++i) {
+        const LocalDep &d = R.localDeps()[i];
+        bool ok = true;
+        uint32_t inst = translateInst(Match, d.Inst, ok);
+        uint32_t dep = translateInst(Match, d.DepInst, ok);
+        Local.push_back(DepKey(inst, dep, d.Type, 0, 0));
+        LocalOk.push_back(ok);
+      }
+
+      for (uint32_t s = 0; s < R.numNonLocalInsts(); ++s) {
+        const NonLocalSpan &span = R.nonLocalSpans()[s];
+        for (uint32_t j = span.First; j < span.First + span.Count; ++j) {
+          const NonLocalDep &d = R.nonLocalResults()[j];
+          bool ok = true;
+          uint32_t inst = translateInst(Match, span.Inst, ok);
+          uint32_t block = Match ? Match->block(d.Block, ok) : d.Block;
+          uint32_t dep = translateInst(Match, d.DepInst, ok);
+          uint32_t address = Match ? Match->address(d.Address, ok)
+            : d.Address;
+          NonLocal.push_back(DepKey(inst, block, dep, d.Type, address));
+          NonLocalOk.push_back(ok);
+        }
+      }
+
+      for (uint32_t b = 0; b < R.numBlocks(); ++b) {
+        for (uint32_t j = R.cdOffsets()[b]; j < R.cdOffsets()[b + 1]; ++j) {
+          bool ok = true;
+          uint32_t ctrl = Match ? Match->block(b, ok) : b;
+          uint32_t dep = Match ? Match->block(R.cdTargets()[j], ok)
+            : R.cdTargets()[j];
+          Edges.push_back(DepKey(ctrl, dep, 0, 0, 0));
+          EdgesOk.push_back(ok);
+        }
+      }
+
+      for (uint32_t i = 0; i < R.numCDBranches(); ++i) {
+        const depformat::CDBranch &d = R.cdBranches()[i];
+        bool ok = true;
+        uint32_t ctrl = Match ? Match->block(d.Controller, ok) : d.Controller;
+        uint32_t dep = Match ? Match->block(d.Dependent, ok) : d.Dependent;
+        uint32_t succ = Match ? Match->block(d.Successor, ok) : d.Successor;
+        Branches.push_back(DepKey(ctrl, dep, succ, 0, 0));
+        BranchesOk.push_back(ok);
+      }
+    }
+
+    static uint32_t translateInst(const Matching *Match, uint32_t Id,
+        bool &Ok) {
+      return Match ? Match->inst(Id, Ok) : Id;
+    }
+  };
+} // end namespace
+
+// Sets Keep[i] for the keys of Keys (with Ok[i]) that are not in Other.
+// Keys without Ok are always kept. Returns the number kept.
+static unsigned missingFrom(const std::vector<DepKey> &Keys,
+    const std::vector<bool> &Ok, const std::vector<DepKey> &Other,
+    const std::vector<bool> &OtherOk, std::vector<bool> &Keep) {
+  std::vector<DepKey> sorted;
+  for (unsigned i = 0; i < Other.size(); ++i) {
+    if (OtherOk[i])
+      sorted.push_back(Other[i]);
+  }
+  std::sort(sorted.begin(), sorted.end());
+
+  unsigned kept = 0;
+  Keep.assign(Keys.size(), false);
+  for (unsigned i = 0; i < Keys.size(); ++i) {
+    if (!Ok[i] || !std::binary_search(sorted.begin(), sorted.end(), Keys[i])) {
+      Keep[i] = true;
+      ++kept;
+    }
+  }
+  return kept;
+}
+
+// Fills Out with the dependencies of R selected by the Keep flags of each
+// category (in record order, see RecordKeys)
+static void selectRecord(const DepRecordView &R,
+    const std::vector<bool> &Local, const std::vector<bool> &NonLocal,
+    const std::vector<bool> &Edges, const std::vector<bool> &Branches,
+    DepRecordData &Out) {
+  Out.Name.assign(R.name(), R.nameLength());
+  Out.BlockStarts.assign(R.blockStarts(), R.blockStarts() + R.numBlocks() + 1);
+
+  for (uint32_t i = 0; i < R.numLocal(); ++i) {
+    if (Local[i])
+      Out.Local.push_back(R.localDeps()[i]);
+  }
+
+  unsigned result = 0;
+  for (uint32_t s = 0; s < R.numNonLocalInsts(); ++s) {
+    const NonLocalSpan &span = R.nonLocalSpans()[s];
+    NonLocalSpan out;
+    out.Inst = span.Inst;
+    out.First = Out.Results.size();
+    for (uint32_t j = span.First; j < span.First + span.Count; ++j, ++result) {
+      if (NonLocal[result])
+        Out.Results.push_back(R.nonLocalResults()[j]);
+    }
+    out.Count = Out.Results.size() - out.First;
+    if (out.Count != 0)
+      Out.Spans.push_back(out);
+  }
+
+  unsigned edge = 0;
+  for (uint32_t b = 0; b < R.numBlocks(); ++b) {
+    Out.CDOffsets.push_back(Out.CDTargets.size());
+    for (uint32_t j = R.cdOffsets()[b]; j < R.cdOffsets()[b + 1]; ++j, ++edge) {
+      if (Edges[edge])
+        Out.CDTargets.push_back(R.cdTargets()[j]);
+    }
+  }
+  Out.CDOffsets.push_back(Out.CDTargets.size());
+
+  for (uint32_t i = 0; i < R.numCDBranches(); ++i) {
+    if (Branches[i])
+      Out.Branches.push_back(R.cdBranches()[i]);
+  }
+}
+
+DepDiff::DepDiff(Module &Old, Module &New) : old_(Old), new_(New),
+  numUnchanged_(0), numAnalyzed_(0), numChanged_(0) { }
+
+void DepDiff::run(raw_ostream &Out) {
+  numUnchanged_ = numAnalyzed_ = numChanged_ = 0;
+  VersionAnalyzer oldAnalyzer(old_), newAnalyzer(new_);
+  DepExportWriter writer(Out, DepExportWriter::Binary, DiffMagic);
+
+  // The pairs (old, new) to compare with their function IDs; either may be
+  // NULL if the function is only defined in one version
+  struct Pair {
+    Function *Old, *New;
+    uint32_t OldId, NewId;
+  };
+  std::vector<Pair> pairs;
+  DenseMap<const Function *, uint32_t> oldIds;
+  {
+    uint32_t id = 0;
+    for (auto fi = old_.begin(), fe = old_.end(); fi != fe; ++fi)
+      oldIds[&*fi] = id++;
+  }
+  uint32_t newId = 0;
+  for (auto fi = new_.begin(), fe = new_.end(); fi != fe; ++fi, ++newId) {
+    Function *G = fi->hasName() ? old_.getFunction(fi->getName()) : NULL;
+    Pair p;
+    p.Old = (G != NULL && !G->isDeclaration()) ? G : NULL;
+    p.New = fi->isDeclaration() ? NULL : &*fi;
+    p.OldId = p.Old ? oldIds.lookup(p.Old) : NoId;
+    p.NewId = newId;
+    if (p.Old == NULL && p.New == NULL)
+      continue;
+
+    // Identical IR gives identical results. The hash includes the
+    // attributes of the callees and the constness and linkage of the
+    // globals used (see FunctionHash.h), which -basicaa reads, so a change
+    // to those alone is analyzed instead of reported as unchanged.
+    if (p.Old && p.New && hashFunction(*p.Old) == hashFunction(*p.New)) {
+      ++numUnchanged_;
+      ++NumDiffUnchanged;
+      continue;
+    }
+    pairs.push_back(p);
+  }
+  for (auto fi = old_.begin(), fe = old_.end(); fi != fe; ++fi) {
+    if (fi->isDeclaration())
+      continue;
+    if (fi->hasName() && new_.getFunction(fi->getName()) != NULL)
+      continue;
+    Pair p;
+    p.Old = &*fi;
+    p.New = NULL;
+    p.OldId = oldIds.lookup(p.Old);
+    p.NewId = NoId;
+    pairs.push_back(p);
+  }
+
+  DepRecordView empty;
+  for (auto pi = pairs.begin(), pe = pairs.end(); pi != pe; ++pi) {
+    ++numAnalyzed_;
+    ++NumDiffAnalyzed;
+
+    std::vector<uint32_t> oldRecord, newRecord;
+    DepRecordView oldView, newView;
+    if ((pi->Old && !oldAnalyzer.analyze(*pi->Old, oldRecord, oldView))
+        || (pi->New && !newAnalyzer.analyze(*pi->New, newRecord, newView))) {
+      errs() << "[Warning] Invalid record while comparing "
+             << (pi->New ? pi->New : pi->Old)->getName() << '\n';
+      continue;
+    }
+
+    Matching match;
+    if (pi->Old && pi->New)
+      matchFunctions(*pi->Old, *pi->New, match);
+    RecordKeys oldKeys(pi->Old ? oldView : empty, &match);
+    RecordKeys newKeys(pi->New ? newView : empty, NULL);
+
+    // Removed: old dependencies not found in the new version, and the
+    // other way around
+    std::vector<bool> local, nonLocal, edges, branches;
+    unsigned removed = 0, added = 0;
+    if (pi->Old) {
+      removed += missingFrom(oldKeys.Local, oldKeys.LocalOk, newKeys.Local,
+          newKeys.LocalOk, local);
+      removed += missingFrom(oldKeys.NonLocal, oldKeys.NonLocalOk,
+          newKeys.NonLocal, newKeys.NonLocalOk, nonLocal);
+      removed += missingFrom(oldKeys.Edges, oldKeys.EdgesOk, newKeys.Edges,
+          newKeys.EdgesOk, edges);
+      removed += missingFrom(oldKeys.Branches, oldKeys.BranchesOk,
+          newKeys.Branches, newKeys.BranchesOk, branches);
+      if (removed != 0) {
+        DepRecordData data;
+        selectRecord(oldView, local, nonLocal, edges, branches, data);
+        writer.writeFunction(pi->OldId | RemovedFlag, data);
+      }
+    }
+    if (pi->New) {
+      added += missingFrom(newKeys.Local, newKeys.LocalOk, oldKeys.Local,
+          oldKeys.LocalOk, local);
+      added += missingFrom(newKeys.NonLocal, newKeys.NonLocalOk,
+          oldKeys.NonLocal, oldKeys.NonLocalOk, nonLocal);
+      added += missingFrom(newKeys.Edges, newKeys.EdgesOk, oldKeys.Edges,
+          oldKeys.EdgesOk, edges);
+      added += missingFrom(newKeys.Branches, newKeys.BranchesOk,
+          oldKeys.Branches, oldKeys.BranchesOk, branches);
+      if (added != 0) {
+        DepRecordData data;
+        selectRecord(newView, local, nonLocal, edges, branches, data);
+        writer.writeFunction(pi->NewId, data);
+      }
+    }
+
+    NumDiffRemoved += removed;
+    NumDiffAdded += added;
+    if (removed != 0 || added != 0)
+      ++numChanged_;
+  }
+  writer.finish();
+}
+
+unsigned DepDiff::numUnchanged() const {
+  return numUnchanged_;
+}
+
+unsigned DepDiff::numAnalyzed() const {
+  return numAnalyzed_;
+}
+
+unsigned DepDiff::numChanged() const {
+  return numChanged_;
+}
@@ -0,0 +1,62 @@
+// Author: Markus Kusano
+//
+// Differential comparison of the dependencies of two versions of a module,
+// e.g., before and after an optimization.
+//
+// Functions are matched by name. A function with the same structural hash
+// (see FunctionHash.h) in both versions has the same results and is only
+// hashed. The hash covers the attributes of the callees and the constness
+// and linkage of the globals a function uses, so changes that only touch
+// those (e.g., -functionattrs marking a callee readonly) are still
+// compared. The other functions are analyzed in both versions with
+// FunctionDependence, on pass managers of their own that use -basicaa and
+// -tbaa and the TargetLibraryInfo of the module's triple (so differences in
+// the analyses given to opt do not show up as changed dependencies), and
+// their results are compared:
+//
+//  - Blocks are matched by name. The remaining ones are matched by a hash
+//    of their opcodes if the hash is unique among them in both versions.
+//  - Instructions are matched by name. Unnamed instructions of matched
+//    blocks are matched by opcode and by their position among the unnamed
+//    instructions of their block with that opcode.
+//
+// A local, non-local or control dependence (and each control dependence
+// branch) is unchanged if all its blocks and instructions are matched and
+// the matched dependence exists in the other version. The others are
+// written to a diff file (see DepFormat.h) as removed (old version) or added
+// (new version). A function only found in one version has all its
+// dependencies removed or added.
+//
+//  DepDiff D(*Old, M);
+//  D.run(Out);
+
+#ifndef DEP_DIFF_H
+#define DEP_DIFF_H
+
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+class DepDiff {
+  public:
+    DepDiff(Module &Old, Module &New);
+
+    // Compares the functions of both versions and writes the diff file to
+    // Out, which should be opened in binary mode
+    void run(raw_ostream &Out);
+
+    // Counts of the last run()
+    unsigned numUnchanged() const; // same hash, not analyzed
+    unsigned numAnalyzed() const;  // analyzed in at least one version
+    unsigned numChanged() const;   // analyzed and with different results
+
+  private:
+    Module &old_;
+    Module &new_;
+    unsigned numUnchanged_;
+    unsigned numAnalyzed_;
+    unsigned numChanged_;
+};
+
+#endif // DEP_DIFF_H
@@ -0,0 +1,519 @@
+// Author: Markus Kusano
+//
+// See DepExport.h for more information
+
+#include "DepExport.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+
+#include <algorithm>
+
+using namespace depformat;
+
+// Little-endian output helpers
+static void writeU32(raw_ostream &Out, uint32_t V) {
+  char buf[4] = { char(V), char(V >> 8), char(V >> 16), char(V >> 24) };
+  Out.write(buf, 4);
+}
+
+static void writeU64(raw_ostream &Out, uint64_t V) {
+  writeU32(Out, uint32_t(V));
+  writeU32(Out, uint32_t(V >> 32));
+}
+
+// Name length rounded up to a multiple of 4
+static uint32_t paddedSize(uint32_t N) {
+  return (N + 3) & ~3u;
+}
+
+// Returns the ID of V in Data if it is an instruction, NoId otherwise
+static uint32_t instId(const DataDependence::FunctionDeps &Data,
+    const Value *V) {
+  const Instruction *I = dyn_cast_or_null<Instruction>(V);
+  unsigned id;
+  if (I == NULL || !Data.getId(I, id))
+    return NoId;
+  return id;
+}
+
+// Returns the pointer operand of a load, store or va_arg, or NULL
+static const Value *queryPointer(const Instruction *I) {
+  if (const LoadInst *LI = dyn_cast<LoadInst>(I))
+    return LI->getPointerOperand();
+  if (const StoreInst *SI = dyn_cast<StoreInst>(I))
+    return SI->getPointerOperand();
+  if (const VAArgInst *VI = dyn_cast<VAArgInst>(I))
+    return VI->getPointerOperand();
+  return NULL;
+}
+
+// Encodes the address of a non-local result of Query (see DepFormat.h)
+static uint32_t addressId(const DataDependence::FunctionDeps &Data,
+    const Instruction *Query, const Value *Address) {
+  if (Address == NULL)
+    return NoId;
+  if (isa<Instruction>(Address))
+    return instId(Data, Address);
+  if (const Argument *A = dyn_cast<Argument>(Address))
+    return ArgumentFlag | A->getArgNo();
+  if (Address == queryPointer(Query))
+    return QueryPointer;
+  return NoId;
+}
+
+// Returns the ID of the instruction a non-local result depends on, or NoId
+static uint32_t depInstId(const DataDependence::NonLocalDep &R) {
+  return R.hasDepInst() ? R.DepInst_ : NoId;
+}
+
+// Per-function ID tables shared by both formats
+namespace {
+  struct FunctionLayout {
+    explicit FunctionLayout(const Function &F) {
+      numInsts = 0;
+      for (auto bi = F.begin(), be = F.end(); bi != be; ++bi) {
+        blockStarts.push_back(numInsts);
+        numInsts += bi->size();
+      }
+      blockStarts.push_back(numInsts);
+    }
+
+    unsigned numBlocks() const {
+      return blockStarts.size() - 1;
+    }
+
+    std::vector<uint32_t> blockStarts;
+    uint32_t numInsts;
+  };
+} // end namespace
+
+DepExportWriter::DepExportWriter(raw_ostream &Out, Format Fmt, uint32_t Magic)
+  : out_(Out), fmt_(Fmt), compactDot_(false) {
+  if (fmt_ == Binary) {
+    writeU32(out_, Magic);
+    writeU32(out_, Version);
+  }
+}
+
+void DepExportWriter::setModule(const Module &M) {
+  functionIds_.clear();
+  unsigned id = 0;
+  for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi)
+    functionIds_[&*fi] = id++;
+}
+
+void DepExportWriter::setCompactDot(bool Compact) {
+  compactDot_ = Compact;
+}
+
+void DepExportWriter::writeFunction(const Function &F,
+    const DataDependence::FunctionDeps *Data, const CompactCDG *Control) {
+  auto it = functionIds_.find(&F);
+  assert(it != functionIds_.end() && "function is not part of the module");
+
+  switch (fmt_) {
+    case JSONLines:
+      writeJSON(it->second, F, Data, Control);
+      return;
+    case Text:
+      writeText(F, Data, Control);
+      return;
+    case Dot:
+      if (Control != NULL)
+        ControlDependence::writeDot(out_, *Control, compactDot_);
+      return;
+    case Binary:
+      break;
+  }
+
+  IndexEntry entry;
+  entry.FunctionId = it->second;
+  entry.Reserved = 0;
+  entry.Offset = out_.tell();
+  index_.push_back(entry);
+
+  writeRecord(out_, it->second, F, Data, Control);
+}
+
+void DepExportWriter::writeFunction(uint32_t FunctionId,
+    const DepRecordData &Data) {
+  assert(fmt_ == Binary && "records from arrays are only written as binary");
+
+  IndexEntry entry;
+  entry.FunctionId = FunctionId;
+  entry.Reserved = 0;
+  entry.Offset = out_.tell();
+  index_.push_back(entry);
+
+  writeRecord(out_, FunctionId, Data);
+}
+
+void DepExportWriter::finish() {
+  if (fmt_ == Binary) {
+    std::sort(index_.begin(), index_.end(),
+        [](const IndexEntry &A, const IndexEntry &B) {
+          return A.FunctionId < B.FunctionId;
+        });
+
+    uint64_t indexOffset = out_.tell();
+    writeU32(out_, IndexMagic);
+    writeU32(out_, index_.size());
+    for (auto i = index_.begin(), e = index_.end(); i != e; ++i) {
+      writeU32(out_, i->FunctionId);
+      writeU32(out_, i->Reserved);
+      writeU64(out_, i->Offset);
+    }
+
+    writeU64(out_, indexOffset);
+    writeU32(out_, TrailerMagic);
+    writeU32(out_, Version);
+    index_.clear();
+  }
+  out_.flush();
+}
+
+bool DepExportWriter::isRepresentable(
+    const DataDependence::FunctionDeps &Data) {
+  for (unsigned i = 0; i < Data.size(); ++i) {
+    ArrayRef<DataDependence::NonLocalDep> deps = Data.getNonLocalDeps(i);
+    for (auto j = deps.begin(), ej = deps.end(); j != ej; ++j) {
+      if (j->Address_ != NULL
+          && addressId(Data, Data.getInst(i), j->Address_) == NoId)
+        return false;
+    }
+  }
+  return true;
+}
+
+void DepExportWriter::writeRecord(raw_ostream &Out, unsigned FunctionId,
+    const Function &F, const DataDependence::FunctionDeps *Data,
+    const CompactCDG *Control) {
+  FunctionLayout layout(F);
+  uint32_t numBlocks = layout.numBlocks();
+  StringRef name = F.getName();
+
+  uint32_t numLocal = 0;
+  uint32_t numNLInsts = 0;
+  uint32_t numNLResults = 0;
+  if (Data != NULL) {
+    assert(Data->size() == layout.numInsts && "function changed");
+    numLocal = Data->NumLocal_;
+    numNLInsts = Data->NumNonLocal_;
+    numNLResults = Data->NonLocal_.size();
+  }
+  uint32_t numEdges = Control ? Control->numEdges() : 0;
+  uint32_t numBranches = Control ? Control->numBranches() : 0;
+
+  uint32_t size = 4 * 4 + paddedSize(name.size())
+    + 4 * 2 + 4 * (numBlocks + 1)
+    + 4 + sizeof(LocalDep) * numLocal
+    + 4 * 2 + sizeof(NonLocalSpan) * numNLInsts
+    + sizeof(NonLocalDep) * numNLResults
+    + 4 + 4 * (numBlocks + 1) + 4 * numEdges
+    + 4 + sizeof(depformat::CDBranch) * numBranches;
+
+  writeU32(Out, FunctionMagic);
+  writeU32(Out, size);
+  writeU32(Out, FunctionId);
+  writeU32(Out, name.size());
+  Out << name;
+  for (uint32_t i = name.size(); i < paddedSize(name.size()); ++i)
+    Out << '\0';
+
+  writeU32(Out, numBlocks);
+  writeU32(Out, layout.numInsts);
+  for (auto i = layout.blockStarts.begin(), e = layout.blockStarts.end();
+      i != e; ++i)
+    writeU32(Out, *i);
+
+  // Local dependencies
+  writeU32(Out, numLocal);
+  if (Data != NULL) {
+    for (unsigned i = 0; i < Data->size(); ++i) {
+      const DataDependence::DepInfo &info = Data->getLocalDep(i);
+      if (!info.valid())
+        continue;
+      writeU32(Out, i);
+      writeU32(Out, instId(*Data, info.DepInst_));
+      writeU32(Out, info.Type_);
+    }
+  }
+
+  // Non-local dependencies: the spans first, then all the results
+  writeU32(Out, numNLInsts);
+  writeU32(Out, numNLResults);
+  if (Data != NULL) {
+    uint32_t first = 0;
+    for (unsigned i = 0; i < Data->size(); ++i) {
+      ArrayRef<DataDependence::NonLocalDep> deps = Data->getNonLocalDeps(i);
+      if (deps.empty())
+        continue;
+      writeU32(Out, i);
+      writeU32(Out, first);
+      writeU32(Out, deps.size());
+      first += deps.size();
+    }
+
+    for (unsigned i = 0; i < Data->size(); ++i) {
+      ArrayRef<DataDependence::NonLocalDep> deps = Data->getNonLocalDeps(i);
+      for (auto j = deps.begin(), ej = deps.end(); j != ej; ++j) {
+        writeU32(Out, j->Block_);
+        writeU32(Out, depInstId(*j));
+        writeU32(Out, j->getType());
+        writeU32(Out, addressId(*Data, Data->getInst(i), j->Address_));
+      }
+    }
+  }
+
+  // Control dependencies
+  writeU32(Out, numEdges);
+  assert((Control == NULL || Control->size() == numBlocks) && "function changed");
+  // The rows are expanded from the regions of the CDG. The number of
+  // dependents of a block is the total size of its dependent regions.
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < numBlocks; ++i) {
+    writeU32(Out, offset);
+    if (Control != NULL) {
+      ArrayRef<unsigned> regions = Control->dependentRegions(i);
+      for (auto j = regions.begin(), ej = regions.end(); j != ej; ++j)
+        offset += Control->regionBlocks(*j).size();
+    }
+  }
+  writeU32(Out, offset);
+  if (Control != NULL) {
+    SmallVector<unsigned, 16> deps;
+    for (uint32_t i = 0; i < numBlocks; ++i) {
+      deps.clear();
+      Control->dependents(i, deps);
+      for (auto j = deps.begin(), ej = deps.end(); j != ej; ++j)
+        writeU32(Out, *j);
+    }
+  }
+
+  // The branches sorted by dependent: the conditions of each block
+  writeU32(Out, numBranches);
+  if (Control != NULL) {
+    for (uint32_t i = 0; i < numBlocks; ++i) {
+      ArrayRef<CDCondition> conds = Control->conditions(i);
+      for (auto j = conds.begin(), ej = conds.end(); j != ej; ++j) {
+        writeU32(Out, j->Controller);
+        writeU32(Out, i);
+        writeU32(Out, j->Successor);
+      }
+    }
+  }
+}
+
+void DepExportWriter::writeRecord(raw_ostream &Out, uint32_t FunctionId,
+    const DepRecordData &Data) {
+  assert(!Data.BlockStarts.empty() && "record without block starts");
+  uint32_t numBlocks = Data.BlockStarts.size() - 1;
+  assert(Data.CDOffsets.size() == numBlocks + 1 && "malformed CDG rows");
+
+  uint32_t size = 4 * 4 + paddedSize(Data.Name.size())
+    + 4 * 2 + 4 * (numBlocks + 1)
+    + 4 + sizeof(LocalDep) * Data.Local.size()
+    + 4 * 2 + sizeof(NonLocalSpan) * Data.Spans.size()
+    + sizeof(NonLocalDep) * Data.Results.size()
+    + 4 + 4 * (numBlocks + 1) + 4 * Data.CDTargets.size()
+    + 4 + sizeof(depformat::CDBranch) * Data.Branches.size();
+
+  writeU32(Out, FunctionMagic);
+  writeU32(Out, size);
+  writeU32(Out, FunctionId);
+  writeU32(Out, Data.Name.size());
+  Out << Data.Name;
+  for (uint32_t i = Data.Name.size(); i < paddedSize(Data.Name.size()); ++i)
+    Out << '\0';
+
+  writeU32(Out, numBlocks);
+  writeU32(Out, Data.BlockStarts.back());
+  for (auto i = Data.BlockStarts.begin(), e = Data.BlockStarts.end(); i != e;
+      ++i)
+    writeU32(Out, *i);
+
+  writeU32(Out, Data.Local.size());
+  for (auto i = Data.Local.begin(), e = Data.Local.end(); i != e; ++i) {
+    writeU32(Out, i->Inst);
+    writeU32(Out, i->DepInst);
+    writeU32(Out, i->Type);
+  }
+
+  writeU32(Out, Data.Spans.size());
+  writeU32(Out, Data.Results.size());
+  for (auto i = Data.Spans.begin(), e = Data.Spans.end(); i != e; ++i) {
+    writeU32(Out, i->Inst);
+    writeU32(Out, i->First);
+    writeU32(Out, i->Count);
+  }
+  for (auto i = Data.Results.begin(), e = Data.Results.end(); i != e; ++i) {
+    writeU32(Out, i->Block);
+    writeU32(Out, i->DepInst);
+    writeU32(Out, i->Type);
+    writeU32(Out, i->Address);
+  }
+
+  writeU32(Out, Data.CDTargets.size());
+  for (auto i = Data.CDOffsets.begin(), e = Data.CDOffsets.end(); i != e; ++i)
+    writeU32(Out, *i);
+  for (auto i = Data.CDTargets.begin(), e = Data.CDTargets.end(); i != e; ++i)
+    writeU32(Out, *i);
+
+  writeU32(Out, Data.Branches.size());
+  for (auto i = Data.Branches.begin(), e = Data.Branches.end(); i != e; ++i) {
+    writeU32(Out, i->Controller);
+    writeU32(Out, i->Dependent);
+    writeU32(Out, i->Successor);
+  }
+}
+
+void writeJSONString(raw_ostream &Out, StringRef S) {
+  Out << '"';
+  for (auto c = S.begin(), e = S.end(); c != e; ++c) {
+    unsigned char ch = *c;
+    if (ch == '"' || ch == '\\') {
+      Out << '\\' << *c;
+    }
+    else if (ch < 0x20) {
+      static const char hex[] = "0123456789abcdef";
+      Out << "\\u00" << hex[ch >> 4] << hex[ch & 0xf];
+    }
+    else {
+      Out << *c;
+    }
+  }
+  Out << '"';
+}
+
+// Writes an ID, using null for NoId
+static void writeJSONId(raw_ostream &Out, uint32_t Id) {
+  if (Id == NoId)
+    Out << "null";
+  else
+    Out << Id;
+}
+
+// Writes an encoded address: an instruction ID, {"arg":N}, "query" (the
+// pointer operand of the instruction) or null
+static void writeJSONAddress(raw_ostream &Out, uint32_t Address) {
+  if (Address == QueryPointer)
+    Out << "\"query\"";
+  else if (Address != NoId && (Address & ArgumentFlag))
+    Out << "{\"arg\":" << (Address & ~ArgumentFlag) << '}';
+  else
+    writeJSONId(Out, Address);
+}
+
+void DepExportWriter::writeJSON(unsigned FunctionId, const Function &F,
+    const DataDependence::FunctionDeps *Data, const CompactCDG *Control) {
+  FunctionLayout layout(F);
+
+  out_ << "{\"function\":" << FunctionId << ",\"name\":";
+  writeJSONString(out_, F.getName());
+  out_ << ",\"blocks\":" << layout.numBlocks()
+       << ",\"insts\":" << layout.numInsts << ",\"block_starts\":[";
+  for (unsigned i = 0; i < layout.blockStarts.size(); ++i)
+    out_ << (i ? "," : "") << layout.blockStarts[i];
+  out_ << ']';
+
+  // "local": [[inst, dep inst, type], ...]
+  out_ << ",\"local\":[";
+  bool first = true;
+  if (Data != NULL) {
+    for (unsigned i = 0; i < Data->size(); ++i) {
+      const DataDependence::DepInfo &info = Data->getLocalDep(i);
+      if (!info.valid())
+        continue;
+      out_ << (first ? "" : ",") << '[' << i << ',';
+      writeJSONId(out_, instId(*Data, info.DepInst_));
+      out_ << ",\"" << DataDependence::depTypeToString(info.Type_) << "\"]";
+      first = false;
+    }
+  }
+  out_ << ']';
+
+  // "nonlocal": [[inst, [[block, dep inst, type, address], ...]], ...]
+  out_ << ",\"nonlocal\":[";
+  first = true;
+  if (Data != NULL) {
+    for (unsigned i = 0; i < Data->size(); ++i) {
+      ArrayRef<DataDependence::NonLocalDep> deps = Data->getNonLocalDeps(i);
+      if (deps.empty())
+        continue;
+      out_ << (first ? "" : ",") << '[' << i << ",[";
+      for (unsigned j = 0; j < deps.size(); ++j) {
+        out_ << (j ? "," : "") << '[';
+        writeJSONId(out_, deps[j].Block_);
+        out_ << ',';
+        writeJSONId(out_, depInstId(deps[j]));
+        out_ << ",\""
+             << DataDependence::depTypeToString(deps[j].getType()) << "\",";
+        writeJSONAddress(out_,
+            addressId(*Data, Data->getInst(i), deps[j].Address_));
+        out_ << ']';
+      }
+      out_ << "]]";
+      first = false;
+    }
+  }
+  out_ << ']';
+
+  // "control": [[controlling block, [dependent blocks]], ...]
+  out_ << ",\"control\":[";
+  first = true;
+  if (Control != NULL) {
+    SmallVector<unsigned, 16> deps;
+    for (unsigned i = 0; i < Control->size(); ++i) {
+      deps.clear();
+      Control->dependents(i, deps);
+      if (deps.empty())
+        continue;
+      out_ << (first ? "" : ",") << '[' << i << ",[";
+      for (unsigned j = 0; j < deps.size(); ++j)
+        out_ << (j ? "," : "") << deps[j];
+      out_ << "]]";
+      first = false;
+    }
+  }
+  out_ << ']';
+
+  // "control_branches": [[controlling block, dependent block, successor],
+  // ...]
+  out_ << ",\"control_branches\":[";
+  first = true;
+  if (Control != NULL) {
+    for (unsigned i = 0; i < Control->size(); ++i) {
+      ArrayRef<CDCondition> conds = Control->conditions(i);
+      for (auto j = conds.begin(), ej = conds.end(); j != ej; ++j) {
+        out_ << (first ? "" : ",") << '[' << j->Controller << ',' << i << ','
+             << j->Successor << ']';
+        first = false;
+      }
+    }
+  }
+  out_ << "]}\n";
+}
+
+void DepExportWriter::writeText(const Function &F,
+    const DataDependence::FunctionDeps *Data, const CompactCDG *Control) {
+  // The sections of DependenceCheck::print() for one function
+  out_ << "Function: " << F.getName() << '\n';
+
+  for (unsigned i = 0; Data != NULL && i < Data->size(); ++i)
+    Data->printLocalDep(out_, i);
+  for (unsigned i = 0; Data != NULL && i < Data->size(); ++i)
+    Data->printNonLocalDeps(out_, i);
+
+  SmallVector<unsigned, 16> deps;
+  for (unsigned i = 0; Control != NULL && i < Control->size(); ++i) {
+    deps.clear();
+    Control->dependents(i, deps);
+    if (deps.empty())
+      continue;
+
+    out_ << "BasicBlock: " << *(Control->getBlock(i)) << "Is dependent on:\n";
+    for (auto j = deps.begin(), ej = deps.end(); j != ej; ++j)
+      out_ << *(Control->getBlock(*j)) << '\n';
+  }
+}
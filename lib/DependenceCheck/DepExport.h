@@ -0,0 +1,125 @@
+// Author: Markus Kusano
+//
+// Machine readable export of the dependence information.
+//
+// Two machine readable formats are supported: a compact binary format (see
+// DepFormat.h) and JSON lines (one JSON object per function). Both use the
+// stable function, block and instruction IDs described in DepFormat.h and
+// never print the IR of instructions or blocks. The text and DOT formats are
+// for people: they print the IR like DependenceCheck::print() and
+// ControlDependence::writeDot() (one graph per function), one function at a
+// time.
+//
+// Functions are written one at a time, as soon as their results are
+// available. For example:
+//
+//  DepExportWriter W(Out, DepExportWriter::Binary);
+//  W.setModule(M);
+//  for (each function F) {
+//    ... calculate DataDep and ControlDep for F ...
+//    W.writeFunction(F, DataDep.getFunctionDeps(&F),
+//        ControlDep.getCompactCDG(&F));
+//  }
+//  W.finish();
+
+#ifndef DEP_EXPORT_H
+#define DEP_EXPORT_H
+
+#include "ControlDependence.h"
+#include "DataDependence.h"
+#include "DepFormat.h"
+
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+// The arrays of a binary function record (see DepFormat.h), for records
+// that are not written directly from analysis results (e.g., the
+// differences of two records, see DepDiff.h). The arrays must be sorted as
+// in the format.
+struct DepRecordData {
+  std::string Name;
+  std::vector<uint32_t> BlockStarts;
+  std::vector<depformat::LocalDep> Local;
+  std::vector<depformat::NonLocalSpan> Spans;
+  std::vector<depformat::NonLocalDep> Results;
+  std::vector<uint32_t> CDOffsets;
+  std::vector<uint32_t> CDTargets;
+  std::vector<depformat::CDBranch> Branches;
+};
+
+// Writes S as a JSON string (quoted and escaped)
+void writeJSONString(raw_ostream &Out, StringRef S);
+
+class DepExportWriter {
+  public:
+    enum Format {
+      Binary = 0,
+      JSONLines = 1,
+      Text = 2,
+      Dot = 3
+    };
+
+    // Out must stay open until finish() has been called. For the binary
+    // format Out should be opened in binary mode. Magic is the first word
+    // of a binary file (see DepFormat.h).
+    DepExportWriter(raw_ostream &Out, Format Fmt,
+        uint32_t Magic = depformat::FileMagic);
+
+    // Assigns the function IDs. Must be called before writeFunction().
+    void setModule(const Module &M);
+
+    // Label the nodes of the DOT format with block names instead of their
+    // IR (see ControlDependence::toDot())
+    void setCompactDot(bool Compact);
+
+    // Writes the results of F. Data or Control may be NULL if the
+    // corresponding results were not calculated.
+    void writeFunction(const Function &F,
+        const DataDependence::FunctionDeps *Data, const CompactCDG *Control);
+
+    // Writes a record built from its arrays with the given function ID.
+    // Only supported by the binary format.
+    void writeFunction(uint32_t FunctionId, const DepRecordData &Data);
+
+    // Writes the index and trailer (binary format) and flushes the output
+    void finish();
+
+    // Writes a single binary function record (see DepFormat.h) to Out. This
+    // is also used for files that hold only one function.
+    static void writeRecord(raw_ostream &Out, unsigned FunctionId,
+        const Function &F, const DataDependence::FunctionDeps *Data,
+        const CompactCDG *Control);
+
+    // Same as above for a record built from its arrays
+    static void writeRecord(raw_ostream &Out, uint32_t FunctionId,
+        const DepRecordData &Data);
+
+    // Returns true if writeRecord() can represent every address of the
+    // non-local results in Data (see NonLocalDep::Address in DepFormat.h).
+    // Addresses that are not instructions, arguments or the query's pointer
+    // operand are written as NoId.
+    static bool isRepresentable(const DataDependence::FunctionDeps &Data);
+
+  private:
+    raw_ostream &out_;
+    Format fmt_;
+    bool compactDot_;
+
+    // Function -> stable function ID
+    DenseMap<const Function *, unsigned> functionIds_;
+
+    // Start of each record written so far (binary format)
+    std::vector<depformat::IndexEntry> index_;
+
+    void writeJSON(unsigned FunctionId, const Function &F,
+        const DataDependence::FunctionDeps *Data, const CompactCDG *Control);
+    void writeText(const Function &F,
+        const DataDependence::FunctionDeps *Data, const CompactCDG *Control);
+};
+
+#endif // DEP_EXPORT_H
@@ -0,0 +1,137 @@
+// Author: Markus Kusano
+//
+// Layout of the binary dependence export format. This header has no LLVM
+// dependencies so it can be used by tools that only read results.
+//
+// All values are little-endian. Every record and array is 4 byte aligned.
+//
+// Functions, blocks and instructions are identified by stable IDs:
+//
+//  - Function ID: position of the function in the module (declarations
+//    included)
+//  - Block ID: position of the block in its function
+//  - Instruction ID: position of the instruction in its function in
+//    inst_iterator order (see DataDependence::FunctionDeps)
+//
+// A file is:
+//
+//  u32 FileMagic, u32 Version
+//  function records (any number)
+//  index
+//  trailer
+//
+// A function record is:
+//
+//  u32 FunctionMagic
+//  u32 record size in bytes, including the magic and this field
+//  u32 function ID
+//  u32 name length, followed by the name zero padded to a multiple of 4
+//  u32 NumBlocks
+//  u32 NumInsts
+//  u32 BlockStarts[NumBlocks + 1]   first instruction ID of each block
+//  u32 NumLocal
+//  LocalDep LocalDeps[NumLocal]     sorted by Inst
+//  u32 NumNonLocalInsts
+//  u32 NumNonLocalResults
+//  NonLocalSpan Spans[NumNonLocalInsts]     sorted by Inst
+//  NonLocalDep Results[NumNonLocalResults]
+//  u32 NumCDEdges
+//  u32 CDOffsets[NumBlocks + 1]     CSR rows of the CDG (see CompactCDG)
+//  u32 CDTargets[NumCDEdges]
+//  u32 NumCDBranches
+//  CDBranch Branches[NumCDBranches]   sorted by Dependent, Controller and
+//                                     Successor
+//
+// The index is:
+//
+//  u32 IndexMagic
+//  u32 number of entries
+//  IndexEntry Entries[number of entries]   sorted by function ID
+//
+// And the trailer:
+//
+//  u64 offset of the index from the start of the file
+//  u32 TrailerMagic, u32 Version
+//
+// A diff file (see DepDiff.h) has the same layout with DiffMagic instead of
+// FileMagic. It holds up to two records for every function whose results
+// differ between an old and a new version of a module:
+//
+//  - the dependencies only found in the old version, with the function ID
+//    of the old version or'ed with RemovedFlag and the block and
+//    instruction IDs of the old version
+//  - the dependencies only found in the new version, with the IDs of the
+//    new version
+//
+// Each record holds the blocks and instructions of its own version of the
+// function, so its IDs can be read like those of a normal record.
+
+#ifndef DEP_FORMAT_H
+#define DEP_FORMAT_H
+
+#include <stdint.h>
+
+namespace depformat {
+  const uint32_t FileMagic = 0x47504544;      // "DEPG"
+  const uint32_t FunctionMagic = 0x4e554644;  // "DFUN"
+  const uint32_t IndexMagic = 0x58444944;     // "DIDX"
+  const uint32_t TrailerMagic = 0x45504544;   // "DEPE"
+  const uint32_t DiffMagic = 0x46464944;      // "DIFF"
+  const uint32_t Version = 2;
+
+  // Used for a missing instruction (e.g., NonFuncLocal results) or an
+  // address that cannot be represented
+  const uint32_t NoId = ~0u;
+
+  // Encoding of NonLocalDep::Address. The address is either:
+  //
+  //  - an instruction ID (below ArgumentFlag)
+  //  - ArgumentFlag | argument number
+  //  - QueryPointer: the pointer operand of the queried instruction (used
+  //    for globals and constant expressions, which have no ID)
+  //  - NoId: no address (results of calls)
+  const uint32_t ArgumentFlag = 0x80000000;
+  const uint32_t QueryPointer = ~0u - 1;
+
+  // Set in the function ID of the records of removed dependencies in a diff
+  // file
+  const uint32_t RemovedFlag = 0x80000000;
+
+  // Type values are DataDependence::DepType
+  struct LocalDep {
+    uint32_t Inst;
+    uint32_t DepInst;
+    uint32_t Type;
+  };
+
+  // The non-local results of Inst are Results[First] to
+  // Results[First + Count - 1]
+  struct NonLocalSpan {
+    uint32_t Inst;
+    uint32_t First;
+    uint32_t Count;
+  };
+
+  struct NonLocalDep {
+    uint32_t Block;
+    uint32_t DepInst;
+    uint32_t Type;
+    uint32_t Address;
+  };
+
+  // Dependent is control dependent on Controller through the edge
+  // (Controller->Successor). All three are block IDs.
+  struct CDBranch {
+    uint32_t Controller;
+    uint32_t Dependent;
+    uint32_t Successor;
+  };
+
+  struct IndexEntry {
+    uint32_t FunctionId;
+    uint32_t Reserved;
+    uint64_t Offset;
+  };
+} // end namespace depformat
+
+#endif // DEP_FORMAT_H
@@ -0,0 +1,201 @@
+// Author: Markus Kusano
+//
+// See DepRecord.h for more information
+
+#include "DepRecord.h"
+
+#include <algorithm>
+
+using namespace depformat;
+
+namespace {
+  // Bounds checked cursor over the bytes of a record
+  class Cursor {
+    public:
+      Cursor(const char *Data, size_t Size) : cur_(Data), left_(Size) { }
+
+      // Returns a pointer to the next Count elements of T and advances past
+      // them, or NULL if there are not enough bytes left
+      template <typename T>
+      const T *take(size_t Count) {
+        if (Count > left_ / sizeof(T))
+          return NULL;
+        const T *p = reinterpret_cast<const T *>(cur_);
+        cur_ += Count * sizeof(T);
+        left_ -= Count * sizeof(T);
+        return p;
+      }
+
+      bool u32(uint32_t &V) {
+        const uint32_t *p = take<uint32_t>(1);
+        if (p == NULL)
+          return false;
+        V = *p;
+        return true;
+      }
+
+    private:
+      const char *cur_;
+      size_t left_;
+  };
+} // end namespace
+
+// Every row of a CSR offset array must be within [0, Count] and
+// non-decreasing
+static bool validOffsets(const uint32_t *Offsets, uint32_t Rows,
+    uint32_t Count) {
+  if (Offsets[0] != 0 || Offsets[Rows] != Count)
+    return false;
+  for (uint32_t i = 0; i < Rows; ++i) {
+    if (Offsets[i] > Offsets[i + 1])
+      return false;
+  }
+  return true;
+}
+
+// Smallest record: the magic, size, function ID, name length, NumBlocks,
+// NumInsts, BlockStarts[0], NumLocal, NumNonLocalInsts, NumNonLocalResults,
+// NumCDEdges, CDOffsets[0] and NumCDBranches of a function without blocks
+static const uint32_t MinRecordSize = 13 * sizeof(uint32_t);
+
+DepRecordView::DepRecordView() {
+  size_ = 0;
+  functionId_ = 0;
+  name_ = NULL;
+  nameLength_ = 0;
+  numBlocks_ = 0;
+  numInsts_ = 0;
+  blockStarts_ = NULL;
+  numLocal_ = 0;
+  localDeps_ = NULL;
+  numNonLocalInsts_ = 0;
+  spans_ = NULL;
+  numNonLocalResults_ = 0;
+  results_ = NULL;
+  numCDEdges_ = 0;
+  cdOffsets_ = NULL;
+  cdTargets_ = NULL;
+  numCDBranches_ = 0;
+  cdBranches_ = NULL;
+}
+
+bool DepRecordView::init(const char *Data, size_t Size) {
+  if (reinterpret_cast<uintptr_t>(Data) % 4 != 0)
+    return false;
+
+  Cursor c(Data, Size);
+  uint32_t magic;
+  if (!c.u32(magic) || magic != FunctionMagic)
+    return false;
+  if (!c.u32(size_) || size_ > Size || size_ % 4 != 0
+      || size_ < MinRecordSize)
+    return false;
+
+  // Only look at the bytes of this record from now on
+  c = Cursor(Data + 8, size_ - 8);
+
+  // A name longer than the record would also wrap the padded length
+  if (!c.u32(functionId_) || !c.u32(nameLength_) || nameLength_ > size_)
+    return false;
+  name_ = c.take<char>((nameLength_ + 3) & ~3u);
+  if (name_ == NULL)
+    return false;
+
+  if (!c.u32(numBlocks_) || !c.u32(numInsts_) || numBlocks_ == ~0u)
+    return false;
+  blockStarts_ = c.take<uint32_t>(numBlocks_ + 1);
+  if (blockStarts_ == NULL || !validOffsets(blockStarts_, numBlocks_, numInsts_))
+    return false;
+
+  if (!c.u32(numLocal_))
+    return false;
+  localDeps_ = c.take<LocalDep>(numLocal_);
+  if (localDeps_ == NULL)
+    return false;
+
+  if (!c.u32(numNonLocalInsts_) || !c.u32(numNonLocalResults_))
+    return false;
+  spans_ = c.take<NonLocalSpan>(numNonLocalInsts_);
+  results_ = c.take<NonLocalDep>(numNonLocalResults_);
+  if (spans_ == NULL || results_ == NULL)
+    return false;
+
+  if (!c.u32(numCDEdges_))
+    return false;
+  cdOffsets_ = c.take<uint32_t>(numBlocks_ + 1);
+  cdTargets_ = c.take<uint32_t>(numCDEdges_);
+  if (cdOffsets_ == NULL || cdTargets_ == NULL ||
+      !validOffsets(cdOffsets_, numBlocks_, numCDEdges_))
+    return false;
+
+  if (!c.u32(numCDBranches_))
+    return false;
+  cdBranches_ = c.take<CDBranch>(numCDBranches_);
+  if (cdBranches_ == NULL)
+    return false;
+
+  // IDs must refer to blocks and instructions of this function
+  for (uint32_t i = 0; i < numLocal_; ++i) {
+    if (localDeps_[i].Inst >= numInsts_ || !validInst(localDeps_[i].DepInst))
+      return false;
+    if (i > 0 && localDeps_[i].Inst <= localDeps_[i - 1].Inst)
+      return false;
+  }
+  for (uint32_t i = 0; i < numNonLocalInsts_; ++i) {
+    if (spans_[i].Inst >= numInsts_ || spans_[i].First > numNonLocalResults_ ||
+        spans_[i].Count > numNonLocalResults_ - spans_[i].First)
+      return false;
+    if (i > 0 && spans_[i].Inst <= spans_[i - 1].Inst)
+      return false;
+  }
+  for (uint32_t i = 0; i < numNonLocalResults_; ++i) {
+    const NonLocalDep &r = results_[i];
+    if (r.Block >= numBlocks_ || !validInst(r.DepInst))
+      return false;
+    if (r.Address < ArgumentFlag && r.Address >= numInsts_)
+      return false;
+  }
+  for (uint32_t i = 0; i < numCDEdges_; ++i) {
+    if (cdTargets_[i] >= numBlocks_)
+      return false;
+  }
+  for (uint32_t i = 0; i < numCDBranches_; ++i) {
+    const CDBranch &b = cdBranches_[i];
+    if (b.Controller >= numBlocks_ || b.Dependent >= numBlocks_ ||
+        b.Successor >= numBlocks_)
+      return false;
+    if (i > 0 && b.Dependent < cdBranches_[i - 1].Dependent)
+      return false;
+  }
+  return true;
+}
+
+bool DepRecordView::validInst(uint32_t Id) const {
+  return Id == NoId || Id < numInsts_;
+}
+
+uint32_t DepRecordView::size() const { return size_; }
+uint32_t DepRecordView::functionId() const { return functionId_; }
+const char *DepRecordView::name() const { return name_; }
+uint32_t DepRecordView::nameLength() const { return nameLength_; }
+uint32_t DepRecordView::numBlocks() const { return numBlocks_; }
+uint32_t DepRecordView::numInsts() const { return numInsts_; }
+const uint32_t *DepRecordView::blockStarts() const { return blockStarts_; }
+uint32_t DepRecordView::numLocal() const { return numLocal_; }
+const LocalDep *DepRecordView::localDeps() const { return localDeps_; }
+uint32_t DepRecordView::numNonLocalInsts() const { return numNonLocalInsts_; }
+const NonLocalSpan *DepRecordView::nonLocalSpans() const { return spans_; }
+uint32_t DepRecordView::numNonLocalResults() const { return numNonLocalResults_; }
+const NonLocalDep *DepRecordView::nonLocalResults() const { return results_; }
+uint32_t DepRecordView::numCDEdges() const { return numCDEdges_; }
+const uint32_t *DepRecordView::cdOffsets() const { return cdOffsets_; }
+const uint32_t *DepRecordView::cdTargets() const { return cdTargets_; }
+uint32_t DepRecordView::numCDBranches() const { return numCDBranches_; }
+const CDBranch *DepRecordView::cdBranches() const { return cdBranches_; }
+
+uint32_t DepRecordView::blockOf(uint32_t Inst) const {
+  // The last block whose first instruction is <= Inst. Empty blocks do not
+  // exist in valid IR, but skip over them anyway.
+  const uint32_t *e = blockStarts_ + numBlocks_ + 1;
+  return std::upper_bound(blockStarts_, e, Inst) - blockStarts_ - 1;
+}
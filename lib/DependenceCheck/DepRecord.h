@@ -0,0 +1,93 @@
+// Author: Markus Kusano
+//
+// Zero-copy view of a binary function record (see DepFormat.h).
+//
+// The view points into the memory holding the record (e.g., a memory mapped
+// file) and does not copy anything. init() checks that all the arrays of the
+// record are within bounds and consistent before any of them are used:
+//
+//  DepRecordView R;
+//  if (!R.init(Data, Size))
+//    ... not a valid record ...
+//  for (uint32_t i = 0; i < R.numLocal(); ++i)
+//    use(R.localDeps()[i]);
+//
+// The record must be 4 byte aligned and the host must be little-endian.
+// Like DepFormat.h this has no LLVM dependencies.
+
+#ifndef DEP_RECORD_H
+#define DEP_RECORD_H
+
+#include "DepFormat.h"
+
+#include <stddef.h>
+
+class DepRecordView {
+  public:
+    DepRecordView();
+
+    // Parses the record starting at Data with at most Size bytes available.
+    // Returns false if the record is truncated or malformed.
+    bool init(const char *Data, size_t Size);
+
+    // Size of the record in bytes
+    uint32_t size() const;
+
+    uint32_t functionId() const;
+
+    // Function name; not zero terminated
+    const char *name() const;
+    uint32_t nameLength() const;
+
+    uint32_t numBlocks() const;
+    uint32_t numInsts() const;
+
+    // First instruction ID of each block, numBlocks() + 1 entries
+    const uint32_t *blockStarts() const;
+
+    // Returns the block containing the instruction with the ID Inst
+    uint32_t blockOf(uint32_t Inst) const;
+
+    uint32_t numLocal() const;
+    const depformat::LocalDep *localDeps() const;
+
+    uint32_t numNonLocalInsts() const;
+    const depformat::NonLocalSpan *nonLocalSpans() const;
+
+    uint32_t numNonLocalResults() const;
+    const depformat::NonLocalDep *nonLocalResults() const;
+
+    uint32_t numCDEdges() const;
+
+    // CSR rows of the CDG, numBlocks() + 1 entries
+    const uint32_t *cdOffsets() const;
+    const uint32_t *cdTargets() const;
+
+    uint32_t numCDBranches() const;
+    const depformat::CDBranch *cdBranches() const;
+
+  private:
+    // Returns true if Id is NoId or an instruction of the record
+    bool validInst(uint32_t Id) const;
+
+    uint32_t size_;
+    uint32_t functionId_;
+    const char *name_;
+    uint32_t nameLength_;
+    uint32_t numBlocks_;
+    uint32_t numInsts_;
+    const uint32_t *blockStarts_;
+    uint32_t numLocal_;
+    const depformat::LocalDep *localDeps_;
+    uint32_t numNonLocalInsts_;
+    const depformat::NonLocalSpan *spans_;
+    uint32_t numNonLocalResults_;
+    const depformat::NonLocalDep *results_;
+    uint32_t numCDEdges_;
+    const uint32_t *cdOffsets_;
+    const uint32_t *cdTargets_;
+    uint32_t numCDBranches_;
+    const depformat::CDBranch *cdBranches_;
+};
+
+#endif // DEP_RECORD_H
@@ -0,0 +1,355 @@
+// Author: Markus Kusano
+//
+// See DepResults.h for more information
+
+#include "DepResults.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace depformat;
+
+namespace {
+  uint32_t readU32(const char *P) {
+    uint32_t v;
+    memcpy(&v, P, sizeof(v));
+    return v;
+  }
+
+  uint64_t readU64(const char *P) {
+    uint64_t v;
+    memcpy(&v, P, sizeof(v));
+    return v;
+  }
+
+  bool fail(std::string *Error, const std::string &Msg) {
+    if (Error != NULL)
+      *Error = Msg;
+    return false;
+  }
+
+  bool lessInst(const LocalDep &L, uint32_t Inst) {
+    return L.Inst < Inst;
+  }
+
+  bool lessSpan(const NonLocalSpan &S, uint32_t Inst) {
+    return S.Inst < Inst;
+  }
+
+  bool lessDependent(const CDBranch &B, uint32_t Block) {
+    return B.Dependent < Block;
+  }
+
+  bool lessBlock(uint32_t Block, const CDBranch &B) {
+    return Block < B.Dependent;
+  }
+
+  // Returns the terminator of Block, or NoId if Block is empty
+  uint32_t terminatorOf(const DepRecordView &R, uint32_t Block) {
+    const uint32_t *starts = R.blockStarts();
+    if (starts[Block] == starts[Block + 1])
+      return NoId;
+    return starts[Block + 1] - 1;
+  }
+
+  void mark(uint32_t Inst, std::vector<bool> &Slice,
+      std::vector<uint32_t> &Worklist) {
+    if (Inst >= Slice.size() || Slice[Inst])
+      return;
+    Slice[Inst] = true;
+    Worklist.push_back(Inst);
+  }
+} // end anonymous namespace
+
+DepResults::DepResults() : data_(NULL), size_(0), diff_(false),
+  index_(NULL), numEntries_(0) { }
+
+DepResults::~DepResults() {
+  close();
+}
+
+bool DepResults::open(const char *Path, std::string *Error) {
+  close();
+
+  int fd = ::open(Path, O_RDONLY);
+  if (fd < 0)
+    return fail(Error, std::string("cannot open file: ") + strerror(errno));
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    std::string msg = std::string("cannot stat file: ") + strerror(errno);
+    ::close(fd);
+    return fail(Error, msg);
+  }
+  size_t size = st.st_size;
+  // Header, an empty index and the trailer
+  if (size < 8 + 8 + 16) {
+    ::close(fd);
+    return fail(Error, "file too small");
+  }
+
+  void *p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED)
+    return fail(Error, std::string("cannot map file: ") + strerror(errno));
+  data_ = static_cast<const char *>(p);
+  size_ = size;
+
+  uint32_t magic = readU32(data_);
+  if ((magic != FileMagic && magic != DiffMagic)
+      || readU32(data_ + 4) != Version) {
+    close();
+    return fail(Error, "not an export file of this version");
+  }
+  diff_ = magic == DiffMagic;
+
+  const char *trailer = data_ + size_ - 16;
+  if (readU32(trailer + 8) != TrailerMagic
+      || readU32(trailer + 12) != Version) {
+    close();
+    return fail(Error, "bad trailer");
+  }
+
+  uint64_t indexOffset = readU64(trailer);
+  if (indexOffset < 8 || indexOffset % 4 != 0
+      || indexOffset > size_ - 16 - 8) {
+    close();
+    return fail(Error, "bad index offset");
+  }
+  const char *index = data_ + indexOffset;
+  uint32_t count = readU32(index + 4);
+  if (readU32(index) != IndexMagic
+      || count > (size_ - 16 - 8 - indexOffset) / sizeof(IndexEntry)) {
+    close();
+    return fail(Error, "bad index");
+  }
+  index_ = index + 8;
+  numEntries_ = count;
+
+  // Every record must start after the header and before the index, at a
+  // 4 byte boundary; the records themselves are checked when used
+  for (uint32_t i = 0; i < numEntries_; ++i) {
+    uint32_t id;
+    uint64_t offset;
+    readEntry(i, id, offset);
+    if (offset < 8 || offset >= indexOffset || offset % 4 != 0) {
+      close();
+      return fail(Error, "bad index entry");
+    }
+  }
+
+  views_.resize(numEntries_);
+  state_.assign(numEntries_, 0);
+  return true;
+}
+
+void DepResults::close() {
+  if (data_ != NULL)
+    munmap(const_cast<char *>(data_), size_);
+  data_ = NULL;
+  size_ = 0;
+  diff_ = false;
+  index_ = NULL;
+  numEntries_ = 0;
+  views_.clear();
+  state_.clear();
+}
+
+bool DepResults::isDiff() const {
+  return diff_;
+}
+
+uint32_t DepResults::numFunctions() const {
+  return numEntries_;
+}
+
+void DepResults::readEntry(uint32_t Index, uint32_t &FunctionId,
+    uint64_t &Offset) const {
+  const char *e = index_ + Index * sizeof(IndexEntry);
+  FunctionId = readU32(e);
+  Offset = readU64(e + 8);
+}
+
+const DepRecordView *DepResults::getRecord(uint32_t Index) const {
+  if (Index >= numEntries_)
+    return NULL;
+
+  if (state_[Index] == 0) {
+    uint32_t id;
+    uint64_t offset;
+    readEntry(Index, id, offset);
+    bool valid = views_[Index].init(data_ + offset, size_ - offset)
+      && views_[Index].functionId() == id;
+    state_[Index] = valid ? 1 : 2;
+  }
+  return state_[Index] == 1 ? &views_[Index] : NULL;
+}
+
+const DepRecordView *DepResults::getFunction(uint32_t FunctionId) const {
+  // Binary search of the index, which is sorted by function ID
+  uint32_t lo = 0, hi = numEntries_;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    uint32_t id;
+    uint64_t offset;
+    readEntry(mid, id, offset);
+    if (id < FunctionId)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo == numEntries_)
+    return NULL;
+  uint32_t id;
+  uint64_t offset;
+  readEntry(lo, id, offset);
+  return id == FunctionId ? getRecord(lo) : NULL;
+}
+
+const DepRecordView *DepResults::findFunction(const std::string &Name) const {
+  for (uint32_t i = 0; i < numEntries_; ++i) {
+    const DepRecordView *r = getRecord(i);
+    if (r != NULL && r->nameLength() == Name.size()
+        && memcmp(r->name(), Name.data(), Name.size()) == 0)
+      return r;
+  }
+  return NULL;
+}
+
+const LocalDep *DepResults::getLocalDep(const DepRecordView &R,
+    uint32_t Inst) {
+  const LocalDep *b = R.localDeps();
+  const LocalDep *e = b + R.numLocal();
+  const LocalDep *l = std::lower_bound(b, e, Inst, lessInst);
+  if (l == e || l->Inst != Inst)
+    return NULL;
+  return l;
+}
+
+const NonLocalDep *DepResults::getNonLocalDeps(const DepRecordView &R,
+    uint32_t Inst, uint32_t &Count) {
+  const NonLocalSpan *b = R.nonLocalSpans();
+  const NonLocalSpan *e = b + R.numNonLocalInsts();
+  const NonLocalSpan *s = std::lower_bound(b, e, Inst, lessSpan);
+  if (s == e || s->Inst != Inst || s->Count == 0) {
+    Count = 0;
+    return NULL;
+  }
+  Count = s->Count;
+  return R.nonLocalResults() + s->First;
+}
+
+const uint32_t *DepResults::getDependents(const DepRecordView &R,
+    uint32_t Block, uint32_t &Count) {
+  if (Block >= R.numBlocks()) {
+    Count = 0;
+    return NULL;
+  }
+  const uint32_t *offsets = R.cdOffsets();
+  Count = offsets[Block + 1] - offsets[Block];
+  return R.cdTargets() + offsets[Block];
+}
+
+const CDBranch *DepResults::getControllers(const DepRecordView &R,
+    uint32_t Block, uint32_t &Count) {
+  const CDBranch *b = R.cdBranches();
+  const CDBranch *e = b + R.numCDBranches();
+  const CDBranch *first = std::lower_bound(b, e, Block, lessDependent);
+  const CDBranch *last = std::upper_bound(first, e, Block, lessBlock);
+  Count = last - first;
+  return Count ? first : NULL;
+}
+
+void DepResults::slice(const DepRecordView &R, const uint32_t *Criteria,
+    size_t NumCriteria, Direction Dir, std::vector<bool> &Slice) {
+  Slice.assign(R.numInsts(), false);
+  std::vector<uint32_t> worklist;
+  for (size_t i = 0; i < NumCriteria; ++i)
+    mark(Criteria[i], Slice, worklist);
+
+  if (Dir == Backward) {
+    while (!worklist.empty()) {
+      uint32_t inst = worklist.back();
+      worklist.pop_back();
+
+      const LocalDep *l = getLocalDep(R, inst);
+      if (l != NULL && l->DepInst != NoId)
+        mark(l->DepInst, Slice, worklist);
+
+      uint32_t n;
+      const NonLocalDep *nl = getNonLocalDeps(R, inst, n);
+      for (uint32_t i = 0; i < n; ++i)
+        if (nl[i].DepInst != NoId)
+          mark(nl[i].DepInst, Slice, worklist);
+
+      const CDBranch *c = getControllers(R, R.blockOf(inst), n);
+      for (uint32_t i = 0; i < n; ++i) {
+        uint32_t term = terminatorOf(R, c[i].Controller);
+        if (term != NoId)
+          mark(term, Slice, worklist);
+      }
+    }
+    return;
+  }
+
+  // Invert the data dependencies into CSR rows: users[offsets[i]] to
+  // users[offsets[i + 1] - 1] depend on the instruction i
+  uint32_t numInsts = R.numInsts();
+  std::vector<uint32_t> offsets(numInsts + 1, 0);
+  for (uint32_t i = 0; i < R.numLocal(); ++i) {
+    const LocalDep &l = R.localDeps()[i];
+    if (l.DepInst != NoId)
+      ++offsets[l.DepInst + 1];
+  }
+  for (uint32_t i = 0; i < R.numNonLocalInsts(); ++i) {
+    const NonLocalSpan &s = R.nonLocalSpans()[i];
+    for (uint32_t j = 0; j < s.Count; ++j) {
+      uint32_t dep = R.nonLocalResults()[s.First + j].DepInst;
+      if (dep != NoId)
+        ++offsets[dep + 1];
+    }
+  }
+  for (uint32_t i = 0; i < numInsts; ++i)
+    offsets[i + 1] += offsets[i];
+
+  std::vector<uint32_t> users(offsets[numInsts]);
+  std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (uint32_t i = 0; i < R.numLocal(); ++i) {
+    const LocalDep &l = R.localDeps()[i];
+    if (l.DepInst != NoId)
+      users[fill[l.DepInst]++] = l.Inst;
+  }
+  for (uint32_t i = 0; i < R.numNonLocalInsts(); ++i) {
+    const NonLocalSpan &s = R.nonLocalSpans()[i];
+    for (uint32_t j = 0; j < s.Count; ++j) {
+      uint32_t dep = R.nonLocalResults()[s.First + j].DepInst;
+      if (dep != NoId)
+        users[fill[dep]++] = s.Inst;
+    }
+  }
+
+  const uint32_t *starts = R.blockStarts();
+  while (!worklist.empty()) {
+    uint32_t inst = worklist.back();
+    worklist.pop_back();
+
+    for (uint32_t i = offsets[inst]; i < offsets[inst + 1]; ++i)
+      mark(users[i], Slice, worklist);
+
+    // Only the terminator of a block controls other blocks
+    uint32_t block = R.blockOf(inst);
+    if (terminatorOf(R, block) != inst)
+      continue;
+    uint32_t n;
+    const uint32_t *deps = getDependents(R, block, n);
+    for (uint32_t i = 0; i < n; ++i)
+      for (uint32_t j = starts[deps[i]]; j < starts[deps[i] + 1]; ++j)
+        mark(j, Slice, worklist);
+  }
+}
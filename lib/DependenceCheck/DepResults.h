@@ -0,0 +1,126 @@
+// Author: Markus Kusano
+//
+// Read-only access to a binary export file (see DepFormat.h) for tools that
+// only consume results and do not need LLVM, the module or the pass.
+//
+// The file is mapped with mmap() and never copied: open() only checks the
+// header, trailer and index, and each function record is checked (see
+// DepRecordView::init()) the first time it is used. All lookups work on
+// the arrays of the mapped records, so opening a large file costs little
+// and its pages are shared by every process that maps it.
+//
+// The queries are those of the pass, over the IDs of DepFormat.h:
+//
+//  DepResults R;
+//  if (!R.open("deps.bin", &Error))
+//    ...
+//  const DepRecordView *F = R.findFunction("main");
+//  const depformat::LocalDep *L = DepResults::getLocalDep(*F, Inst);
+//  uint32_t n;
+//  const depformat::NonLocalDep *NL = DepResults::getNonLocalDeps(*F, Inst, n);
+//
+// Slices follow the memory and control dependencies of the records (see
+// slice()). The format has no def-use edges, so unlike Slicer.h they do not
+// include the instructions defining the operands of the slice.
+//
+// Like DepFormat.h this has no LLVM dependencies; a tool builds DepRecord.cpp
+// and DepResults.cpp with it. The host must be little-endian and POSIX.
+
+#ifndef DEP_RESULTS_H
+#define DEP_RESULTS_H
+
+#include "DepFormat.h"
+#include "DepRecord.h"
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+class DepResults {
+  public:
+    enum Direction {
+      Backward = 0,
+      Forward = 1
+    };
+
+    DepResults();
+    ~DepResults();
+
+    // Maps the export (or diff) file at Path, replacing any file mapped
+    // before. Returns false and sets Error (if not NULL) if the file cannot
+    // be mapped or is not a valid file.
+    bool open(const char *Path, std::string *Error = NULL);
+
+    // Unmaps the file. Views returned earlier become invalid.
+    void close();
+
+    // Returns true if the mapped file is a diff file (see DepDiff.h)
+    bool isDiff() const;
+
+    // Number of function records in the file
+    uint32_t numFunctions() const;
+
+    // Returns the record with the position Index (0 to numFunctions() - 1)
+    // in the index, which is sorted by function ID, or NULL if it is
+    // malformed
+    const DepRecordView *getRecord(uint32_t Index) const;
+
+    // Returns the record of the function with the ID FunctionId (first
+    // match in a diff file), or NULL if there is none
+    const DepRecordView *getFunction(uint32_t FunctionId) const;
+
+    // Returns the first record of the function named Name, or NULL. This
+    // scans the records.
+    const DepRecordView *findFunction(const std::string &Name) const;
+
+    // Returns the local dependence of the instruction Inst, or NULL if it
+    // has none
+    static const depformat::LocalDep *getLocalDep(const DepRecordView &R,
+        uint32_t Inst);
+
+    // Returns the non-local results of Inst and sets Count to their number
+    // (NULL and 0 if there are none)
+    static const depformat::NonLocalDep *getNonLocalDeps(
+        const DepRecordView &R, uint32_t Inst, uint32_t &Count);
+
+    // Returns the blocks control dependent on Block, sorted, and sets Count
+    // to their number
+    static const uint32_t *getDependents(const DepRecordView &R,
+        uint32_t Block, uint32_t &Count);
+
+    // Returns the branches that control Block (their Dependent is Block)
+    // and sets Count to their number. The controllers are the Controller
+    // fields; one appears once for every successor through which Block is
+    // reached.
+    static const depformat::CDBranch *getControllers(const DepRecordView &R,
+        uint32_t Block, uint32_t &Count);
+
+    // Sets Slice (one entry per instruction ID) to the slice of the
+    // Criteria. An instruction depends on the instructions of its local and
+    // non-local results and on the terminators of the blocks its block is
+    // control dependent on. Backward slices walk the arrays of R directly;
+    // forward slices first invert the data dependencies of R.
+    static void slice(const DepRecordView &R, const uint32_t *Criteria,
+        size_t NumCriteria, Direction Dir, std::vector<bool> &Slice);
+
+  private:
+    const char *data_;
+    size_t size_;
+    bool diff_;
+
+    // The entries of the index of the mapped file (points into data_).
+    // They are only 4 byte aligned, so they are read with readEntry().
+    const char *index_;
+    uint32_t numEntries_;
+    void readEntry(uint32_t Index, uint32_t &FunctionId,
+        uint64_t &Offset) const;
+
+    // The views of the records, initialized on first use
+    mutable std::vector<DepRecordView> views_;
+    mutable std::vector<char> state_; // 0 unchecked, 1 valid, 2 malformed
+
+    DepResults(const DepResults &);            // not copyable
+    DepResults &operator=(const DepResults &);
+};
+
+#endif // DEP_RESULTS_H
@@ -0,0 +1,157 @@
+// Author: Markus Kusano
+//
+// See DepServer.h for more information
+
+#include "DepServer.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Writes all of Data to the socket FD. Returns false on errors, e.g., EPIPE
+// if the client disconnected before reading its response. This must not
+// raise SIGPIPE, which would kill the server: MSG_NOSIGNAL suppresses it
+// where it exists and SO_NOSIGPIPE (see DepServer::run()) elsewhere.
+static bool writeAll(int FD, const char *Data, size_t Size) {
+#ifdef MSG_NOSIGNAL
+  const int flags = MSG_NOSIGNAL;
+#else
+  const int flags = 0;
+#endif
+  while (Size > 0) {
+    ssize_t n = ::send(FD, Data, Size, flags);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    Data += n;
+    Size -= n;
+  }
+  return true;
+}
+
+DepServer::DepServer(const std::string &Path) : path_(Path), fd_(-1) { }
+
+DepServer::~DepServer() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    ::unlink(path_.c_str());
+  }
+}
+
+bool DepServer::listen() {
+  struct sockaddr_un addr;
+  if (path_.size() >= sizeof(addr.sun_path)) {
+    errs() << "[Warning] Socket path is too long: " << path_ << '\n';
+    return false;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path_.c_str(), sizeof(addr.sun_path) - 1);
+
+  fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd_ < 0) {
+    errs() << "[Warning] Error creating socket: " << strerror(errno) << '\n';
+    return false;
+  }
+
+  ::unlink(path_.c_str());
+  if (::bind(fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0
+      || ::listen(fd_, 4) < 0) {
+    errs() << "[Warning] Error listening on " << path_ << ": "
+           << strerror(errno) << '\n';
+    ::close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  return true;
+}
+
+void DepServer::run(Handler H) {
+  assert(fd_ >= 0 && "listen() failed or was not called");
+  for (;;) {
+    int client = ::accept(fd_, NULL, NULL);
+    if (client < 0) {
+      if (errno == EINTR)
+        continue;
+      errs() << "[Warning] Error accepting a client: " << strerror(errno)
+             << '\n';
+      return;
+    }
+
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+    int on = 1;
+    ::setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+    bool more = serveClient(client, H);
+    ::close(client);
+    if (!more)
+      return;
+  }
+}
+
+bool DepServer::serveClient(int Client, Handler &H) {
+  std::string buffer;
+  std::string response;
+  bool skipping = false;
+  char chunk[4096];
+  for (;;) {
+    ssize_t n = ::read(Client, chunk, sizeof(chunk));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return true;
+    buffer.append(chunk, n);
+
+    // Drop the rest of a line that was too long
+    if (skipping) {
+      size_t end = buffer.find('\n');
+      if (end == std::string::npos) {
+        buffer.clear();
+        continue;
+      }
+      buffer.erase(0, end + 1);
+      skipping = false;
+    }
+
+    // Answer every complete line in the buffer
+    size_t start = 0;
+    for (size_t end; (end = buffer.find('\n', start)) != std::string::npos;
+        start = end + 1) {
+      StringRef request = StringRef(buffer).slice(start, end).trim();
+      if (request.empty())
+        continue;
+
+      response.clear();
+      bool more;
+      {
+        raw_string_ostream out(response);
+        more = H(request, out);
+        out << '\n';
+      }
+      // The client is gone (EPIPE); wait for the next one
+      if (!writeAll(Client, response.data(), response.size()))
+        return true;
+      if (!more)
+        return false;
+      if (request == "quit")
+        return true;
+    }
+    buffer.erase(0, start);
+
+    // A line that is too long is answered once MaxRequestLength bytes of
+    // it arrived; the rest of it is dropped
+    if (buffer.size() > MaxRequestLength) {
+      static const char TooLong[] = "error request too long\n";
+      if (!writeAll(Client, TooLong, sizeof(TooLong) - 1))
+        return true;
+      buffer.clear();
+      skipping = true;
+    }
+  }
+}
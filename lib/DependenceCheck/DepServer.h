@@ -0,0 +1,85 @@
+// Author: Markus Kusano
+//
+// A Unix domain socket server answering dependence queries while the pass
+// (and the analyses of the pass manager) stay alive. Used by -depcheck-serve
+// so clients (e.g., an IDE) do not pay for loading the module and building
+// the analyses on every query.
+//
+// The protocol is line based. Every request is one line of space separated
+// words and gets exactly one response line, which starts with "ok" or
+// "error <message>". Functions are named by their name; blocks and
+// instructions by the dense IDs of DepFormat.h (position in the function,
+// instructions in inst_iterator order). Missing instructions are "-".
+//
+//  info <function>
+//    ok <blocks> <instructions>
+//  deps <function> <instruction>
+//    ok <local type> <local instruction> [<block>,<instruction>,<type> ...]
+//    (the local type is "none" if there is no local dependence; the list
+//    holds the non-local results)
+//  cdeps <function> <block>
+//    ok [<block> ...]          the blocks control dependent on <block>
+//  controllers <function> <block>
+//    ok [<block>,<successor> ...]   the branches <block> depends on
+//  slice <function> backward|forward <instruction> [<instruction> ...]
+//    ok [<instruction> ...]
+//  quit
+//    ok, then the connection is closed
+//  shutdown
+//    ok, then the server stops
+//
+// A request longer than MaxRequestLength bytes gets "error request too
+// long" and the rest of its line is skipped.
+//
+// Clients are served one at a time. Nothing is calculated until a function
+// is queried; the results of a function are kept for later queries.
+//
+//  DepServer S(Path);
+//  if (S.listen())
+//    S.run([&](StringRef Request, raw_ostream &Response) { ... });
+
+#ifndef DEP_SERVER_H
+#define DEP_SERVER_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <functional>
+#include <stddef.h>
+#include <string>
+
+using namespace llvm;
+
+class DepServer {
+  public:
+    // Request handler: writes the response to a request (without the
+    // newline) to Response. Returns false to stop the server after the
+    // response is sent.
+    typedef std::function<bool(StringRef, raw_ostream &)> Handler;
+
+    // Longest request line (without the newline) that is answered
+    static const size_t MaxRequestLength = 1 << 20;
+
+    // Path of the socket. An existing file at Path is replaced.
+    explicit DepServer(const std::string &Path);
+
+    // Closes the socket and removes its file
+    ~DepServer();
+
+    // Creates the socket and starts listening. Returns false (after
+    // printing a warning) if this fails.
+    bool listen();
+
+    // Accepts clients and answers their requests until a handler returns
+    // false
+    void run(Handler H);
+
+  private:
+    std::string path_;
+    int fd_;
+
+    // Serves one client. Returns false if the server should stop.
+    bool serveClient(int Client, Handler &H);
+};
+
+#endif // DEP_SERVER_H
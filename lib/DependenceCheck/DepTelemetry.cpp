@@ -0,0 +1,56 @@
+// Author: Markus Kusano
+//
+// See DepTelemetry.h for more information
+
+#include "DepTelemetry.h"
+#include "DepExport.h"
+
+#include "llvm/Support/Format.h"
+
+#include <algorithm>
+
+void writeTelemetry(raw_ostream &Out, unsigned FunctionId, const Function &F,
+    const DataDependence::FunctionDeps *Data, const CompactCDG *Control) {
+  unsigned numInsts = 0;
+  for (auto bi = F.begin(), be = F.end(); bi != be; ++bi)
+    numInsts += bi->size();
+
+  Out << "{\"function\":" << FunctionId << ",\"name\":";
+  writeJSONString(Out, F.getName());
+  Out << ",\"blocks\":" << F.size() << ",\"insts\":" << numInsts;
+
+  if (Data != NULL) {
+    unsigned maxResults = 0;
+    for (unsigned i = 0; i < Data->size(); ++i)
+      maxResults = std::max(maxResults,
+          (unsigned)Data->getNonLocalDeps(i).size());
+    double mean = Data->NumNonLocal_
+      ? double(Data->NonLocal_.size()) / Data->NumNonLocal_ : 0.0;
+
+    Out << ",\"mem_insts\":" << Data->NumMemInsts_
+        << ",\"local\":" << Data->NumLocal_
+        << ",\"nonlocal\":" << Data->NumNonLocal_
+        << ",\"nonlocal_results\":" << Data->NonLocal_.size()
+        << ",\"results_max\":" << maxResults
+        << ",\"results_mean\":" << format("%.2f", mean)
+        << ",\"data_us\":" << Data->Micros_
+        << ",\"data_bytes\":" << Data->memoryBytes();
+  }
+  else {
+    Out << ",\"mem_insts\":null,\"local\":null,\"nonlocal\":null"
+        << ",\"nonlocal_results\":null,\"results_max\":null"
+        << ",\"results_mean\":null,\"data_us\":null,\"data_bytes\":null";
+  }
+
+  if (Control != NULL) {
+    Out << ",\"s_edges\":" << Control->numSEdges()
+        << ",\"walk_steps\":" << Control->numWalkSteps()
+        << ",\"control_us\":" << Control->buildMicros()
+        << ",\"control_bytes\":" << Control->memoryBytes();
+  }
+  else {
+    Out << ",\"s_edges\":null,\"walk_steps\":null,\"control_us\":null"
+        << ",\"control_bytes\":null";
+  }
+  Out << "}\n";
+}
@@ -0,0 +1,43 @@
+// Author: Markus Kusano
+//
+// Per-function resource report, to find the functions that make a run slow
+// or large before they become a problem and to pick budgets (see
+// DataDependence::Budget).
+//
+// The report is JSON lines: one object per analyzed function with
+//
+//  function, name     function ID (position in the module) and name
+//  blocks, insts      size of the function
+//  mem_insts          memory instructions queried
+//  s_edges            CFG edges in the set S (Ferrante engine only)
+//  walk_steps         post-dominator tree steps (Ferrante) or frontier
+//                     entries (Frontier)
+//  local, nonlocal    instructions with local and non-local dependencies
+//  nonlocal_results   total non-local results
+//  results_max,       non-local results per instruction with non-local
+//  results_mean       results
+//  data_us,           time spent calculating the data and control
+//  control_us         dependencies, in microseconds
+//  data_bytes,        memory held by the data and control results
+//  control_bytes
+//
+// The costs (mem_insts, s_edges, walk_steps and the times) are 0 for
+// results restored from the cache. Fields of results that were not
+// calculated (e.g., control dependencies with -depcheck-lazy) are null.
+
+#ifndef DEP_TELEMETRY_H
+#define DEP_TELEMETRY_H
+
+#include "ControlDependence.h"
+#include "DataDependence.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+// Writes the report line of F, whose ID is FunctionId. Data or Control may
+// be NULL if the corresponding results were not calculated.
+void writeTelemetry(raw_ostream &Out, unsigned FunctionId, const Function &F,
+    const DataDependence::FunctionDeps *Data, const CompactCDG *Control);
+
+#endif // DEP_TELEMETRY_H
@@ -0,0 +1,40 @@
+// Author: Markus Kusano
+//
+// See DepTimers.h for more information
+
+#include "DepTimers.h"
+#include "llvm/Pass.h"
+
+#include <thread>
+
+// The thread that records time (see initPhaseTimers())
+static std::thread::id TimingThread;
+
+static const char *PhaseNames[NumDepPhases] = {
+  "getNonPDomEdges",
+  "updateControlDependencies",
+  "updateFromFrontiers",
+  "processDepResult",
+  "toDot",
+  "loopDependence"
+};
+
+void initPhaseTimers() {
+  TimingThread = std::this_thread::get_id();
+}
+
+Timer *getPhaseTimer(DepPhase P) {
+  if (!TimePassesIsEnabled)
+    return NULL;
+  if (std::this_thread::get_id() != TimingThread)
+    return NULL;
+
+  // Created on first use so nothing is registered unless -time-passes is on.
+  // The group prints its report when it is destroyed at exit.
+  static TimerGroup Group("Dependence Check phases");
+  static Timer *Timers[NumDepPhases];
+  assert(P < NumDepPhases && "unknown phase");
+  if (Timers[P] == NULL)
+    Timers[P] = new Timer(PhaseNames[P], Group);
+  return Timers[P];
+}
@@ -0,0 +1,39 @@
+// Author: Markus Kusano
+//
+// Timers for the phases of the dependence calculation. These are reported
+// with the other pass timings when -time-passes is given, for example:
+//
+//  void ControlDependence::toDot(std::string name) const {
+//    TimeRegion T(getPhaseTimer(PhaseToDot));
+//    ...
+//  }
+//
+// LLVM timers are not thread safe so only the thread that called
+// initPhaseTimers() records time. getPhaseTimer() returns NULL on every other
+// thread (and when -time-passes is off), which TimeRegion ignores.
+
+#ifndef DEP_TIMERS_H
+#define DEP_TIMERS_H
+
+#include "llvm/Support/Timer.h"
+
+using namespace llvm;
+
+enum DepPhase {
+  PhaseGetNonPDomEdges = 0,
+  PhaseUpdateControlDependencies,
+  PhaseFrontiers,
+  PhaseProcessDepResult,
+  PhaseToDot,
+  PhaseLoopDependence,
+  NumDepPhases
+};
+
+// Makes the calling thread the one that records time
+void initPhaseTimers();
+
+// Returns the timer of the phase P, or NULL if time should not be recorded
+// (see file comment)
+Timer *getPhaseTimer(DepPhase P);
+
+#endif // DEP_TIMERS_H
@@ -8,136 +8,1186 @@
  * Much of the structure of this code is copied from
  * llvm/lib/Analysis/MemDepPrinter.cpp
  */
+#define DEBUG_TYPE "depcheck"
 #include "llvm/Pass.h"
+#include "llvm/PassSupport.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
 #include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Analysis/PostDominators.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+
 #include "DataDependence.h"
 #include "ControlDependence.h"
+#include "DependenceCheck.h"
+#include "DepCache.h"
+#include "DepDiff.h"
+#include "DepExport.h"
+#include "DepServer.h"
+#include "DepTelemetry.h"
+#include "DepTimers.h"
+#include "FunctionDependence.h"
+#include "FunctionFilter.h"
+#include "LoopDependence.h"
+#include "ModRefSummary.h"
+#include "Slicer.h"
+#include "StableHash.h"
+#include "WorkerPool.h"
 
 using namespace llvm;
 
 // enable debugging output
 //#define MK_DEBUG
 
-// In the future this might need to be non-anonymous depending on how we want
-// to query this information
-namespace {
-  // This pass is a module pass for now. I chose this with the idea that the
-  // pass could be asked the question: "What are the dependencies of this
-  // instruction?"
-  struct DependenceCheck : public ModulePass {
-    // Default constructor
-    DependenceCheck();
+STATISTIC(NumDataAnalyzed,
+    "Number of functions whose data dependencies were calculated");
+STATISTIC(NumCDGsBuilt, "Number of control dependence graphs built");
+STATISTIC(NumCDGsReused,
+    "Number of control dependence graphs reused after invalidation");
+
+static cl::opt<bool> LazyAnalysis("depcheck-lazy",
+    cl::desc("Only calculate dependencies of functions that are queried"),
+    cl::init(false));
+
+static cl::opt<unsigned> NumThreads("depcheck-threads",
+    cl::desc("Number of worker threads calculating control dependencies "
+      "(data dependencies are calculated on the main thread)"),
+    cl::init(1));
+
+static cl::opt<ControlDependence::Engine> CDEngine("depcheck-cd-engine",
+    cl::desc("Algorithm used to calculate control dependencies"),
+    cl::values(
+      clEnumValN(ControlDependence::Ferrante, "ferrante",
+        "Walk the post-dominator tree for every edge (Ferrante et al.)"),
+      clEnumValN(ControlDependence::Frontier, "frontier",
+        "Reverse dominance frontiers (Cytron et al.)"),
+      clEnumValEnd),
+    cl::init(ControlDependence::Ferrante));
+
+static cl::opt<DataDependence::LocalEngine> LocalEngine("depcheck-local-engine",
+    cl::desc("How local data dependencies are found"),
+    cl::values(
+      clEnumValN(DataDependence::MemDep, "memdep",
+        "Ask MemoryDependenceAnalysis for every instruction"),
+      clEnumValN(DataDependence::Forward, "forward",
+        "Scan each block forward once and only ask "
+        "MemoryDependenceAnalysis what the scan cannot answer"),
+      clEnumValEnd),
+    cl::init(DataDependence::MemDep));
+
+static cl::opt<unsigned> MaxQueryBlocks("depcheck-max-query-blocks",
+    cl::desc("Record non-local queries from blocks reachable from more than "
+      "N blocks as Unknown (0 for no limit)"),
+    cl::value_desc("N"), cl::init(0));
+
+static cl::opt<unsigned> MaxQueryResults("depcheck-max-query-results",
+    cl::desc("Record non-local queries with more than N results as Unknown "
+      "(0 for no limit)"),
+    cl::value_desc("N"), cl::init(0));
+
+static cl::opt<unsigned> MaxFunctionSteps("depcheck-max-function-steps",
+    cl::desc("Record the non-local queries of a function as Unknown once it "
+      "has N non-local results (0 for no limit)"),
+    cl::value_desc("N"), cl::init(0));
+
+static cl::opt<unsigned> MaxFunctionMillis("depcheck-max-function-ms",
+    cl::desc("Record the non-local queries of a function as Unknown once it "
+      "has been analyzed for N milliseconds (0 for no limit)"),
+    cl::value_desc("N"), cl::init(0));
+
+static cl::opt<std::string> DotDir("depcheck-dot-dir",
+    cl::desc("Write the CDG of each function to <dir>/cdg.<function>.dot "
+      "instead of one controldeps.dot"),
+    cl::value_desc("dir"), cl::init(""));
+
+static cl::list<std::string> DotFunctions("depcheck-dot-func",
+    cl::desc("Only write the CDGs of these functions with -depcheck-dot-dir"),
+    cl::value_desc("function"), cl::CommaSeparated);
+
+static cl::opt<bool> DotCompact("depcheck-dot-compact",
+    cl::desc("Label CDG nodes with block names instead of the block's IR"),
+    cl::init(false));
+
+static cl::opt<std::string> ExportFile("depcheck-export",
+    cl::desc("Write the dependencies in a machine readable format to <file>"),
+    cl::value_desc("file"), cl::init(""));
+
+static cl::opt<DepExportWriter::Format> ExportFormat("depcheck-export-format",
+    cl::desc("Format of -depcheck-export"),
+    cl::values(
+      clEnumValN(DepExportWriter::Binary, "binary", "Compact binary format"),
+      clEnumValN(DepExportWriter::JSONLines, "jsonl",
+        "One JSON object per function"),
+      clEnumValN(DepExportWriter::Text, "text",
+        "The output of -analyze, one function at a time"),
+      clEnumValN(DepExportWriter::Dot, "dot",
+        "One CDG graph per function"),
+      clEnumValEnd),
+    cl::init(DepExportWriter::Binary));
 
-    // DataDependence Object. Holds and calculates the data dependency information
-    DataDependence DataDep;
+static cl::opt<bool> StreamResults("depcheck-stream",
+    cl::desc("Write the results of each function to -depcheck-export and "
+      "-depcheck-telemetry as soon as it is analyzed and then release them, "
+      "so memory use depends on the largest function instead of the module"),
+    cl::init(false));
 
-    // ControlDependence object. Holds and calculates the control dependency
-    // information
-    ControlDependence ControlDep;
+static cl::opt<bool> VerifyCD("depcheck-cd-verify",
+    cl::desc("Cross-check the control dependencies against the engine that "
+      "was not selected"),
+    cl::init(false));
 
-    static char ID; // pass ID
+static cl::opt<bool> ModRefSummariesOpt("depcheck-modref-summaries",
+    cl::desc("Compute interprocedural mod/ref summaries bottom-up over the "
+      "call graph and use them to skip call clobbers that cannot access "
+      "the queried memory"),
+    cl::init(false));
 
-    virtual bool runOnModule(Module &M);
+static cl::opt<bool> LoopDepsOpt("depcheck-loop-deps",
+    cl::desc("Classify the dependencies inside loops as independent, loop "
+      "independent or loop carried with distance/direction vectors"),
+    cl::init(false));
 
+static cl::list<std::string> EntryFunctions("depcheck-entry",
+    cl::desc("Only analyze the functions reachable in the call graph from "
+      "these functions"),
+    cl::value_desc("function"), cl::CommaSeparated);
 
-    virtual void getAnalysisUsage(AnalysisUsage &AU) const;
-    void print(raw_ostream &OS, const Module *m = 0) const;
+static cl::list<std::string> AllowFunctions("depcheck-allow",
+    cl::desc("Only analyze these functions"),
+    cl::value_desc("function"), cl::CommaSeparated);
 
+static cl::list<std::string> DenyFunctions("depcheck-deny",
+    cl::desc("Do not analyze these functions"),
+    cl::value_desc("function"), cl::CommaSeparated);
+
+static cl::opt<std::string> FunctionOrder("depcheck-function-order",
+    cl::desc("Analyze the functions listed in <file> first: one name per "
+      "line, hottest first, or followed by an execution count"),
+    cl::value_desc("file"), cl::init(""));
+
+static cl::opt<std::string> CacheDir("depcheck-cache",
+    cl::desc("Reuse the results of unchanged functions stored in <dir> and "
+      "store the results of the others (requires function-local alias "
+      "analysis)"),
+    cl::value_desc("dir"), cl::init(""));
+
+static cl::opt<std::string> ServeSocket("depcheck-serve",
+    cl::desc("Answer dependence queries on the Unix socket <path> instead of "
+      "analyzing the whole module (see DepServer.h for the protocol)"),
+    cl::value_desc("path"), cl::init(""));
+
+static cl::opt<std::string> TelemetryFile("depcheck-telemetry",
+    cl::desc("Write the size and cost of the analysis of each function to "
+      "<file> as JSON lines (see DepTelemetry.h)"),
+    cl::value_desc("file"), cl::init(""));
+
+static cl::opt<std::string> DiffAgainst("depcheck-diff-against",
+    cl::desc("Instead of analyzing the module, write the dependencies that "
+      "differ from the older version <file> of it (see DepDiff.h)"),
+    cl::value_desc("file"), cl::init(""));
+
+static cl::opt<std::string> DiffOut("depcheck-diff-out",
+    cl::desc("Output file of -depcheck-diff-against"),
+    cl::value_desc("file"), cl::init("depcheck.diff"));
+
+namespace {
+  // Collects the arguments (e.g., "basicaa") of the alias analyses
+  // available to a pass
+  struct AliasAnalysisLister : public PassRegistrationListener {
+    AliasAnalysisLister(Pass &P, std::vector<std::string> &Names)
+      : P_(P), Names_(Names) { }
+
+    virtual void passEnumerate(const PassInfo *PI) {
+      if (PI->isAnalysisGroup())
+        return;
+      const std::vector<const PassInfo *> &ifaces =
+        PI->getInterfacesImplemented();
+      for (auto i = ifaces.begin(), e = ifaces.end(); i != e; ++i) {
+        if ((*i)->getTypeInfo() == &AliasAnalysis::ID) {
+          if (P_.getResolver()->getAnalysisIfAvailable(PI->getTypeInfo(),
+                true))
+            Names_.push_back(PI->getPassArgument());
+          return;
+        }
+      }
+    }
+
+    Pass &P_;
+    std::vector<std::string> &Names_;
   };
+} // end anonymous namespace
+
+// Alias analyses that derive the results of a function from other functions
+// (see DepCache.h)
+static bool isInterproceduralAA(StringRef Name) {
+  return Name == "globalsmodref-aa";
+}
+
+// Hash of the options that change the analysis results, used to key the
+// cache entries. Both control dependence engines give the same results so
+// -depcheck-cd-engine is not part of it; the same holds for
+// -depcheck-local-engine. The budgets are not part of it since the cache
+// only stores results no budget cut short. AliasAnalyses are the sorted
+// arguments of the alias analyses the results are calculated with.
+static StableDigest analysisOptionsHash(
+    const std::vector<std::string> &AliasAnalyses) {
+  StableHasher H;
+  H.add(StringRef("depcheck"));
+  H.add(bool(ModRefSummariesOpt));
+  H.add(uint64_t(AliasAnalyses.size()));
+  for (auto i = AliasAnalyses.begin(), e = AliasAnalyses.end(); i != e; ++i)
+    H.add(StringRef(*i));
+  return H.finish();
+}
+
+void applyAnalysisOptions(DataDependence &DataDep,
+    ControlDependence &ControlDep) {
+  ControlDep.setEngine(CDEngine);
+  DataDep.setLocalEngine(LocalEngine);
 
-  bool DependenceCheck::runOnModule(Module &M) {
+  DataDependence::Budget budget;
+  budget.MaxQueryBlocks = MaxQueryBlocks;
+  budget.MaxQueryResults = MaxQueryResults;
+  budget.MaxFunctionSteps = MaxFunctionSteps;
+  budget.MaxFunctionMillis = MaxFunctionMillis;
+  DataDep.setBudget(budget);
+}
+
+bool DependenceCheck::runOnModule(Module &M) {
 #ifdef MK_DEBUG
-    errs() << "[DEBUG] DependenceCheck::runOnModule()\n";
+  errs() << "[DEBUG] DependenceCheck::runOnModule()\n";
 #endif
 
-    AliasAnalysis &AA = getAnalysis<AliasAnalysis>();
+  applyAnalysisOptions(DataDep, ControlDep);
+  initPhaseTimers();
 
-    // Iterate over all instructions and get the memory dependence information.
-    // TODO: This could be scaled back to only search for one instruction. The
-    // efficiency of this depends on if MemoryDependenceAnalysis is also doing
-    // an on-demand calculation of dependence
-    for (auto mi = M.begin(); mi != M.end(); ++mi) {
-      // skip external functions
-      if (mi->isDeclaration())
-        continue;
+  // The server calculates the dependencies of the functions that are
+  // queried, as -depcheck-lazy does
+  if (!ServeSocket.empty()) {
+    serve(M);
+    return false;
+  }
 
-      // Since MemoryDependenceAnalysis is a function pass, we need to pass the
-      // current function we are examining to the getAnalysis() call.
-      MemoryDependenceAnalysis &MDA = getAnalysis<MemoryDependenceAnalysis>(*mi);
-      PostDominatorTree &PDT = getAnalysis<PostDominatorTree>(*mi);
+  // The diff analyzes both versions on pass managers of its own
+  if (!DiffAgainst.empty()) {
+    diffAgainst(M);
+    return false;
+  }
 
-      DataDep.getDataDependencies(*mi, MDA, AA);
+  // With -depcheck-lazy the dependencies are calculated by the query
+  // functions instead
+  if (LazyAnalysis)
+    return false;
 
-      ControlDep.getControlDependencies(*mi, PDT);
+  OwningPtr<DepCache> cache;
+  if (!CacheDir.empty()) {
+    bool existed;
+    if (error_code ec = sys::fs::create_directories(CacheDir.getValue(),
+          existed)) {
+      errs() << "[Warning] Error creating cache directory: "
+             << ec.message() << '\n';
+    }
+    else {
+      std::vector<std::string> aliasAnalyses;
+      AliasAnalysisLister lister(*this, aliasAnalyses);
+      lister.enumeratePasses();
+      std::sort(aliasAnalyses.begin(), aliasAnalyses.end());
 
-    } // end for (module::iterator)
+      auto ipa = std::find_if(aliasAnalyses.begin(), aliasAnalyses.end(),
+          isInterproceduralAA);
+      if (ipa != aliasAnalyses.end()) {
+        errs() << "[Warning] -depcheck-cache is not used with the "
+               << "interprocedural alias analysis -" << *ipa << '\n';
+      }
+      else {
+        cache.reset(new DepCache(CacheDir,
+              analysisOptionsHash(aliasAnalyses)));
+      }
+    }
+  }
 
+  // The cache keys of functions include the summaries of their callees
+  ensureSummaries(M);
+  if (cache && ModRefSummariesOpt)
+    cache->setSummaries(&Summaries);
 
-    // Nothing modified in IR
+  std::vector<Function *> funcs;
+  selectFunctions(M, funcs);
+
+  // With -depcheck-stream the telemetry is written as the functions are
+  // released instead of at the end
+  OwningPtr<raw_fd_ostream> telemetry;
+  if (StreamResults && !TelemetryFile.empty()) {
+    std::string errInfo;
+    telemetry.reset(new raw_fd_ostream(TelemetryFile.c_str(), errInfo));
+    if (!errInfo.empty()) {
+      errs() <<  "[Warning] Error opening output file: " << errInfo << '\n';
+      telemetry.reset();
+    }
+  }
+
+  auto analyze = [&](DepExportWriter *Export) {
+    if (StreamResults)
+      streamModule(funcs, Export, cache.get(), telemetry.get());
+    else
+      analyzeModule(funcs, Export, cache.get());
+  };
+
+  if (ExportFile.empty()) {
+    analyze(NULL);
+  }
+  else {
+    std::string errInfo;
+    raw_fd_ostream out(ExportFile.c_str(), errInfo, raw_fd_ostream::F_Binary);
+    if (!errInfo.empty()) {
+      errs() <<  "[Warning] Error opening output file: " << errInfo << '\n';
+      analyze(NULL);
+    }
+    else {
+      DepExportWriter writer(out, ExportFormat);
+      writer.setModule(M);
+      writer.setCompactDot(DotCompact);
+      analyze(&writer);
+      writer.finish();
+    }
+  }
+
+  // Nothing is left to check, report or print once the results have been
+  // streamed; streamModule() verifies each function before releasing it
+  if (StreamResults) {
+    if (LoopDepsOpt) {
+      errs() << "[Warning] -depcheck-loop-deps is ignored with "
+                "-depcheck-stream\n";
+    }
     return false;
   }
 
-  void DependenceCheck::print(raw_ostream &OS, const Module *m) const {
-    // dump the contents of the local Deps_ map
-    OS << "Local Dependence map size: " << DataDep.LocalDeps_.size() << '\n';
-    for (auto i = DataDep.LocalDeps_.begin(); i != DataDep.LocalDeps_.end(); ++i) {
-      assert(i->first && "NULL inst found");
-      OS << "Instruction: " << *(i->first); 
-      OS << "\n    has dependence\n";
-      OS << "    with instruction " << *(i->second.DepInst_) << '\n';
-      OS << "    of type " << DataDependence::depTypeToString(i->second.Type_) << '\n';
-    }
-    OS << "Non-Local Dependence map size: " << DataDep.NonLocalDeps_.size() << '\n';
-    for (auto i = DataDep.NonLocalDeps_.begin(); i != DataDep.NonLocalDeps_.end(); ++i) {
-      assert(i->first && "NULL inst found");
-      OS << "Instruction: " << *(i->first) 
-         << "\n    has non local dependence(s) with:\n";
-      for (auto j = i->second.begin(); j != i->second.end(); ++j) {
-        assert(j->getAddress());
-        OS << "    Address: " << *(j->getAddress()) << '\n';
+  if (VerifyCD)
+    verifyControlDependencies(M);
+
+  for (auto fi = funcs.begin(), fe = funcs.end(); LoopDepsOpt && fi != fe;
+      ++fi)
+    getLoopDependence(**fi);
+
+  if (!TelemetryFile.empty())
+    writeTelemetryReport(M);
+
+  // Nothing modified in IR
+  return false;
+}
+
+void DependenceCheck::selectFunctions(Module &M,
+    std::vector<Function *> &Funcs) {
+  FunctionFilter filter;
+  filter.setEntries(std::vector<std::string>(EntryFunctions.begin(),
+        EntryFunctions.end()));
+  filter.setAllowed(std::vector<std::string>(AllowFunctions.begin(),
+        AllowFunctions.end()));
+  filter.setDenied(std::vector<std::string>(DenyFunctions.begin(),
+        DenyFunctions.end()));
+  if (!FunctionOrder.empty())
+    filter.readOrder(FunctionOrder);
+
+  filter.select(M,
+      filter.needsCallGraph() ? &getAnalysis<CallGraph>() : NULL, Funcs);
+}
+
+void DependenceCheck::analyzeModule(const std::vector<Function *> &funcs,
+    DepExportWriter *Export, DepCache *Cache) {
+  if (NumThreads > 1) {
+    // Only the functions missing from the cache go to the workers
+    std::vector<Function *> misses;
+    for (auto i = funcs.begin(), e = funcs.end(); i != e; ++i) {
+      if (analyzed(**i))
+        continue;
+      if (Cache == NULL || !Cache->load(**i, DataDep, ControlDep))
+        misses.push_back(*i);
+    }
+
+    runParallel(misses);
+
+    for (auto i = misses.begin(), e = misses.end(); Cache && i != e; ++i) {
+      Cache->store(**i, *DataDep.getFunctionDeps(*i),
+          *ControlDep.getCompactCDG(*i));
+    }
+
+    // The functions are only complete once the shards have been merged
+    for (auto i = funcs.begin(), e = funcs.end(); Export && i != e; ++i) {
+      Export->writeFunction(**i, DataDep.getFunctionDeps(*i),
+          ControlDep.getCompactCDG(*i));
+    }
+    return;
+  }
+
+  // Iterate over all instructions and get the memory dependence information.
+  for (auto i = funcs.begin(), e = funcs.end(); i != e; ++i) {
+    if (!analyzed(**i)
+        && (Cache == NULL || !Cache->load(**i, DataDep, ControlDep))) {
+      ensureDataDependencies(**i);
+
+      ensureControlDependencies(**i);
+
+      if (Cache) {
+        Cache->store(**i, *DataDep.getFunctionDeps(*i),
+            *ControlDep.getCompactCDG(*i));
+      }
+    }
+
+    if (Export) {
+      Export->writeFunction(**i, DataDep.getFunctionDeps(*i),
+          ControlDep.getCompactCDG(*i));
+    }
+  } // end for (module::iterator)
+}
+
+void DependenceCheck::streamModule(const std::vector<Function *> &funcs,
+    DepExportWriter *Export, DepCache *Cache, raw_ostream *Telemetry) {
+  // The results of one function after they were moved out of DataDep
+  // and ControlDep
+  struct Released {
+    Function *F;
+    unsigned Id; // position in the module, for the telemetry
+    bool HasData;
+    bool HasControl;
+    DataDependence::FunctionDeps Data;
+    CompactCDG Control;
+  };
+
+  DenseMap<const Function *, unsigned> moduleIds;
+  if (!funcs.empty()) {
+    const Module &M = *funcs.front()->getParent();
+    unsigned id = 0;
+    for (auto mi = M.begin(), me = M.end(); mi != me; ++mi, ++id)
+      moduleIds[&*mi] = id;
+  }
+
+  // Analyzes the function Item of funcs on this thread (the analyses of
+  // the pass manager cannot be used anywhere else) and moves its results
+  // into R
+  auto analyze = [&](unsigned Item, Released &R) {
+    Function &F = *funcs[Item];
+    if (!analyzed(F)
+        && (Cache == NULL || !Cache->load(F, DataDep, ControlDep))) {
+      ensureDataDependencies(F);
+      ensureControlDependencies(F);
+      if (Cache) {
+        Cache->store(F, *DataDep.getFunctionDeps(&F),
+            *ControlDep.getCompactCDG(&F));
+      }
+    }
+
+    if (VerifyCD) {
+      DominatorTreeBase<BasicBlock> PDT(true);
+      PDT.recalculate(F);
+      if (!ControlDep.verify(F, PDT)) {
+        errs() << "[Warning] control dependence engines disagree on "
+                  "function " << F.getName() << '\n';
+      }
+    }
+
+    R.F = &F;
+    R.Id = moduleIds.lookup(&F);
+    R.HasData = DataDep.releaseFunctionDeps(&F, R.Data);
+    R.HasControl = ControlDep.releaseCompactCDG(&F, R.Control);
+  };
+
+  // Writes R and frees its results. This only reads R and the IR of its
+  // function, so it can run while the next function is analyzed.
+  auto emit = [&](Released &R) {
+    const DataDependence::FunctionDeps *FD = R.HasData ? &R.Data : NULL;
+    const CompactCDG *cdg = R.HasControl ? &R.Control : NULL;
+    if (Export)
+      Export->writeFunction(*R.F, FD, cdg);
+    if (Telemetry)
+      writeTelemetry(*Telemetry, R.Id, *R.F, FD, cdg);
+
+    R.Data = DataDependence::FunctionDeps();
+    R.Control = CompactCDG();
+  };
+
+  if (NumThreads <= 1) {
+    Released r;
+    for (unsigned i = 0; i < funcs.size(); ++i) {
+      analyze(i, r);
+      emit(r);
+    }
+    return;
+  }
+
+  // Double buffering: the function i is analyzed into slots[i % 2] while
+  // a single worker emits the function i - 1 from the other slot. With
+  // one worker the pool hands out the items in order.
+  Released slots[2];
+  unsigned numReady = 0;   // functions analyzed so far
+  unsigned numEmitted = 0; // functions written so far
+  std::mutex lock;
+  std::condition_variable changed;
+
+  WorkerPool emitter(1);
+  emitter.start(funcs.size(), [&](unsigned, unsigned Item) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      changed.wait(guard, [&]() { return numReady > Item; });
+    }
+    emit(slots[Item % 2]);
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      numEmitted = Item + 1;
+    }
+    changed.notify_all();
+  });
+
+  for (unsigned i = 0; i < funcs.size(); ++i) {
+    // Wait until the function that used this slot has been written
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      changed.wait(guard, [&]() { return numEmitted + 2 > i; });
+    }
+    analyze(i, slots[i % 2]);
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      numReady = i + 1;
+    }
+    changed.notify_all();
+  }
+
+  emitter.wait();
+}
+
+void DependenceCheck::print(raw_ostream &OS, const Module *m) const {
+  // The results of each function in module order, so the output does not
+  // depend on the order the functions were analyzed in (threads,
+  // -depcheck-function-order, lazy queries). Within a function everything
+  // is in the order of the dense IDs.
+  std::vector<const DataDependence::FunctionDeps *> fdeps;
+  std::vector<const Function *> funcs;
+  if (m != NULL) {
+    for (auto mi = m->begin(), me = m->end(); mi != me; ++mi)
+      funcs.push_back(&*mi);
+  }
+  else {
+    const std::vector<DataDependence::FunctionDeps> &all =
+      DataDep.getFunctionDeps();
+    for (auto fi = all.begin(), fe = all.end(); fi != fe; ++fi)
+      funcs.push_back(fi->F_);
+  }
+  for (auto fi = funcs.begin(), fe = funcs.end(); fi != fe; ++fi) {
+    if (const DataDependence::FunctionDeps *FD = DataDep.getFunctionDeps(*fi))
+      fdeps.push_back(FD);
+  }
+
+  // dump the local dependencies
+  OS << "Local Dependence map size: " << DataDep.numLocalDeps() << '\n';
+  for (auto fdi = fdeps.begin(), fde = fdeps.end(); fdi != fde; ++fdi) {
+    const DataDependence::FunctionDeps *fi = *fdi;
+    for (unsigned i = 0; i < fi->size(); ++i)
+      fi->printLocalDep(OS, i);
+  }
+  OS << "Non-Local Dependence map size: " << DataDep.numNonLocalDeps() << '\n';
+  for (auto fdi = fdeps.begin(), fde = fdeps.end(); fdi != fde; ++fdi) {
+    const DataDependence::FunctionDeps *fi = *fdi;
+    for (unsigned i = 0; i < fi->size(); ++i)
+      fi->printNonLocalDeps(OS, i);
+  }
+
+  // dump the loop dependencies
+  for (auto fi = funcs.begin(), fe = funcs.end(); fi != fe; ++fi) {
+    auto li = LoopDeps.find(*fi);
+    if (li == LoopDeps.end())
+      continue;
+    const DataDependence::FunctionDeps *FD = DataDep.getFunctionDeps(*fi);
+    for (unsigned n = 0; FD && n < li->second->numNests(); ++n) {
+      const LoopDependence::Nest &nest = li->second->getNest(n);
+      OS << "Loop nest " << nest.Header->getName() << " in "
+         << (*fi)->getName()
+         << (li->second->isParallel(nest.Header) ? " (parallel)" : "")
+         << '\n';
+      for (auto pi = nest.Pairs.begin(), pe = nest.Pairs.end(); pi != pe;
+          ++pi) {
+        OS << "Instruction: " << *(FD->getInst(pi->Sink))
+           << "\n    depends on " << *(FD->getInst(pi->Source))
+           << "\n    " << LoopDependence::kindToString(pi->K) << " (";
+        for (unsigned l = 0; l < pi->Directions.size(); ++l) {
+          if (l)
+            OS << ", ";
+          OS << LoopDependence::directionToChar(pi->Directions[l]);
+          if (pi->Directions[l] != LoopDependence::All)
+            OS << pi->Distances[l];
+        }
+        OS << ")\n";
       }
     }
+  }
 
-    // create a dot file for the CDG
-    ControlDep.toDot(std::string(""));
+  // create dot files for the CDG
+  if (DotDir.empty()) {
+    ControlDep.toDot(std::string(""), DotCompact);
+  }
+  else {
+    std::vector<std::string> funcs(DotFunctions.begin(), DotFunctions.end());
+    ControlDep.toDotFiles(DotDir, funcs, DotCompact);
+  }
 
-    // dump the contents of the control dependencies
-    for (auto i = ControlDep.controlDeps_.begin(), 
-        ei = ControlDep.controlDeps_.end(); i != ei; ++i) {
-      std::set<BasicBlock *> depSet;
-      depSet = i->second;
+  // dump the contents of the control dependencies
+  for (auto fi = funcs.begin(), fe = funcs.end(); fi != fe; ++fi) {
+    const CompactCDG *cdgp = ControlDep.getCompactCDG(*fi);
+    if (cdgp == NULL)
+      continue;
+    const CompactCDG &cdg = *cdgp;
+    SmallVector<unsigned, 16> deps;
+    for (unsigned i = 0; i < cdg.size(); ++i) {
+      deps.clear();
+      cdg.dependents(i, deps);
+      if (deps.empty())
+        continue;
 
-      OS << "BasicBlock: " << *(i->first)
+      OS << "BasicBlock: " << *(cdg.getBlock(i))
          << "Is dependent on:\n";
-      for (auto j = depSet.begin(), ej = depSet.end(); j != ej; ++j) {
-        // *j is a pointer to a BasicBlock, **j is a BasicBlock
-        OS << **j << '\n';
+      for (auto j = deps.begin(), ej = deps.end(); j != ej; ++j) {
+        OS << *(cdg.getBlock(*j)) << '\n';
       }
     }
   }
+}
 
-  DependenceCheck::DependenceCheck() : ModulePass(ID) { 
-    initializeMemoryDependenceAnalysisPass(*PassRegistry::getPassRegistry());
+void DependenceCheck::runParallel(const std::vector<Function *> &Funcs) {
+  if (!llvm_is_multithreaded())
+    llvm_start_multithreaded();
+
+  // Functions whose CFG did not change keep their control dependencies
+  std::vector<Function *> control;
+  for (auto i = Funcs.begin(), e = Funcs.end(); i != e; ++i) {
+    if (!hasControlDependencies(**i))
+      control.push_back(*i);
   }
 
-  void DependenceCheck::getAnalysisUsage(AnalysisUsage &AU) const {
-    // For memory dependence analysis
-    AU.addRequired<AliasAnalysis>();
-    AU.addRequired<MemoryDependenceAnalysis>();
+  WorkerPool pool(NumThreads);
+  std::vector<ControlDependence> shards(pool.size());
+  std::vector<unsigned> shardOf(control.size());
+  for (auto i = shards.begin(), e = shards.end(); i != e; ++i)
+    i->setEngine(CDEngine);
+
+  pool.start(control.size(), [&](unsigned Worker, unsigned Item) {
+    Function &F = *control[Item];
+
+    DominatorTreeBase<BasicBlock> PDT(true);
+    PDT.recalculate(F);
+
+    shards[Worker].getControlDependencies(F, PDT);
+    shardOf[Item] = Worker;
+  });
+
+  for (auto i = Funcs.begin(), e = Funcs.end(); i != e; ++i)
+    ensureDataDependencies(**i);
+
+  pool.wait();
+
+  // Merge in module order
+  for (unsigned i = 0; i < control.size(); ++i)
+    ControlDep.moveFunction(shards[shardOf[i]], control[i]);
+  NumCDGsBuilt += control.size();
+}
+
+void DependenceCheck::verifyControlDependencies(Module &M) {
+  for (auto mi = M.begin(); mi != M.end(); ++mi) {
+    if (ControlDep.getCompactCDG(&*mi) == NULL)
+      continue;
+
+    DominatorTreeBase<BasicBlock> PDT(true);
+    PDT.recalculate(*mi);
+
+    if (!ControlDep.verify(*mi, PDT)) {
+      errs() << "[Warning] control dependence engines disagree on function "
+             << mi->getName() << '\n';
+    }
+  }
+}
+
+void DependenceCheck::serve(Module &M) {
+  DepServer server(ServeSocket);
+  if (!server.listen())
+    return;
+
+  server.run([&](StringRef Request, raw_ostream &Out) {
+    return handleRequest(M, Request, Out);
+  });
+}
+
+void DependenceCheck::writeTelemetryReport(Module &M) {
+  std::string errInfo;
+  raw_fd_ostream out(TelemetryFile.c_str(), errInfo);
+  if (!errInfo.empty()) {
+    errs() <<  "[Warning] Error opening output file: " << errInfo << '\n';
+    return;
+  }
+
+  unsigned id = 0;
+  for (auto mi = M.begin(), me = M.end(); mi != me; ++mi, ++id) {
+    const DataDependence::FunctionDeps *FD = DataDep.getFunctionDeps(&*mi);
+    const CompactCDG *cdg = ControlDep.getCompactCDG(&*mi);
+    if (FD != NULL || cdg != NULL)
+      writeTelemetry(out, id, *mi, FD, cdg);
+  }
+}
+
+void DependenceCheck::diffAgainst(Module &M) {
+  SMDiagnostic err;
+  OwningPtr<Module> old(ParseIRFile(DiffAgainst, err, M.getContext()));
+  if (!old) {
+    err.print("depcheck", errs());
+    return;
+  }
+
+  std::string errInfo;
+  raw_fd_ostream out(DiffOut.c_str(), errInfo, raw_fd_ostream::F_Binary);
+  if (!errInfo.empty()) {
+    errs() <<  "[Warning] Error opening output file: " << errInfo << '\n';
+    return;
+  }
+
+  DepDiff diff(*old, M);
+  diff.run(out);
+}
+
+// Parses Id from Word and checks it is below Size. Writes an error to Out
+// and returns false otherwise.
+static bool parseId(StringRef Word, unsigned Size, unsigned &Id,
+    raw_ostream &Out) {
+  if (Word.getAsInteger(10, Id) || Id >= Size) {
+    Out << "error invalid id " << Word;
+    return false;
+  }
+  return true;
+}
+
+bool DependenceCheck::handleRequest(Module &M, StringRef Request,
+    raw_ostream &Out) {
+  SmallVector<StringRef, 8> words;
+  Request.split(words, " ", -1, false);
+  assert(!words.empty() && "empty requests are skipped by DepServer");
+  StringRef cmd = words[0];
+
+  if (cmd == "quit") {
+    Out << "ok";
+    return true;
+  }
+  if (cmd == "shutdown") {
+    Out << "ok";
+    return false;
+  }
+
+  if (cmd != "info" && cmd != "deps" && cmd != "cdeps"
+      && cmd != "controllers" && cmd != "slice") {
+    Out << "error unknown request " << cmd;
+    return true;
+  }
+  if (words.size() < 2) {
+    Out << "error missing function";
+    return true;
+  }
+  Function *F = M.getFunction(words[1]);
+  if (F == NULL || F->isDeclaration()) {
+    Out << "error unknown function " << words[1];
+    return true;
+  }
+
+  if (cmd == "info") {
+    unsigned insts = 0;
+    for (auto bi = F->begin(), be = F->end(); bi != be; ++bi)
+      insts += bi->size();
+    Out << "ok " << F->size() << ' ' << insts;
+    return true;
+  }
+
+  if (cmd == "deps") {
+    if (words.size() != 3) {
+      Out << "error usage: deps <function> <instruction>";
+      return true;
+    }
+    ensureDataDependencies(*F);
+    const DataDependence::FunctionDeps *FD = DataDep.getFunctionDeps(F);
+    unsigned id;
+    if (!parseId(words[2], FD->size(), id, Out))
+      return true;
+
+    const DataDependence::DepInfo &local = FD->getLocalDep(id);
+    Out << "ok";
+    if (local.valid()) {
+      unsigned dep;
+      Out << ' ' << DataDependence::depTypeToString(local.Type_) << ' ';
+      if (local.DepInst_ && FD->getId(local.DepInst_, dep))
+        Out << dep;
+      else
+        Out << '-';
+    }
+    else {
+      Out << " none -";
+    }
+
+    ArrayRef<DataDependence::NonLocalDep> nonLocal = FD->getNonLocalDeps(id);
+    for (auto i = nonLocal.begin(), e = nonLocal.end(); i != e; ++i) {
+      Out << ' ' << i->Block_ << ',';
+      if (i->hasDepInst())
+        Out << i->DepInst_;
+      else
+        Out << '-';
+      Out << ',' << DataDependence::depTypeToString(i->getType());
+    }
+    return true;
+  }
+
+  if (cmd == "cdeps" || cmd == "controllers") {
+    if (words.size() != 3) {
+      Out << "error usage: " << cmd << " <function> <block>";
+      return true;
+    }
+    ensureControlDependencies(*F);
+    const CompactCDG *cdg = ControlDep.getCompactCDG(F);
+    unsigned id;
+    if (!parseId(words[2], cdg->size(), id, Out))
+      return true;
+
+    Out << "ok";
+    if (cmd == "cdeps") {
+      SmallVector<unsigned, 16> deps;
+      cdg->dependents(id, deps);
+      for (auto i = deps.begin(), e = deps.end(); i != e; ++i)
+        Out << ' ' << *i;
+    }
+    else {
+      ArrayRef<CDCondition> conds = cdg->conditions(id);
+      for (auto i = conds.begin(), e = conds.end(); i != e; ++i)
+        Out << ' ' << i->Controller << ',' << i->Successor;
+    }
+    return true;
+  }
+
+  // slice <function> backward|forward <instruction>...
+  if (words.size() < 4
+      || (words[2] != "backward" && words[2] != "forward")) {
+    Out << "error usage: slice <function> backward|forward <instruction>...";
+    return true;
+  }
+  Slicer &slicer = getSlicer(*F);
+  const DataDependence::FunctionDeps *FD = DataDep.getFunctionDeps(F);
+  SmallVector<unsigned, 8> criteria;
+  for (unsigned i = 3; i < words.size(); ++i) {
+    unsigned id;
+    if (!parseId(words[i], FD->size(), id, Out))
+      return true;
+    criteria.push_back(id);
+  }
+
+  BitVector slice;
+  slicer.slice(criteria, words[2] == "backward" ? Slicer::Backward
+      : Slicer::Forward, slice);
+  Out << "ok";
+  for (int i = slice.find_first(); i != -1; i = slice.find_next(i))
+    Out << ' ' << i;
+  return true;
+}
+
+void DependenceCheck::ensureSummaries(Module &M) {
+  if (!ModRefSummariesOpt || Summaries.computed())
+    return;
+
+  Summaries.compute(M, getAnalysis<CallGraph>(), getAnalysis<AliasAnalysis>(),
+      getAnalysisIfAvailable<DataLayout>(), NumThreads);
+
+  // After invalidate(): drop the results calculated with callee summaries
+  // that changed
+  std::vector<const Function *> stale;
+  for (auto i = CalleeHashes.begin(), e = CalleeHashes.end(); i != e; ++i) {
+    if (Summaries.hashCallees(*i->first) != i->second)
+      stale.push_back(i->first);
+  }
+  CalleeHashes.clear();
+  for (auto i = stale.begin(), e = stale.end(); i != e; ++i) {
+    DataDep.invalidate(*i);
+    Slicers.erase(*i);
+    LoopDeps.erase(*i);
+  }
+}
+
+void DependenceCheck::invalidate(Function &F) {
+  if (Summaries.computed()) {
+    // Remember the summaries the other results were calculated with; the
+    // summaries are recalculated by the next ensureSummaries()
+    const std::vector<DataDependence::FunctionDeps> &fdeps =
+      DataDep.getFunctionDeps();
+    for (auto i = fdeps.begin(), e = fdeps.end(); i != e; ++i) {
+      if (i->F_ != &F)
+        CalleeHashes[i->F_] = Summaries.hashCallees(*i->F_);
+    }
+    Summaries.clear();
+  }
+  CalleeHashes.erase(&F);
+
+  DataDep.invalidate(&F);
+  Slicers.erase(&F);
+  LoopDeps.erase(&F);
+  if (ControlDep.getCompactCDG(&F) != NULL)
+    StaleCFG.insert(&F);
+}
+
+void DependenceCheck::invalidateBlocks(ArrayRef<BasicBlock *> Blocks) {
+  for (auto i = Blocks.begin(), e = Blocks.end(); i != e; ++i) {
+    Function *F = (*i)->getParent();
+    invalidate(*F);
+    ControlDep.invalidate(F);
+    StaleCFG.erase(F);
+  }
+}
+
+bool DependenceCheck::hasControlDependencies(Function &F) {
+  if (ControlDep.getCompactCDG(&F) == NULL)
+    return false;
+  if (StaleCFG.erase(&F)) {
+    if (!ControlDep.sameBlockStructure(F)) {
+      ControlDep.invalidate(&F);
+      return false;
+    }
+    ++NumCDGsReused;
+  }
+  return true;
+}
+
+bool DependenceCheck::analyzed(Function &F) {
+  return DataDep.getFunctionDeps(&F) != NULL && hasControlDependencies(F);
+}
+
+void DependenceCheck::ensureDataDependencies(Function &F) {
+  if (DataDep.getFunctionDeps(&F) != NULL)
+    return;
+
+  ensureSummaries(*F.getParent());
+
+  AliasAnalysis &AA = getAnalysis<AliasAnalysis>();
+
+  // Since MemoryDependenceAnalysis is a function pass, we need to pass the
+  // current function we are examining to the getAnalysis() call.
+  MemoryDependenceAnalysis &MDA = getAnalysis<MemoryDependenceAnalysis>(F);
+
+  // Recognizes calls to free() the same way MDA does
+  const TargetLibraryInfo *TLI = getAnalysisIfAvailable<TargetLibraryInfo>();
+
+  DataDep.getDataDependencies(F, MDA, AA, TLI,
+      ModRefSummariesOpt ? &Summaries : NULL);
+  ++NumDataAnalyzed;
+}
+
+void DependenceCheck::ensureControlDependencies(Function &F) {
+  if (hasControlDependencies(F))
+    return;
+
+  // Built here rather than required from the pass manager: a required
+  // PostDominatorTree would be in the on-the-fly manager that
+  // getAnalysis<MemoryDependenceAnalysis>(F) runs, and so be built for
+  // every data dependence query as well (and twice per function with
+  // -depcheck-threads, whose workers build their own)
+  DominatorTreeBase<BasicBlock> PDT(true);
+  PDT.recalculate(F);
+
+  ControlDep.getControlDependencies(F, PDT);
+  ++NumCDGsBuilt;
+}
+
+const DataDependence::DepInfo *DependenceCheck::getDependencies(
+    Instruction *I, ArrayRef<DataDependence::NonLocalDep> &NonLocal) {
+  ensureDataDependencies(*(I->getParent()->getParent()));
+
+  NonLocal = DataDep.getNonLocalDeps(I);
+  return DataDep.getLocalDep(I);
+}
+
+void DependenceCheck::getControlDependents(BasicBlock *BB,
+    SmallVectorImpl<BasicBlock *> &Deps) {
+  ensureControlDependencies(*(BB->getParent()));
+
+  const CompactCDG *cdg = ControlDep.getCompactCDG(BB->getParent());
+  assert(cdg && "control dependencies were not calculated");
+
+  unsigned id;
+  if (!cdg->getId(BB, id))
+    return;
+
+  SmallVector<unsigned, 16> deps;
+  cdg->dependents(id, deps);
+  for (auto i = deps.begin(), e = deps.end(); i != e; ++i)
+    Deps.push_back(cdg->getBlock(*i));
+}
+
+bool DependenceCheck::sameControlConditions(BasicBlock *A, BasicBlock *B) {
+  assert(A->getParent() == B->getParent() && "blocks of different functions");
+  ensureControlDependencies(*(A->getParent()));
+
+  const CompactCDG *cdg = ControlDep.getCompactCDG(A->getParent());
+  assert(cdg && "control dependencies were not calculated");
+
+  unsigned idA, idB;
+  if (!cdg->getId(A, idA) || !cdg->getId(B, idB))
+    return false;
+  return cdg->sameConditions(idA, idB);
+}
+
+bool DependenceCheck::isControlDependent(BasicBlock *Dependent,
+    BasicBlock *Controller) {
+  assert(Dependent->getParent() == Controller->getParent() &&
+      "blocks of different functions");
+  ensureControlDependencies(*(Dependent->getParent()));
+
+  const CompactCDG *cdg = ControlDep.getCompactCDG(Dependent->getParent());
+  assert(cdg && "control dependencies were not calculated");
+
+  unsigned dep, ctrl;
+  if (!cdg->getId(Dependent, dep) || !cdg->getId(Controller, ctrl))
+    return false;
+  return cdg->isDependent(ctrl, dep);
+}
+
+void DependenceCheck::getControllers(BasicBlock *BB,
+    SmallVectorImpl<BasicBlock *> &Controllers,
+    SmallVectorImpl<BasicBlock *> *Successors) {
+  ensureControlDependencies(*(BB->getParent()));
+
+  const CompactCDG *cdg = ControlDep.getCompactCDG(BB->getParent());
+  assert(cdg && "control dependencies were not calculated");
+
+  unsigned id;
+  if (!cdg->getId(BB, id))
+    return;
+
+  if (Successors == NULL) {
+    ArrayRef<unsigned> ctrls = cdg->controllers(id);
+    for (auto i = ctrls.begin(), e = ctrls.end(); i != e; ++i)
+      Controllers.push_back(cdg->getBlock(*i));
+    return;
+  }
+
+  ArrayRef<CDCondition> conds = cdg->conditions(id);
+  for (auto i = conds.begin(), e = conds.end(); i != e; ++i) {
+    Controllers.push_back(cdg->getBlock(i->Controller));
+    Successors->push_back(cdg->getBlock(i->Successor));
+  }
+}
+
+void DependenceCheck::getControllingBranches(Instruction *I,
+    SmallVectorImpl<TerminatorInst *> &Branches,
+    SmallVectorImpl<unsigned> &Indices) {
+  Function *F = I->getParent()->getParent();
+  ensureControlDependencies(*F);
+
+  const CompactCDG *cdg = ControlDep.getCompactCDG(F);
+  assert(cdg && "control dependencies were not calculated");
+
+  ArrayRef<CDEdge> edges = cdg->controllingEdges(I);
+  for (auto i = edges.begin(), e = edges.end(); i != e; ++i) {
+    Branches.push_back(cdg->getTerminator(*i));
+    Indices.push_back(i->Index);
+  }
+}
+
+Slicer &DependenceCheck::getSlicer(Function &F) {
+  std::unique_ptr<Slicer> &slicer = Slicers[&F];
+  if (!slicer) {
+    ensureDataDependencies(F);
+    ensureControlDependencies(F);
+    slicer.reset(new Slicer(*DataDep.getFunctionDeps(&F),
+          *ControlDep.getCompactCDG(&F)));
+  }
+  return *slicer;
+}
+
+const LoopDependence &DependenceCheck::getLoopDependence(Function &F) {
+  assert(LoopDepsOpt && "-depcheck-loop-deps is required");
+  std::unique_ptr<LoopDependence> &LD = LoopDeps[&F];
+  if (!LD) {
+    ensureDataDependencies(F);
+
+    // The module pass on-the-fly analyses are rerun on every request, so
+    // LoopInfo is fetched again after ScalarEvolution
+    ScalarEvolution &SE = getAnalysis<ScalarEvolution>(F);
+    LoopInfo &LI = getAnalysis<LoopInfo>(F);
+    LD.reset(new LoopDependence());
+    LD->analyze(*DataDep.getFunctionDeps(&F), LI, SE,
+        getAnalysisIfAvailable<DataLayout>());
+  }
+  return *LD;
+}
+
+void DependenceCheck::getSlice(ArrayRef<Instruction *> Criteria,
+    Slicer::Direction Dir, SmallVectorImpl<Instruction *> &Slice) {
+  // Group the criteria by function, keeping the order of first
+  // appearance
+  std::vector<Function *> funcs;
+  std::map<Function *, SmallVector<unsigned, 8> > ids;
+  for (auto i = Criteria.begin(), e = Criteria.end(); i != e; ++i) {
+    Function *F = (*i)->getParent()->getParent();
+    auto it = ids.find(F);
+    if (it == ids.end()) {
+      funcs.push_back(F);
+      getSlicer(*F);
+      it = ids.insert(std::make_pair(F, SmallVector<unsigned, 8>())).first;
+    }
+
+    unsigned id;
+    bool found = DataDep.getFunctionDeps(F)->getId(*i, id);
+    assert(found && "instruction was not numbered");
+    (void)found;
+    it->second.push_back(id);
+  }
+
+  BitVector slice;
+  for (auto fi = funcs.begin(), fe = funcs.end(); fi != fe; ++fi) {
+    getSlicer(**fi).slice(ids[*fi], Dir, slice);
+
+    const DataDependence::FunctionDeps *FD = DataDep.getFunctionDeps(*fi);
+    for (int i = slice.find_first(); i != -1; i = slice.find_next(i))
+      Slice.push_back(FD->getInst(i));
+  }
+}
+
+DependenceCheck::DependenceCheck() : ModulePass(ID) { 
+  initializeMemoryDependenceAnalysisPass(*PassRegistry::getPassRegistry());
+}
+
+void DependenceCheck::getAnalysisUsage(AnalysisUsage &AU) const {
+  // For memory dependence analysis
+  AU.addRequired<AliasAnalysis>();
+  AU.addRequired<MemoryDependenceAnalysis>();
 
-    // For control dependence analysis
-    AU.addRequired<PostDominatorTree>();
+  // For the mod/ref summaries and -depcheck-entry
+  if (ModRefSummariesOpt || !EntryFunctions.empty())
+    AU.addRequired<CallGraph>();
 
-    AU.setPreservesAll();
+  // For the loop dependencies
+  if (LoopDepsOpt) {
+    AU.addRequired<LoopInfo>();
+    AU.addRequired<ScalarEvolution>();
   }
 
-} // end namespace
+  AU.setPreservesAll();
+}
 
 char DependenceCheck::ID = 0;
 static RegisterPass<DependenceCheck> X("depcheck", "check control and data dependencies of instructions", 
@@ -0,0 +1,252 @@
+// Author: Markus Kusano
+//
+// Module pass checking the control and data dependencies of instructions
+// (-depcheck).
+//
+// Besides the -analyze output, exports and the query server, the results
+// are available to other passes loaded with the library through the
+// on-demand queries below:
+//
+//  void getAnalysisUsage(AnalysisUsage &AU) const {
+//    AU.addRequired<DependenceCheck>();
+//    AU.setPreservesAll();
+//  }
+//
+//  bool runOnModule(Module &M) {
+//    DependenceCheck &DC = getAnalysis<DependenceCheck>();
+//    SmallVector<BasicBlock *, 4> ctrls;
+//    DC.getControllers(BB, ctrls);
+//    ...
+//  }
+//
+// Run it with -depcheck-lazy so only the queried functions are analyzed.
+// A pass that changes the IR reports the functions it changed with
+// invalidate() (or invalidateBlocks() if it changed their CFG) before the
+// next query. See DependenceQuery.cpp (-depcheck-query) for a client.
+
+#ifndef DEPENDENCE_CHECK_H
+#define DEPENDENCE_CHECK_H
+
+#include "ControlDependence.h"
+#include "DataDependence.h"
+#include "LoopDependence.h"
+#include "ModRefSummary.h"
+#include "Slicer.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+using namespace llvm;
+
+class DepCache;
+class DepExportWriter;
+
+// This pass is a module pass for now. I chose this with the idea that the
+// pass could be asked the question: "What are the dependencies of this
+// instruction?"
+struct DependenceCheck : public ModulePass {
+  // Default constructor
+  DependenceCheck();
+
+  // DataDependence Object. Holds and calculates the data dependency information
+  DataDependence DataDep;
+
+  // ControlDependence object. Holds and calculates the control dependency
+  // information
+  ControlDependence ControlDep;
+
+  // Interprocedural mod/ref summaries used by DataDep with
+  // -depcheck-modref-summaries. Computed for the whole module before the
+  // first data dependencies.
+  ModRefSummaries Summaries;
+
+  static char ID; // pass ID
+
+  virtual bool runOnModule(Module &M);
+
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+  void print(raw_ostream &OS, const Module *m = 0) const;
+
+  // On-demand queries.
+  //
+  // The dependencies are calculated the first time a function is queried
+  // and reused afterwards. Control dependence queries build only the
+  // post-dominator tree of their function. Data dependence queries call
+  // getAnalysis<MemoryDependenceAnalysis>(F), which under the legacy pass
+  // manager runs every function analysis this pass requires on F: with
+  // -depcheck-loop-deps that includes LoopInfo and ScalarEvolution. With
+  // -depcheck-lazy nothing is calculated in runOnModule() so the cost is
+  // proportional to the functions queried.
+  //
+  // These call getAnalysis() so they must be used while the pass manager
+  // that ran this pass is still alive (e.g., from a later pass).
+
+  // Returns the local dependence of I, or NULL if I has none. NonLocal is
+  // set to the non-local results of I (empty if there are none).
+  const DataDependence::DepInfo *getDependencies(Instruction *I,
+      ArrayRef<DataDependence::NonLocalDep> &NonLocal);
+
+  // Fills Deps with the basic blocks control dependent on BB
+  void getControlDependents(BasicBlock *BB,
+      SmallVectorImpl<BasicBlock *> &Deps);
+
+  // Fills Controllers with the basic blocks BB is control dependent on.
+  // If Successors is not NULL it is filled in parallel with the successor
+  // of each controller through which BB is reached; a controller appears
+  // once for every such successor.
+  void getControllers(BasicBlock *BB,
+      SmallVectorImpl<BasicBlock *> &Controllers,
+      SmallVectorImpl<BasicBlock *> *Successors = NULL);
+
+  // Fills Branches with the terminators that control the execution of I
+  // and Indices, in parallel, with the successor index of each through
+  // which I is reached. A terminator appears once for every such index.
+  void getControllingBranches(Instruction *I,
+      SmallVectorImpl<TerminatorInst *> &Branches,
+      SmallVectorImpl<unsigned> &Indices);
+
+  // Returns true if the blocks A and B of the same function are control
+  // dependent on exactly the same branches, i.e., they execute under the
+  // same conditions. This is a constant time lookup of their regions.
+  bool sameControlConditions(BasicBlock *A, BasicBlock *B);
+
+  // Returns true if Dependent is control dependent on Controller. Both
+  // must be blocks of the same function.
+  bool isControlDependent(BasicBlock *Dependent, BasicBlock *Controller);
+
+  // Appends the slice of the Criteria to Slice (see Slicer.h). Slices do
+  // not cross functions: the criteria are grouped by their function and
+  // the union of the slices of each group is calculated in one traversal.
+  // The instructions of each function are appended in their order in the
+  // function.
+  void getSlice(ArrayRef<Instruction *> Criteria, Slicer::Direction Dir,
+      SmallVectorImpl<Instruction *> &Slice);
+
+  // Returns the loop dependencies of F (see LoopDependence.h), calculating
+  // them and the data dependencies of F if needed. Requires
+  // -depcheck-loop-deps.
+  const LoopDependence &getLoopDependence(Function &F);
+
+  // Invalidation.
+  //
+  // The results are kept per function. After a transform changed some
+  // functions these drop their results; the next query only recalculates
+  // what was dropped (-stats counts the recalculated functions and the
+  // reused control dependence graphs).
+
+  // The instructions of F changed (F may be deleted). Its data
+  // dependencies and slicer are dropped. Its control dependencies are
+  // reused if its blocks and CFG edges are unchanged when they are next
+  // needed. With -depcheck-modref-summaries the summaries are
+  // recalculated and the data dependencies of the functions whose callee
+  // summaries changed are dropped as well.
+  void invalidate(Function &F);
+
+  // The CFG around Blocks changed (e.g., their terminators were rewritten
+  // or they were split). The blocks must still be in their functions.
+  // The data and control dependencies of these functions are dropped.
+  void invalidateBlocks(ArrayRef<BasicBlock *> Blocks);
+
+private:
+  // Slicer of each function sliced so far. These keep their memoized
+  // slices between queries.
+  std::map<const Function *, std::unique_ptr<Slicer> > Slicers;
+
+  // Returns the Slicer of F, calculating the dependencies of F if needed
+  Slicer &getSlicer(Function &F);
+
+  // Loop dependencies of each function with -depcheck-loop-deps. These
+  // are calculated after the data dependencies of their function.
+  std::map<const Function *, std::unique_ptr<LoopDependence> > LoopDeps;
+
+  // Functions invalidated after their control dependencies were
+  // calculated. Their CDGs are checked against their CFGs before reuse.
+  DenseSet<const Function *> StaleCFG;
+
+  // Hash of the callee summaries (ModRefSummaries::hashCallees()) the data
+  // dependencies of each function were calculated with, recorded when the
+  // summaries are dropped by invalidate()
+  DenseMap<const Function *, StableDigest> CalleeHashes;
+
+  // Returns true if the control dependencies of F have been calculated
+  // and are still valid. Stale ones are dropped.
+  bool hasControlDependencies(Function &F);
+
+  // Returns true if both the data and the control dependencies of F are
+  // available
+  bool analyzed(Function &F);
+
+  // Calculate the dependencies of all the functions in Funcs using
+  // NumThreads workers for the control dependencies. Each worker builds its
+  // own post-dominator trees and fills its own ControlDependence shard; the
+  // data dependencies are calculated on the calling thread at the same
+  // time since the analyses from the pass manager cannot be shared between
+  // threads. Only MemoryDependenceAnalysis runs on the calling thread (the
+  // pass does not require PostDominatorTree), so every post-dominator tree
+  // is built once, on a worker. The shards are merged into ControlDep at
+  // the end.
+  void runParallel(const std::vector<Function *> &Funcs);
+
+  // Writes the -depcheck-telemetry report of the analyzed functions of M
+  // in module order
+  void writeTelemetryReport(Module &M);
+
+  // With -depcheck-serve: answers queries on ServeSocket until a client
+  // asks the server to shut down
+  void serve(Module &M);
+
+  // With -depcheck-diff-against: writes the differences between the
+  // module in DiffAgainst and M to DiffOut
+  void diffAgainst(Module &M);
+
+  // Writes the response to one request of the DepServer protocol to Out.
+  // Returns false if the server should stop.
+  bool handleRequest(Module &M, StringRef Request, raw_ostream &Out);
+
+  // Compute Summaries for M with -depcheck-modref-summaries unless this
+  // has already been done
+  void ensureSummaries(Module &M);
+
+  // Calculate the data (control) dependencies of F unless this has already
+  // been done
+  void ensureDataDependencies(Function &F);
+  void ensureControlDependencies(Function &F);
+
+  // Runs ControlDependence::verify() on every analyzed function and
+  // reports the functions where the engines disagree
+  void verifyControlDependencies(Module &M);
+
+  // Fills Funcs with the defined functions of M selected by the
+  // -depcheck-entry, -depcheck-allow and -depcheck-deny options, in the
+  // order of -depcheck-function-order
+  void selectFunctions(Module &M, std::vector<Function *> &Funcs);
+
+  // Analyze the functions Funcs in order, writing each one to Export (if
+  // not NULL) as soon as it is done. If Cache is not NULL the results of
+  // functions found in it are restored instead of calculated, and the
+  // calculated results are stored in it.
+  void analyzeModule(const std::vector<Function *> &Funcs,
+      DepExportWriter *Export, DepCache *Cache);
+
+  // Same as analyzeModule() for -depcheck-stream: the results of each
+  // function are moved out of DataDep and ControlDep once it is analyzed,
+  // written to Export and Telemetry (either may be NULL) and released.
+  // With -depcheck-threads above 1 they are written by a worker while the
+  // next function is analyzed; at most two functions are held at a time.
+  void streamModule(const std::vector<Function *> &Funcs,
+      DepExportWriter *Export, DepCache *Cache, raw_ostream *Telemetry);
+};
+
+#endif // DEPENDENCE_CHECK_H
@@ -0,0 +1,107 @@
+// Author: Markus Kusano
+//
+// Client of the DependenceCheck query API (see DependenceCheck.h). For every
+// memory instruction of every defined function it prints the local
+// dependence, the number of non-local results and the blocks controlling the
+// instruction, asking DependenceCheck the way any other pass would:
+//
+//  opt -basicaa -load DependenceCheck.so -depcheck-lazy -depcheck-query \
+//      -disable-output <file.bc>
+//
+// With -depcheck-query-invalidate=<function> the listed functions are
+// invalidated after the queries, as a transform that changed them would do,
+// and every function is queried again.
+
+#include "DependenceCheck.h"
+
+#include "llvm/Pass.h"
+#include "llvm/IR/Module.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+static cl::list<std::string> InvalidateFunctions("depcheck-query-invalidate",
+    cl::desc("Invalidate the function after the queries and query again"),
+    cl::value_desc("function"));
+
+namespace {
+  struct DependenceQuery : public ModulePass {
+    static char ID; // pass ID
+
+    DependenceQuery() : ModulePass(ID) { }
+
+    virtual bool runOnModule(Module &M);
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+
+    // Writes the answers of the queries about the instructions of F to OS
+    void queryFunction(DependenceCheck &DC, Function &F, raw_ostream &OS);
+  };
+
+  bool DependenceQuery::runOnModule(Module &M) {
+    DependenceCheck &DC = getAnalysis<DependenceCheck>();
+
+    for (auto mi = M.begin(), me = M.end(); mi != me; ++mi) {
+      if (!mi->isDeclaration())
+        queryFunction(DC, *mi, outs());
+    }
+
+    if (InvalidateFunctions.empty())
+      return false;
+
+    for (auto i = InvalidateFunctions.begin(), e = InvalidateFunctions.end();
+        i != e; ++i) {
+      Function *F = M.getFunction(*i);
+      if (F == NULL || F->isDeclaration()) {
+        errs() << "[Warning] -depcheck-query-invalidate: unknown function "
+               << *i << '\n';
+        continue;
+      }
+      DC.invalidate(*F);
+    }
+
+    for (auto mi = M.begin(), me = M.end(); mi != me; ++mi) {
+      if (!mi->isDeclaration())
+        queryFunction(DC, *mi, outs());
+    }
+
+    // Nothing modified in IR
+    return false;
+  }
+
+  void DependenceQuery::queryFunction(DependenceCheck &DC, Function &F,
+      raw_ostream &OS) {
+    OS << "Function " << F.getName() << '\n';
+    for (auto bi = F.begin(), be = F.end(); bi != be; ++bi) {
+      for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii) {
+        if (!ii->mayReadOrWriteMemory())
+          continue;
+
+        ArrayRef<DataDependence::NonLocalDep> nonLocal;
+        const DataDependence::DepInfo *local =
+          DC.getDependencies(&*ii, nonLocal);
+        OS << "Instruction: " << *ii << "\n    local "
+           << (local ? DataDependence::depTypeToString(local->Type_) : "none")
+           << ", non-local " << nonLocal.size() << "\n    controllers:";
+
+        SmallVector<BasicBlock *, 4> ctrls;
+        DC.getControllers(&*bi, ctrls);
+        for (auto ci = ctrls.begin(), ce = ctrls.end(); ci != ce; ++ci)
+          OS << ' ' << (*ci)->getName();
+        OS << '\n';
+      }
+    }
+  }
+
+  void DependenceQuery::getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.addRequired<DependenceCheck>();
+    AU.setPreservesAll();
+  }
+} // end namespace
+
+char DependenceQuery::ID = 0;
+static RegisterPass<DependenceQuery> X("depcheck-query",
+    "answer dependence queries through the DependenceCheck API",
+    true, /* does not modify CFG */
+    true); /* analysis pass */
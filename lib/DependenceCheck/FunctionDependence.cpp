@@ -0,0 +1,134 @@
+// Author: Markus Kusano
+//
+// See FunctionDependence.h for more information
+
+#include "FunctionDependence.h"
+
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/Support/raw_ostream.h"
+
+char FunctionDependence::ID = 0;
+static RegisterPass<FunctionDependence> X("function-deps",
+    "data and control dependencies of a function for other passes",
+    true, /* does not modify CFG */
+    true); /* analysis pass */
+
+FunctionDependence::FunctionDependence() : FunctionPass(ID), F_(NULL) {
+  initializeMemoryDependenceAnalysisPass(*PassRegistry::getPassRegistry());
+}
+
+void FunctionDependence::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<AliasAnalysis>();
+  AU.addRequired<MemoryDependenceAnalysis>();
+  AU.addRequired<PostDominatorTree>();
+  AU.setPreservesAll();
+}
+
+bool FunctionDependence::runOnFunction(Function &F) {
+  releaseMemory();
+  F_ = &F;
+  applyAnalysisOptions(DataDep_, ControlDep_);
+
+  DataDep_.getDataDependencies(F, getAnalysis<MemoryDependenceAnalysis>(),
+      getAnalysis<AliasAnalysis>(),
+      getAnalysisIfAvailable<TargetLibraryInfo>());
+  ControlDep_.getControlDependencies(F, getAnalysis<PostDominatorTree>());
+
+  // Nothing modified in IR
+  return false;
+}
+
+void FunctionDependence::releaseMemory() {
+  // Frees the results of F_; invalidate() erases them, so nothing of their
+  // storage is kept for the next function
+  Slicer_.reset();
+  if (F_ != NULL) {
+    DataDep_.invalidate(F_);
+    ControlDep_.invalidate(F_);
+    F_ = NULL;
+  }
+}
+
+void FunctionDependence::print(raw_ostream &OS, const Module *M) const {
+  if (F_ == NULL)
+    return;
+
+  const DataDependence::FunctionDeps &FD = getDataDeps();
+  const CompactCDG &cdg = getCDG();
+  OS << "Function " << F_->getName() << ": " << FD.size()
+     << " instructions, " << FD.NumLocal_ << " with local and "
+     << FD.NumNonLocal_ << " with non-local dependencies, "
+     << cdg.numEdges() << " control dependencies in " << cdg.numRegions()
+     << " regions\n";
+}
+
+Function &FunctionDependence::getFunction() const {
+  assert(F_ && "no function has been analyzed");
+  return *F_;
+}
+
+const DataDependence::FunctionDeps &FunctionDependence::getDataDeps() const {
+  const DataDependence::FunctionDeps *FD = DataDep_.getFunctionDeps(F_);
+  assert(FD && "no function has been analyzed");
+  return *FD;
+}
+
+const CompactCDG &FunctionDependence::getCDG() const {
+  const CompactCDG *cdg = ControlDep_.getCompactCDG(F_);
+  assert(cdg && "no function has been analyzed");
+  return *cdg;
+}
+
+const DataDependence::DepInfo *
+FunctionDependence::getLocalDep(const Instruction *I) const {
+  return DataDep_.getLocalDep(I);
+}
+
+ArrayRef<DataDependence::NonLocalDep>
+FunctionDependence::getNonLocalDeps(const Instruction *I) const {
+  return DataDep_.getNonLocalDeps(I);
+}
+
+void FunctionDependence::getControlDependents(const BasicBlock *BB,
+    SmallVectorImpl<BasicBlock *> &Deps) const {
+  const CompactCDG &cdg = getCDG();
+  unsigned id;
+  if (!cdg.getId(BB, id))
+    return;
+
+  SmallVector<unsigned, 16> deps;
+  cdg.dependents(id, deps);
+  for (auto i = deps.begin(), e = deps.end(); i != e; ++i)
+    Deps.push_back(cdg.getBlock(*i));
+}
+
+void FunctionDependence::getControllers(const BasicBlock *BB,
+    SmallVectorImpl<BasicBlock *> &Controllers) const {
+  const CompactCDG &cdg = getCDG();
+  unsigned id;
+  if (!cdg.getId(BB, id))
+    return;
+
+  ArrayRef<unsigned> ctrls = cdg.controllers(id);
+  for (auto i = ctrls.begin(), e = ctrls.end(); i != e; ++i)
+    Controllers.push_back(cdg.getBlock(*i));
+}
+
+void FunctionDependence::getControllingBranches(const Instruction *I,
+    SmallVectorImpl<TerminatorInst *> &Branches,
+    SmallVectorImpl<unsigned> &Indices) const {
+  const CompactCDG &cdg = getCDG();
+  ArrayRef<CDEdge> edges = cdg.controllingEdges(I);
+  for (auto i = edges.begin(), e = edges.end(); i != e; ++i) {
+    Branches.push_back(cdg.getTerminator(*i));
+    Indices.push_back(i->Index);
+  }
+}
+
+Slicer &FunctionDependence::getSlicer() {
+  if (!Slicer_)
+    Slicer_.reset(new Slicer(getDataDeps(), getCDG()));
+  return *Slicer_;
+}
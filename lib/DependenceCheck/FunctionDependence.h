@@ -0,0 +1,100 @@
+// Author: Markus Kusano
+//
+// Function pass holding the data and control dependencies of one function
+// for other passes.
+//
+// Module passes can query DependenceCheck directly (see DependenceCheck.h).
+// Passes that need the dependencies of the function they are working on,
+// kept up to date by the pass manager, require this analysis instead:
+//
+//  void getAnalysisUsage(AnalysisUsage &AU) const {
+//    AU.addRequired<FunctionDependence>();
+//    AU.addPreserved<FunctionDependence>(); // if the pass changes nothing
+//  }
+//
+//  bool runOnFunction(Function &F) {
+//    FunctionDependence &FDep = getAnalysis<FunctionDependence>();
+//    const DataDependence::DepInfo *D = FDep.getLocalDep(I);
+//    ...
+//  }
+//
+// Module passes use getAnalysis<FunctionDependence>(F). The pass manager
+// keeps the result while the passes it is scheduled with preserve it and
+// recalculates it after a pass that does not.
+//
+// The results are calculated with the -depcheck-cd-engine,
+// -depcheck-local-engine and budget options of DependenceCheck. Mod/ref
+// summaries need the whole module and are not used.
+
+#ifndef FUNCTION_DEPENDENCE_H
+#define FUNCTION_DEPENDENCE_H
+
+#include "ControlDependence.h"
+#include "DataDependence.h"
+#include "Slicer.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Pass.h"
+
+#include <memory>
+
+using namespace llvm;
+
+// Sets DataDep and ControlDep up with the -depcheck options that select the
+// engines and budgets (defined in DependenceCheck.cpp)
+void applyAnalysisOptions(DataDependence &DataDep,
+    ControlDependence &ControlDep);
+
+class FunctionDependence : public FunctionPass {
+  public:
+    static char ID; // pass ID
+
+    FunctionDependence();
+
+    virtual bool runOnFunction(Function &F);
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+    virtual void releaseMemory();
+    virtual void print(raw_ostream &OS, const Module *M = 0) const;
+
+    // The function analyzed by the last runOnFunction()
+    Function &getFunction() const;
+
+    // The results of getFunction(). Blocks and instructions are dense IDs
+    // (see DataDependence::FunctionDeps and CompactCDG).
+    const DataDependence::FunctionDeps &getDataDeps() const;
+    const CompactCDG &getCDG() const;
+
+    // Returns the local dependence of I, or NULL if I has none
+    const DataDependence::DepInfo *getLocalDep(const Instruction *I) const;
+
+    // Returns the non-local results of I
+    ArrayRef<DataDependence::NonLocalDep>
+    getNonLocalDeps(const Instruction *I) const;
+
+    // Appends the blocks control dependent on BB to Deps
+    void getControlDependents(const BasicBlock *BB,
+        SmallVectorImpl<BasicBlock *> &Deps) const;
+
+    // Appends the blocks BB is control dependent on to Controllers
+    void getControllers(const BasicBlock *BB,
+        SmallVectorImpl<BasicBlock *> &Controllers) const;
+
+    // Appends the terminators controlling I to Branches and, in parallel,
+    // the successor index of each through which I is reached to Indices
+    void getControllingBranches(const Instruction *I,
+        SmallVectorImpl<TerminatorInst *> &Branches,
+        SmallVectorImpl<unsigned> &Indices) const;
+
+    // Slicer of getFunction(), built on first use and kept until the
+    // result is released
+    Slicer &getSlicer();
+
+  private:
+    Function *F_;
+    DataDependence DataDep_;
+    ControlDependence ControlDep_;
+    std::unique_ptr<Slicer> Slicer_;
+};
+
+#endif // FUNCTION_DEPENDENCE_H
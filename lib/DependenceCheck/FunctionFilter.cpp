@@ -0,0 +1,171 @@
+// Author: Markus Kusano
+//
+// See FunctionFilter.h for more information
+
+#include "FunctionFilter.h"
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+
+#include <algorithm>
+#include <stdint.h>
+
+FunctionFilter::FunctionFilter() { }
+
+void FunctionFilter::setEntries(ArrayRef<std::string> Names) {
+  entries_.assign(Names.begin(), Names.end());
+}
+
+void FunctionFilter::setAllowed(ArrayRef<std::string> Names) {
+  allowed_.clear();
+  for (auto i = Names.begin(), e = Names.end(); i != e; ++i)
+    allowed_.insert(*i);
+}
+
+void FunctionFilter::setDenied(ArrayRef<std::string> Names) {
+  denied_.clear();
+  for (auto i = Names.begin(), e = Names.end(); i != e; ++i)
+    denied_.insert(*i);
+}
+
+bool FunctionFilter::readOrder(const std::string &Path) {
+  OwningPtr<MemoryBuffer> buf;
+  if (error_code ec = MemoryBuffer::getFile(StringRef(Path), buf)) {
+    errs() << "[Warning] Error reading function order file " << Path << ": "
+           << ec.message() << '\n';
+    return false;
+  }
+
+  // (count, name) of each line
+  std::vector<std::pair<uint64_t, StringRef> > lines;
+  bool counts = false;
+  SmallVector<StringRef, 64> text;
+  buf->getBuffer().split(text, "\n", -1, false);
+  for (auto i = text.begin(), e = text.end(); i != e; ++i) {
+    StringRef line = i->trim();
+    if (line.empty() || line[0] == '#')
+      continue;
+
+    std::pair<StringRef, StringRef> parts = line.split(' ');
+    StringRef countText = parts.second.trim();
+    uint64_t count = 0;
+    if (!countText.empty()) {
+      if (countText.getAsInteger(10, count)) {
+        errs() << "[Warning] Invalid count in function order file: " << line
+               << '\n';
+        return false;
+      }
+      counts = true;
+    }
+    lines.push_back(std::make_pair(count, parts.first));
+  }
+
+  // Hottest first; functions without a count are the coldest
+  if (counts) {
+    std::stable_sort(lines.begin(), lines.end(),
+        [](const std::pair<uint64_t, StringRef> &A,
+           const std::pair<uint64_t, StringRef> &B) {
+          return A.first > B.first;
+        });
+  }
+
+  rank_.clear();
+  for (auto i = lines.begin(), e = lines.end(); i != e; ++i) {
+    if (rank_.count(i->second))
+      continue;
+    unsigned rank = rank_.size();
+    rank_[i->second] = rank;
+  }
+  return true;
+}
+
+bool FunctionFilter::needsCallGraph() const {
+  return !entries_.empty();
+}
+
+void FunctionFilter::findReachable(Module &M, CallGraph &CG,
+    SmallPtrSet<const Function *, 64> &Reachable) const {
+  SmallVector<CallGraphNode *, 64> work;
+  SmallPtrSet<CallGraphNode *, 64> seen;
+  for (auto i = entries_.begin(), e = entries_.end(); i != e; ++i) {
+    Function *F = M.getFunction(*i);
+    if (F == NULL) {
+      errs() << "[Warning] Entry function not found: " << *i << '\n';
+      continue;
+    }
+    CallGraphNode *N = CG[F];
+    if (seen.insert(N))
+      work.push_back(N);
+  }
+
+  // Functions whose address is taken are only added once an indirect call
+  // or a call out of the module is reachable
+  bool escaped = false;
+  while (!work.empty()) {
+    CallGraphNode *N = work.pop_back_val();
+    Function *F = N->getFunction();
+
+    // The node calling every function through a pointer (or a declaration,
+    // which calls it)
+    if (F == NULL || F->isDeclaration()) {
+      if (!escaped && (F == NULL || !F->isIntrinsic())) {
+        escaped = true;
+        for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
+          if (!fi->isDeclaration() && fi->hasAddressTaken()) {
+            CallGraphNode *AN = CG[&*fi];
+            if (seen.insert(AN))
+              work.push_back(AN);
+          }
+        }
+      }
+      if (F == NULL)
+        continue;
+    }
+    else {
+      Reachable.insert(F);
+    }
+
+    for (auto ci = N->begin(), ce = N->end(); ci != ce; ++ci) {
+      if (seen.insert(ci->second))
+        work.push_back(ci->second);
+    }
+  }
+}
+
+void FunctionFilter::select(Module &M, CallGraph *CG,
+    std::vector<Function *> &Funcs) const {
+  SmallPtrSet<const Function *, 64> reachable;
+  if (needsCallGraph()) {
+    assert(CG && "entry points need the call graph");
+    findReachable(M, *CG, reachable);
+  }
+
+  unsigned first = Funcs.size();
+  for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
+    // skip external functions
+    if (fi->isDeclaration())
+      continue;
+
+    StringRef name = fi->getName();
+    if ((!allowed_.empty() && !allowed_.count(name)) || denied_.count(name)
+        || (needsCallGraph() && !reachable.count(&*fi)))
+      continue;
+    Funcs.push_back(&*fi);
+  }
+
+  if (rank_.empty())
+    return;
+
+  // Ranked functions first, the others keep their module order
+  std::stable_sort(Funcs.begin() + first, Funcs.end(),
+      [&](const Function *A, const Function *B) {
+        auto ra = rank_.find(A->getName());
+        auto rb = rank_.find(B->getName());
+        if (rb == rank_.end())
+          return ra != rank_.end();
+        return ra != rank_.end() && ra->second < rb->second;
+      });
+}
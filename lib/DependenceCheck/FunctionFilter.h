@@ -0,0 +1,71 @@
+// Author: Markus Kusano
+//
+// Selects and orders the functions DependenceCheck analyzes when it runs
+// over the whole module.
+//
+//  - Entries: only functions reachable in the call graph from these.
+//    Indirect calls, and calls to declarations (which may call back into
+//    the module), can reach every function whose address is taken.
+//  - Allowed: only these functions (if not empty)
+//  - Denied: never these functions
+//  - Order: the functions named in an order file come first, in the order
+//    of the file, followed by the others in module order. A line of the
+//    file is a function name, optionally followed by an execution count
+//    (e.g., from a profile); if any line has a count the names are sorted
+//    by decreasing count. Empty lines and lines starting with '#' are
+//    skipped.
+//
+//  FunctionFilter Filter;
+//  Filter.setEntries(Entries);
+//  Filter.readOrder("hot.txt");
+//  std::vector<Function *> funcs;
+//  Filter.select(M, &getAnalysis<CallGraph>(), funcs);
+
+#ifndef FUNCTION_FILTER_H
+#define FUNCTION_FILTER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/IR/Module.h"
+
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+class FunctionFilter {
+  public:
+    FunctionFilter();
+
+    void setEntries(ArrayRef<std::string> Names);
+    void setAllowed(ArrayRef<std::string> Names);
+    void setDenied(ArrayRef<std::string> Names);
+
+    // Reads the order file at Path (see file comment). Returns false (after
+    // printing a warning) if it cannot be read.
+    bool readOrder(const std::string &Path);
+
+    // Returns true if select() needs the call graph
+    bool needsCallGraph() const;
+
+    // Appends the selected defined functions of M to Funcs, in the order
+    // they should be analyzed. CG may only be NULL if !needsCallGraph().
+    void select(Module &M, CallGraph *CG, std::vector<Function *> &Funcs) const;
+
+  private:
+    std::vector<std::string> entries_;
+    StringSet<> allowed_;
+    StringSet<> denied_;
+
+    // Function name -> position in the order file
+    StringMap<unsigned> rank_;
+
+    // Adds the defined functions reachable from the entries to Reachable
+    void findReachable(Module &M, CallGraph &CG,
+        SmallPtrSet<const Function *, 64> &Reachable) const;
+};
+
+#endif // FUNCTION_FILTER_H
@@ -0,0 +1,286 @@
+// Author: Markus Kusano
+//
+// See FunctionHash.h for more information
+
+#include "FunctionHash.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalAlias.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Metadata.h"
+
+namespace {
+  class FunctionHasher {
+    public:
+      explicit FunctionHasher(const Function &F) : F_(F) { }
+
+      StableDigest run();
+
+    private:
+      const Function &F_;
+      StableHasher H_;
+
+      // Position IDs of the blocks and instructions of F_
+      DenseMap<const Value *, unsigned> ids_;
+
+      // Each of these adds its value to H_, starting with a kind that tells
+      // apart the different encodings of the same value class
+      void hashType(Type *T, unsigned Depth = 0);
+      void hashValue(const Value *V, unsigned Depth = 0);
+      void hashMetadata(const MDNode *N, unsigned Depth = 0);
+      void hashInstruction(const Instruction &I);
+      void hashGlobal(const GlobalValue *GV, unsigned Depth);
+      void hashInt(const APInt &V);
+
+      // Adds the function, return and first NumArgs parameter attributes
+      void hashAttributes(const AttributeSet &A, unsigned NumArgs);
+  };
+} // end namespace
+
+// Limit for the recursion into types, constants and metadata. Anything
+// nested deeper only contributes its kind.
+static const unsigned MaxDepth = 8;
+
+// Kinds of the encodings of values
+enum ValueKind {
+  LocalValue = 0,
+  ArgumentValue = 1,
+  GlobalValueKind = 2,
+  IntValue = 3,
+  FPValue = 4,
+  DataValue = 5,
+  OtherValue = 6
+};
+
+// Kinds of metadata operands
+enum MetadataKind {
+  NullOperand = 0,
+  StringOperand = 1,
+  NodeOperand = 2,
+  ValueOperand = 3
+};
+
+void FunctionHasher::hashAttributes(const AttributeSet &A, unsigned NumArgs) {
+  H_.add(A.getAsString(AttributeSet::FunctionIndex));
+  H_.add(A.getAsString(AttributeSet::ReturnIndex));
+  H_.add(NumArgs);
+  for (unsigned i = 1; i <= NumArgs; ++i)
+    H_.add(A.getAsString(i));
+}
+
+void FunctionHasher::hashInt(const APInt &V) {
+  H_.add(V.getBitWidth());
+  for (unsigned i = 0; i < V.getNumWords(); ++i)
+    H_.add(V.getRawData()[i]);
+}
+
+void FunctionHasher::hashType(Type *T, unsigned Depth) {
+  H_.add(T->getTypeID());
+  H_.add(T->getNumContainedTypes());
+  if (IntegerType *IT = dyn_cast<IntegerType>(T))
+    H_.add(IT->getBitWidth());
+  else if (PointerType *PT = dyn_cast<PointerType>(T))
+    H_.add(PT->getAddressSpace());
+  else if (ArrayType *AT = dyn_cast<ArrayType>(T))
+    H_.add(AT->getNumElements());
+  else if (VectorType *VT = dyn_cast<VectorType>(T))
+    H_.add(VT->getNumElements());
+  else if (StructType *ST = dyn_cast<StructType>(T)) {
+    // Named structs are identified by name, which also stops recursive types
+    H_.add(ST->hasName());
+    if (ST->hasName()) {
+      H_.add(ST->getName());
+      return;
+    }
+    H_.add(ST->isPacked());
+  }
+
+  if (Depth >= MaxDepth)
+    return;
+  for (unsigned i = 0; i < T->getNumContainedTypes(); ++i)
+    hashType(T->getContainedType(i), Depth + 1);
+}
+
+void FunctionHasher::hashValue(const Value *V, unsigned Depth) {
+  H_.add(V->getValueID());
+  hashType(V->getType());
+
+  // Values of this function are identified by their position
+  auto it = ids_.find(V);
+  if (it != ids_.end()) {
+    H_.add(LocalValue);
+    H_.add(it->second);
+    return;
+  }
+  if (const Argument *A = dyn_cast<Argument>(V)) {
+    H_.add(ArgumentValue);
+    H_.add(A->getArgNo());
+    return;
+  }
+
+  if (const GlobalValue *GV = dyn_cast<GlobalValue>(V)) {
+    H_.add(GlobalValueKind);
+    hashGlobal(GV, Depth);
+    return;
+  }
+
+  if (const ConstantInt *CI = dyn_cast<ConstantInt>(V)) {
+    H_.add(IntValue);
+    hashInt(CI->getValue());
+    return;
+  }
+  if (const ConstantFP *CF = dyn_cast<ConstantFP>(V)) {
+    H_.add(FPValue);
+    hashInt(CF->getValueAPF().bitcastToAPInt());
+    return;
+  }
+  if (const ConstantDataSequential *CD = dyn_cast<ConstantDataSequential>(V)) {
+    H_.add(DataValue);
+    H_.add(CD->getRawDataValues());
+    return;
+  }
+
+  // Other constants (aggregates, expressions, ...) by their operands
+  H_.add(OtherValue);
+  if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(V))
+    H_.add(CE->getOpcode());
+  if (const User *U = dyn_cast<User>(V)) {
+    H_.add(U->getNumOperands());
+    if (Depth >= MaxDepth)
+      return;
+    for (unsigned i = 0; i < U->getNumOperands(); ++i)
+      hashValue(U->getOperand(i), Depth + 1);
+  }
+}
+
+void FunctionHasher::hashGlobal(const GlobalValue *GV, unsigned Depth) {
+  // Globals by name, with the properties alias analysis uses: the
+  // attributes of functions (e.g., readonly callees and noalias results),
+  // the constness of variables (pointsToConstantMemory()) and the linkage
+  H_.add(GV->getName());
+  H_.add(GV->getLinkage());
+  if (const GlobalVariable *GVar = dyn_cast<GlobalVariable>(GV)) {
+    H_.add(GVar->isConstant());
+    H_.add(GVar->isThreadLocal());
+  }
+  else if (const Function *Callee = dyn_cast<Function>(GV)) {
+    hashAttributes(Callee->getAttributes(), Callee->arg_size());
+  }
+  else if (const GlobalAlias *GA = dyn_cast<GlobalAlias>(GV)) {
+    if (Depth < MaxDepth)
+      hashValue(GA->getAliasee(), Depth + 1);
+  }
+}
+
+void FunctionHasher::hashMetadata(const MDNode *N, unsigned Depth) {
+  H_.add(N->getNumOperands());
+  if (Depth >= MaxDepth)
+    return;
+  for (unsigned i = 0; i < N->getNumOperands(); ++i) {
+    const Value *op = N->getOperand(i);
+    if (op == NULL) {
+      H_.add(NullOperand);
+    }
+    else if (const MDString *S = dyn_cast<MDString>(op)) {
+      H_.add(StringOperand);
+      H_.add(S->getString());
+    }
+    else if (const MDNode *M = dyn_cast<MDNode>(op)) {
+      H_.add(NodeOperand);
+      hashMetadata(M, Depth + 1);
+    }
+    else {
+      H_.add(ValueOperand);
+      hashValue(op, Depth + 1);
+    }
+  }
+}
+
+void FunctionHasher::hashInstruction(const Instruction &I) {
+  H_.add(I.getOpcode());
+  hashType(I.getType());
+  H_.add(I.getNumOperands());
+  H_.add(I.getRawSubclassOptionalData());
+
+  for (unsigned i = 0; i < I.getNumOperands(); ++i)
+    hashValue(I.getOperand(i));
+
+  // Flags that are not operands
+  if (const LoadInst *LI = dyn_cast<LoadInst>(&I)) {
+    H_.add(LI->isVolatile());
+    H_.add(LI->getAlignment());
+    H_.add(LI->getOrdering());
+    H_.add(LI->getSynchScope());
+  }
+  else if (const StoreInst *SI = dyn_cast<StoreInst>(&I)) {
+    H_.add(SI->isVolatile());
+    H_.add(SI->getAlignment());
+    H_.add(SI->getOrdering());
+    H_.add(SI->getSynchScope());
+  }
+  else if (const CmpInst *CI = dyn_cast<CmpInst>(&I)) {
+    H_.add(CI->getPredicate());
+  }
+  else if (const CallInst *CI = dyn_cast<CallInst>(&I)) {
+    H_.add(CI->isTailCall());
+    H_.add(CI->getCallingConv());
+    hashAttributes(CI->getAttributes(), CI->getNumArgOperands());
+  }
+  else if (const AllocaInst *AI = dyn_cast<AllocaInst>(&I)) {
+    H_.add(AI->getAlignment());
+  }
+  else if (const AtomicRMWInst *RMW = dyn_cast<AtomicRMWInst>(&I)) {
+    H_.add(RMW->getOperation());
+    H_.add(RMW->isVolatile());
+    H_.add(RMW->getOrdering());
+  }
+  else if (const AtomicCmpXchgInst *CX = dyn_cast<AtomicCmpXchgInst>(&I)) {
+    H_.add(CX->isVolatile());
+    H_.add(CX->getOrdering());
+  }
+  else if (const FenceInst *FI = dyn_cast<FenceInst>(&I)) {
+    H_.add(FI->getOrdering());
+    H_.add(FI->getSynchScope());
+  }
+
+  // Attached metadata (TBAA tags change alias results)
+  SmallVector<std::pair<unsigned, MDNode *>, 4> MDs;
+  I.getAllMetadataOtherThanDebugLoc(MDs);
+  H_.add(MDs.size());
+  for (auto i = MDs.begin(), e = MDs.end(); i != e; ++i) {
+    H_.add(i->first);
+    hashMetadata(i->second);
+  }
+}
+
+StableDigest FunctionHasher::run() {
+  // Number the blocks and instructions first so forward references (e.g.,
+  // PHIs and branches) hash the same as backward ones
+  unsigned id = 0;
+  for (auto bi = F_.begin(), be = F_.end(); bi != be; ++bi) {
+    ids_[&*bi] = id++;
+    for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii)
+      ids_[&*ii] = id++;
+  }
+
+  hashType(F_.getFunctionType());
+  H_.add(F_.getCallingConv());
+  hashAttributes(F_.getAttributes(), F_.arg_size());
+
+  H_.add(F_.size());
+  for (auto bi = F_.begin(), be = F_.end(); bi != be; ++bi) {
+    H_.add(bi->size());
+    for (auto ii = bi->begin(), ie = bi->end(); ii != ie; ++ii)
+      hashInstruction(*ii);
+  }
+  return H_.finish();
+}
+
+StableDigest hashFunction(const Function &F) {
+  FunctionHasher H(F);
+  return H.run();
+}
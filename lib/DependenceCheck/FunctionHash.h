@@ -0,0 +1,31 @@
+// Author: Markus Kusano
+//
+// Structural hash of a function's IR.
+//
+// The hash covers everything in a function that can change its dependence
+// results: the blocks and their order, every instruction's opcode, type,
+// operands and flags (e.g., volatile, alignment, predicates), and the
+// metadata attached to instructions (e.g., TBAA tags). Operands are hashed by
+// their position (instruction and block IDs, argument numbers) or, for
+// globals, by name together with what alias analysis reads from them: the
+// linkage, the attributes of functions (so a callee marked readonly by
+// -functionattrs changes the hash of its callers) and the constness of
+// variables. Pointer values are never hashed and the hash is a StableDigest
+// (see StableHash.h), so the hash of an unchanged function is the same in
+// every run and can be stored.
+//
+// The function's name is not part of the hash; its attributes, including
+// those of its parameters (e.g., noalias), are.
+
+#ifndef FUNCTION_HASH_H
+#define FUNCTION_HASH_H
+
+#include "StableHash.h"
+
+#include "llvm/IR/Function.h"
+
+using namespace llvm;
+
+StableDigest hashFunction(const Function &F);
+
+#endif // FUNCTION_HASH_H
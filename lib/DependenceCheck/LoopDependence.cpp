@@ -0,0 +1,464 @@
+// Author: Markus Kusano
+//
+// See LoopDependence.h for more information
+
+#define DEBUG_TYPE "depcheck"
+#include "LoopDependence.h"
+#include "DepTimers.h"
+
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/ErrorHandling.h"
+
+#include <algorithm>
+#include <map>
+
+STATISTIC(NumLoopPairs, "Number of dependence pairs inside loops");
+STATISTIC(NumIndependentPairs, "Number of loop pairs found independent");
+STATISTIC(NumCarriedPairs, "Number of loop-carried dependence pairs");
+STATISTIC(NumUnknownPairs, "Number of loop pairs that were not analyzed");
+
+// Steps, offsets and trip counts are kept well below the range of int64_t
+// so the products below cannot overflow
+static const int64_t MaxMagnitude = INT64_C(1) << 48;
+static const int64_t MaxSpan = INT64_C(1) << 62;
+
+namespace {
+  // A pointer written as Base + the sum of Steps[l] * (iteration of l) over
+  // the loops l around the access
+  struct Access {
+    Access() : Valid(false), Base(NULL), Size(0) { }
+
+    bool Valid;
+    const SCEV *Base;
+    int64_t Size;
+    SmallVector<std::pair<const Loop *, int64_t>, 2> Steps;
+
+    int64_t stepFor(const Loop *L) const {
+      for (auto i = Steps.begin(), e = Steps.end(); i != e; ++i) {
+        if (i->first == L)
+          return i->second;
+      }
+      return 0;
+    }
+  };
+}
+
+// Returns the value of S if it is a constant of at most MaxMagnitude
+static bool getSmallConstant(const SCEV *S, int64_t &Value) {
+  const SCEVConstant *C = dyn_cast<SCEVConstant>(S);
+  if (C == NULL || C->getValue()->getValue().getMinSignedBits() > 64)
+    return false;
+  Value = C->getValue()->getSExtValue();
+  return Value < MaxMagnitude && Value > -MaxMagnitude;
+}
+
+// Returns the largest number of times the back edge of L is taken, or -1 if
+// it is not known
+static int64_t maxBackedges(ScalarEvolution &SE, const Loop *L) {
+  int64_t n;
+  if (!getSmallConstant(SE.getMaxBackedgeTakenCount(L), n) || n < 0)
+    return -1;
+  return n;
+}
+
+static int64_t absolute(int64_t X) {
+  return X < 0 ? -X : X;
+}
+
+static int64_t gcd(int64_t A, int64_t B) {
+  while (B != 0) {
+    int64_t t = A % B;
+    A = B;
+    B = t;
+  }
+  return absolute(A);
+}
+
+// A / B rounded to the nearest integer
+static int64_t roundDiv(int64_t A, int64_t B) {
+  int64_t q = A / B;
+  int64_t r = A - q * B;
+  if (2 * absolute(r) > absolute(B))
+    q += ((r < 0) != (B < 0)) ? -1 : 1;
+  return q;
+}
+
+// Computes the Access of the load or store I. Returns false if I is not a
+// simple load or store or its pointer is not affine in the loops around it.
+static bool getAccess(Instruction *I, LoopInfo &LI, ScalarEvolution &SE,
+    const DataLayout *TD, Access &A) {
+  Value *ptr;
+  Type *ty;
+  if (LoadInst *LD = dyn_cast<LoadInst>(I)) {
+    if (!LD->isUnordered())
+      return false;
+    ptr = LD->getPointerOperand();
+    ty = LD->getType();
+  }
+  else if (StoreInst *ST = dyn_cast<StoreInst>(I)) {
+    if (!ST->isUnordered())
+      return false;
+    ptr = ST->getPointerOperand();
+    ty = ST->getValueOperand()->getType();
+  }
+  else {
+    return false;
+  }
+
+  const Loop *L = LI.getLoopFor(I->getParent());
+  if (TD == NULL || L == NULL || !SE.isSCEVable(ptr->getType()))
+    return false;
+  A.Size = TD->getTypeStoreSize(ty);
+
+  const SCEV *S = SE.getSCEV(ptr);
+  while (const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(S)) {
+    int64_t step;
+    if (!AR->isAffine() || !AR->getLoop()->contains(I->getParent())
+        || !getSmallConstant(AR->getStepRecurrence(SE), step))
+      return false;
+    A.Steps.push_back(std::make_pair(AR->getLoop(), step));
+    S = AR->getStart();
+  }
+
+  // The base must be the same in every iteration of the whole nest
+  while (L->getParentLoop())
+    L = L->getParentLoop();
+  if (!SE.isLoopInvariant(S, L))
+    return false;
+
+  A.Base = S;
+  A.Valid = true;
+  return true;
+}
+
+// Fills the kind, directions and distances of P, the dependence of the sink
+// Snk on the source Src inside the loops Common (outermost first)
+static void classify(const Access &Src, const Access &Snk,
+    ArrayRef<const Loop *> Common, ScalarEvolution &SE,
+    LoopDependence::Pair &P) {
+  unsigned n = Common.size();
+  P.Directions.assign(n, LoopDependence::All);
+  P.Distances.assign(n, 0);
+  P.K = LoopDependence::Unknown;
+
+  if (!Src.Valid || !Snk.Valid || Src.Size != Snk.Size || Src.Size == 0)
+    return;
+  int64_t size = Src.Size;
+
+  // A step in a loop around only one of the accesses leaves its iteration
+  // free
+  const Access *both[] = { &Src, &Snk };
+  for (unsigned a = 0; a < 2; ++a) {
+    for (auto i = both[a]->Steps.begin(), e = both[a]->Steps.end(); i != e;
+        ++i) {
+      if (i->second != 0
+          && std::find(Common.begin(), Common.end(), i->first) == Common.end())
+        return;
+    }
+  }
+
+  // Both accesses must move the same way. If the offset and the steps are
+  // multiples of the size the accesses overlap iff they are equal.
+  int64_t rem;
+  if (!getSmallConstant(SE.getMinusSCEV(Src.Base, Snk.Base), rem)
+      || rem % size != 0)
+    return;
+  rem /= size;
+
+  SmallVector<int64_t, 4> steps(n);
+  SmallVector<int64_t, 4> trips(n);
+  SmallVector<unsigned, 4> order;
+  for (unsigned l = 0; l < n; ++l) {
+    int64_t s = Src.stepFor(Common[l]);
+    if (s != Snk.stepFor(Common[l]) || s % size != 0)
+      return;
+    steps[l] = s / size;
+    trips[l] = maxBackedges(SE, Common[l]);
+    if (steps[l] != 0)
+      order.push_back(l);
+  }
+
+  // Loops with a zero step keep the direction All: the same memory is
+  // accessed in every iteration. The others are solved from the largest
+  // step down.
+  std::stable_sort(order.begin(), order.end(),
+      [&](unsigned A, unsigned B) {
+        return absolute(steps[A]) > absolute(steps[B]);
+      });
+
+  unsigned resolved = 0;
+  for (; resolved < order.size(); ++resolved) {
+    unsigned l = order[resolved];
+
+    // Reach of the loops with smaller steps
+    int64_t span = 0;
+    bool bounded = true;
+    for (unsigned k = resolved + 1; k < order.size() && bounded; ++k) {
+      int64_t t = trips[order[k]];
+      int64_t s = absolute(steps[order[k]]);
+      if (t < 0 || t > (MaxSpan - span) / s)
+        bounded = false;
+      else
+        span += s * t;
+    }
+    if (!bounded || 2 * span >= absolute(steps[l]))
+      break;
+
+    // The only distance the smaller steps can make up for
+    int64_t d = roundDiv(rem, steps[l]);
+    if (absolute(rem - d * steps[l]) > span
+        || (trips[l] >= 0 && absolute(d) > trips[l])) {
+      P.K = LoopDependence::Independent;
+      return;
+    }
+
+    P.Distances[l] = d;
+    P.Directions[l] = d > 0 ? LoopDependence::Less
+      : (d == 0 ? LoopDependence::Equal : LoopDependence::Greater);
+    rem -= d * steps[l];
+  }
+
+  if (resolved == order.size()) {
+    if (rem != 0) {
+      P.K = LoopDependence::Independent;
+      return;
+    }
+  }
+  else {
+    int64_t g = 0;
+    for (unsigned k = resolved; k < order.size(); ++k)
+      g = gcd(g, steps[order[k]]);
+    if (rem % g != 0) {
+      P.K = LoopDependence::Independent;
+      return;
+    }
+  }
+
+  P.K = LoopDependence::LoopIndependent;
+  for (unsigned l = 0; l < n; ++l) {
+    if (P.Directions[l] != LoopDependence::Equal)
+      P.K = LoopDependence::Carried;
+  }
+}
+
+unsigned LoopDependence::Pair::level() const {
+  for (unsigned l = 0; l < Directions.size(); ++l) {
+    if (Directions[l] != Equal)
+      return l + 1;
+  }
+  return 0;
+}
+
+LoopDependence::LoopDependence() { }
+
+void LoopDependence::analyze(const DataDependence::FunctionDeps &FD,
+    LoopInfo &LI, ScalarEvolution &SE, const DataLayout *TD) {
+  TimeRegion T(getPhaseTimer(PhaseLoopDependence));
+
+  nests_.clear();
+  nestOfBlock_.clear();
+
+  // One nest for every outermost loop, in the order of their headers
+  DenseMap<const Loop *, unsigned> nestIndex;
+  for (unsigned b = 0; b < FD.numBlocks(); ++b) {
+    BasicBlock *BB = FD.getBlock(b);
+    Loop *L = LI.getLoopFor(BB);
+    if (L == NULL)
+      continue;
+    while (L->getParentLoop())
+      L = L->getParentLoop();
+
+    auto it = nestIndex.find(L);
+    if (it == nestIndex.end()) {
+      it = nestIndex.insert(std::make_pair(L, unsigned(nests_.size()))).first;
+      nests_.push_back(Nest());
+      nests_.back().Header = L->getHeader();
+    }
+    nestOfBlock_[BB] = it->second;
+  }
+
+  // The memory instructions of every nest, in the order of their IDs
+  nestOfInst_.assign(FD.size(), NoNest);
+  std::vector<std::vector<unsigned> > nestAccesses(nests_.size());
+  for (unsigned i = 0; i < FD.size(); ++i) {
+    auto it = nestOfBlock_.find(FD.getInst(i)->getParent());
+    if (it == nestOfBlock_.end())
+      continue;
+    nestOfInst_[i] = it->second;
+    if (FD.getInst(i)->mayReadOrWriteMemory())
+      nestAccesses[it->second].push_back(i);
+  }
+
+  // Every access is decomposed once. References into the map stay valid
+  // while it grows.
+  std::map<unsigned, Access> accesses;
+  auto getCachedAccess = [&](unsigned Id) -> const Access & {
+    auto it = accesses.find(Id);
+    if (it == accesses.end()) {
+      Access A;
+      getAccess(FD.getInst(Id), LI, SE, TD, A);
+      it = accesses.insert(std::make_pair(Id, A)).first;
+    }
+    return it->second;
+  };
+
+  SmallVector<unsigned, 8> sources;
+  SmallVector<const Loop *, 4> common;
+  for (unsigned sink = 0; sink < FD.size(); ++sink) {
+    Instruction *I = FD.getInst(sink);
+    if (nestOfInst_[sink] == NoNest || !I->mayReadOrWriteMemory())
+      continue;
+
+    // The instructions I depends on, sorted. A result without an
+    // instruction other than NonFuncLocal (e.g., Unknown, or a query cut
+    // short by the budget) may be any instruction of the loop, so I is then
+    // paired with every access of its nest it could conflict with.
+    sources.clear();
+    bool unknown = false;
+    unsigned id;
+    const DataDependence::DepInfo &local = FD.getLocalDep(sink);
+    if (local.valid()) {
+      if (local.Type_ == DataDependence::Unknown)
+        unknown = true;
+      if (local.DepInst_ && FD.getId(local.DepInst_, id))
+        sources.push_back(id);
+      else if (local.Type_ != DataDependence::NonFuncLocal)
+        unknown = true;
+    }
+    ArrayRef<DataDependence::NonLocalDep> nonLocal = FD.getNonLocalDeps(sink);
+    for (auto i = nonLocal.begin(), e = nonLocal.end(); i != e; ++i) {
+      if (i->getType() == DataDependence::Unknown)
+        unknown = true;
+      if (i->hasDepInst())
+        sources.push_back(i->DepInst_);
+      else if (i->getType() != DataDependence::NonFuncLocal)
+        unknown = true;
+    }
+    if (unknown) {
+      const std::vector<unsigned> &nest = nestAccesses[nestOfInst_[sink]];
+      sources.append(nest.begin(), nest.end());
+    }
+    std::sort(sources.begin(), sources.end());
+    sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+
+    for (auto si = sources.begin(), sEnd = sources.end(); si != sEnd; ++si) {
+      Instruction *S = FD.getInst(*si);
+
+      // Two reads (e.g., must alias loads) do not order the iterations
+      if (!I->mayWriteToMemory() && !S->mayWriteToMemory())
+        continue;
+
+      // Innermost loop around both
+      const Loop *L = LI.getLoopFor(S->getParent());
+      while (L && !L->contains(I->getParent()))
+        L = L->getParentLoop();
+      if (L == NULL)
+        continue;
+
+      common.clear();
+      for (; L; L = L->getParentLoop())
+        common.push_back(L);
+      std::reverse(common.begin(), common.end());
+
+      Pair P;
+      P.Source = *si;
+      P.Sink = sink;
+      for (auto li = common.begin(), le = common.end(); li != le; ++li)
+        P.Loops.push_back((*li)->getHeader());
+      // Calls, memory intrinsics and atomics have no Access and are
+      // classified as Unknown with the direction All for every loop
+      classify(getCachedAccess(*si), getCachedAccess(sink), common, SE, P);
+
+      ++NumLoopPairs;
+      if (P.K == Independent)
+        ++NumIndependentPairs;
+      else if (P.K == Carried)
+        ++NumCarriedPairs;
+      else if (P.K == Unknown)
+        ++NumUnknownPairs;
+      nests_[nestOfInst_[sink]].Pairs.push_back(P);
+    }
+  }
+}
+
+unsigned LoopDependence::numNests() const {
+  return nests_.size();
+}
+
+const LoopDependence::Nest &LoopDependence::getNest(unsigned Index) const {
+  assert(Index < nests_.size() && "nest index out of range");
+  return nests_[Index];
+}
+
+const LoopDependence::Pair *LoopDependence::getPair(unsigned Sink,
+    unsigned Source) const {
+  if (Sink >= nestOfInst_.size() || nestOfInst_[Sink] == NoNest)
+    return NULL;
+
+  const std::vector<Pair> &pairs = nests_[nestOfInst_[Sink]].Pairs;
+  auto it = std::lower_bound(pairs.begin(), pairs.end(),
+      std::make_pair(Sink, Source),
+      [](const Pair &P, const std::pair<unsigned, unsigned> &K) {
+        return P.Sink < K.first || (P.Sink == K.first && P.Source < K.second);
+      });
+  if (it == pairs.end() || it->Sink != Sink || it->Source != Source)
+    return NULL;
+  return &*it;
+}
+
+bool LoopDependence::isParallel(const BasicBlock *Header) const {
+  auto nest = nestOfBlock_.find(Header);
+  if (nest == nestOfBlock_.end())
+    return true;
+
+  const std::vector<Pair> &pairs = nests_[nest->second].Pairs;
+  for (auto pi = pairs.begin(), pe = pairs.end(); pi != pe; ++pi) {
+    if (pi->K == Independent || pi->K == LoopIndependent)
+      continue;
+
+    unsigned l = std::find(pi->Loops.begin(), pi->Loops.end(), Header)
+      - pi->Loops.begin();
+    if (l == pi->Loops.size())
+      continue;
+
+    // Carried by an outer loop if an outer distance is surely not zero
+    bool outer = false;
+    for (unsigned k = 0; k < l; ++k) {
+      if (pi->Directions[k] == Less || pi->Directions[k] == Greater)
+        outer = true;
+    }
+    if (!outer && pi->Directions[l] != Equal)
+      return false;
+  }
+  return true;
+}
+
+const char *LoopDependence::kindToString(Kind K) {
+  switch (K) {
+    case Independent:
+      return "Independent";
+    case LoopIndependent:
+      return "LoopIndependent";
+    case Carried:
+      return "Carried";
+    case Unknown:
+      return "Unknown";
+  }
+  llvm_unreachable("unknown loop dependence kind");
+}
+
+char LoopDependence::directionToChar(Direction D) {
+  switch (D) {
+    case Less:
+      return '<';
+    case Equal:
+      return '=';
+    case Greater:
+      return '>';
+    case All:
+      return '*';
+  }
+  llvm_unreachable("unknown direction");
+}
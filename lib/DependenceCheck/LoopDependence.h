@@ -0,0 +1,149 @@
+// Author: Markus Kusano
+//
+// Loop-carried dependence distances and directions of the data
+// dependencies of a function.
+//
+// DataDependence reports that a load or store depends on another one, but
+// not in which iterations. For each such pair inside a common loop this
+// classifies the dependence as
+//
+//  - Independent: the two never access the same memory
+//  - LoopIndependent: only in the same iteration of every common loop
+//  - Carried: across iterations of at least one common loop
+//  - Unknown: the accesses could not be analyzed
+//
+// with a direction (and, where it is known, the distance) for every common
+// loop, outermost first. The distance of a loop is the iteration of the
+// dependent instruction (the sink) minus the iteration of the instruction
+// it depends on (the source).
+//
+// Every pointer is written with ScalarEvolution as a loop invariant base
+// plus a constant step for each loop of its nest. Two accesses of the same
+// size whose bases differ by a constant C then overlap iff
+//
+//  sum over the common loops l of step(l) * distance(l) = C
+//
+// which is solved one loop at a time, from the largest step to the
+// smallest, while the steps of the inner loops times their (constant) trip
+// counts cannot reach the step of the outer loop (e.g., A[i][j]). Loops
+// that cannot be separated this way get the direction All and are only used
+// for a GCD independence test.
+//
+// Only the pairs reported by DataDependence are classified, so isParallel()
+// is only as complete as those. Sinks and sources that are not simple loads
+// or stores (calls, memory intrinsics, atomics) give Unknown pairs. A sink
+// with a result that has no instruction (other than NonFuncLocal) may
+// depend on any access of the loop: it is paired with every access of its
+// nest that could conflict with it, i.e., every write, and every read too if
+// the sink writes. MemoryDependenceAnalysis gives such Unknown results for
+// most accesses whose address changes every iteration, since it cannot
+// translate the address around the back edge; queries cut short by the
+// budget give them as well. Pairs of two reads are dropped.
+//
+// The results are computed once per function (ScalarEvolution, LoopInfo and
+// the FunctionDeps are not kept) and stored per loop nest. Instructions are
+// the dense IDs of DataDependence::FunctionDeps.
+//
+//  LoopDependence LD;
+//  LD.analyze(*DataDep.getFunctionDeps(&F), LI, SE, TD);
+//  if (LD.isParallel(L->getHeader())) ...
+
+#ifndef LOOP_DEPENDENCE_H
+#define LOOP_DEPENDENCE_H
+
+#include "DataDependence.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/IR/DataLayout.h"
+
+#include <stdint.h>
+#include <vector>
+
+using namespace llvm;
+
+class LoopDependence {
+  public:
+    enum Kind {
+      Independent = 0,
+      LoopIndependent = 1,
+      Carried = 2,
+      Unknown = 3
+    };
+
+    // Direction of a dependence for one loop, in the usual notation: Less
+    // if the source runs in an earlier iteration than the sink (distance >
+    // 0), Equal for the same iteration, Greater if it runs in a later one
+    // (distance < 0), or All if it is not known
+    enum Direction {
+      Less = 0,
+      Equal = 1,
+      Greater = 2,
+      All = 3
+    };
+
+    // A dependence of Sink on Source (instruction IDs)
+    struct Pair {
+      unsigned Source;
+      unsigned Sink;
+      Kind K;
+
+      // Headers of the loops containing both instructions, outermost first,
+      // with the direction and distance for each. Distance is only
+      // meaningful if the direction is not All.
+      SmallVector<BasicBlock *, 2> Loops;
+      SmallVector<Direction, 2> Directions;
+      SmallVector<int64_t, 2> Distances;
+
+      // Depth (1 for the outermost loop) of the first loop whose direction
+      // is not Equal, or 0 if there is none
+      unsigned level() const;
+    };
+
+    // The pairs of one loop nest, sorted by Sink and Source
+    struct Nest {
+      BasicBlock *Header; // of the outermost loop
+      std::vector<Pair> Pairs;
+    };
+
+    LoopDependence();
+
+    // Classifies the pairs of FD inside loops. LI and SE must be the
+    // analyses of the function of FD; TD (may be NULL) gives the access
+    // sizes, without it every pair is Unknown.
+    void analyze(const DataDependence::FunctionDeps &FD, LoopInfo &LI,
+        ScalarEvolution &SE, const DataLayout *TD);
+
+    // Loop nests of the function, in the order of their headers
+    unsigned numNests() const;
+    const Nest &getNest(unsigned Index) const;
+
+    // Returns the dependence of Sink on Source, or NULL if the pair is not
+    // reported by DataDependence or not inside a common loop
+    const Pair *getPair(unsigned Sink, unsigned Source) const;
+
+    // Returns true if no pair inside the loop with the header Header may be
+    // carried by it, i.e., its iterations can run in parallel as far as the
+    // reported dependencies are concerned
+    bool isParallel(const BasicBlock *Header) const;
+
+    static const char *kindToString(Kind K);
+    static char directionToChar(Direction D);
+
+  private:
+    std::vector<Nest> nests_;
+
+    // Instruction ID -> index into nests_ of the outermost loop of its block,
+    // or NoNest. Copied so the results do not refer to the FunctionDeps,
+    // which move when other functions are analyzed or invalidated.
+    static const unsigned NoNest = ~0u;
+    std::vector<unsigned> nestOfInst_;
+
+    // Index into nests_ of the outermost loop of every block inside a loop
+    DenseMap<const BasicBlock *, unsigned> nestOfBlock_;
+};
+
+#endif // LOOP_DEPENDENCE_H
@@ -0,0 +1,368 @@
+// Author: Markus Kusano
+//
+// See ModRefSummary.h for more information
+
+#define DEBUG_TYPE "depcheck"
+#include "ModRefSummary.h"
+#include "WorkerPool.h"
+
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Support/Threading.h"
+
+#include <algorithm>
+
+STATISTIC(NumSummaries, "Number of functions with a mod/ref summary");
+STATISTIC(NumSummarySCCs, "Number of call graph SCCs summarized");
+STATISTIC(NumSummaryLevels, "Number of call graph levels summarized");
+STATISTIC(NumSummaryPasses, "Number of function passes to compute summaries");
+STATISTIC(NumUnknownSummaries,
+    "Number of summaries that may write any memory");
+
+ModRefSummaries::Summary::Summary() {
+  Unknown = None;
+  VarArgs = None;
+}
+
+bool ModRefSummaries::Summary::operator==(const Summary &Other) const {
+  return Unknown == Other.Unknown && VarArgs == Other.VarArgs
+    && Args == Other.Args && Globals == Other.Globals;
+}
+
+bool ModRefSummaries::Summary::operator!=(const Summary &Other) const {
+  return !(*this == Other);
+}
+
+ModRefSummaries::ModRefSummaries() {
+  computed_ = false;
+  TD_ = NULL;
+}
+
+void ModRefSummaries::compute(Module &M, CallGraph &CG, AliasAnalysis &AA,
+    const DataLayout *TD, unsigned NumThreads) {
+  computed_ = true;
+  TD_ = TD;
+  index_.clear();
+  summaries_.clear();
+  globalIds_.clear();
+
+  // The workers only read globalIds_
+  unsigned globalId = 0;
+  for (auto gi = M.global_begin(), ge = M.global_end(); gi != ge; ++gi)
+    globalIds_[&*gi] = globalId++;
+
+  // Create every entry first; the workers only write their own
+  for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
+    index_[&*fi] = summaries_.size();
+    summaries_.push_back(Summary());
+    summaries_.back().Args.resize(fi->arg_size(), None);
+  }
+
+  // Declarations are summarized from their attributes and AA, which is only
+  // used here on the calling thread
+  for (auto fi = M.begin(), fe = M.end(); fi != fe; ++fi) {
+    if (!fi->isDeclaration())
+      continue;
+
+    Summary &S = summaries_[index_[&*fi]];
+    AliasAnalysis::ModRefBehavior MRB = AA.getModRefBehavior(&*fi);
+    unsigned mr = MRB & AliasAnalysis::ModRef;
+    if (!AliasAnalysis::onlyAccessesArgPointees(MRB)) {
+      S.Unknown = mr;
+      continue;
+    }
+
+    unsigned arg = 0;
+    for (auto ai = fi->arg_begin(), ae = fi->arg_end(); ai != ae; ++ai, ++arg)
+      S.Args[arg] = ai->getType()->isPointerTy() ? mr : None;
+    if (fi->isVarArg())
+      S.VarArgs = mr;
+  }
+
+  // The SCCs in post-order (callees first). The level of an SCC is one more
+  // than the highest level of the SCCs it calls, so the SCCs of one level
+  // only call SCCs of lower levels.
+  std::vector<std::vector<const Function *> > sccs;
+  std::vector<bool> recursive;
+  std::vector<std::vector<unsigned> > levels;
+  DenseMap<const Function *, unsigned> levelOf;
+  for (scc_iterator<CallGraph *> I = scc_begin(&CG), E = scc_end(&CG);
+      I != E; ++I) {
+    const std::vector<CallGraphNode *> &nodes = *I;
+    std::vector<const Function *> funcs;
+    unsigned level = 0;
+    for (auto ni = nodes.begin(), ne = nodes.end(); ni != ne; ++ni) {
+      const Function *F = (*ni)->getFunction();
+      if (F == NULL || F->isDeclaration())
+        continue;
+      funcs.push_back(F);
+
+      for (auto ci = (*ni)->begin(), ce = (*ni)->end(); ci != ce; ++ci) {
+        auto li = levelOf.find(ci->second->getFunction());
+        if (li != levelOf.end())
+          level = std::max(level, li->second + 1);
+      }
+    }
+    if (funcs.empty())
+      continue;
+
+    for (auto fi = funcs.begin(), fe = funcs.end(); fi != fe; ++fi)
+      levelOf[*fi] = level;
+    if (levels.size() <= level)
+      levels.resize(level + 1);
+    levels[level].push_back(sccs.size());
+    sccs.push_back(funcs);
+    NumSummaries += funcs.size();
+    recursive.push_back(I.hasLoop());
+  }
+  NumSummarySCCs += sccs.size();
+  NumSummaryLevels += levels.size();
+
+  if (NumThreads > 1 && !llvm_is_multithreaded())
+    llvm_start_multithreaded();
+
+  WorkerPool pool(NumThreads);
+  for (auto li = levels.begin(), le = levels.end(); li != le; ++li) {
+    const std::vector<unsigned> &level = *li;
+    if (NumThreads <= 1 || level.size() == 1) {
+      for (auto i = level.begin(), e = level.end(); i != e; ++i)
+        summarizeSCC(sccs[*i], recursive[*i]);
+      continue;
+    }
+
+    pool.run(level.size(), [&](unsigned Worker, unsigned Item) {
+      summarizeSCC(sccs[level[Item]], recursive[level[Item]]);
+    });
+  }
+
+  for (auto i = summaries_.begin(), e = summaries_.end(); i != e; ++i) {
+    if (i->Unknown & Mod)
+      ++NumUnknownSummaries;
+  }
+}
+
+bool ModRefSummaries::computed() const {
+  return computed_;
+}
+
+void ModRefSummaries::clear() {
+  computed_ = false;
+  index_.clear();
+  summaries_.clear();
+  globalIds_.clear();
+}
+
+const ModRefSummaries::Summary *ModRefSummaries::getSummary(
+    const Function *F) const {
+  auto it = index_.find(F);
+  if (it == index_.end())
+    return NULL;
+  return &summaries_[it->second];
+}
+
+const ModRefSummaries::Summary *ModRefSummaries::getCallee(
+    ImmutableCallSite CS) const {
+  const Function *F = CS.getCalledFunction();
+  if (F == NULL)
+    return NULL;
+  return getSummary(F);
+}
+
+void ModRefSummaries::summarizeSCC(ArrayRef<const Function *> SCC,
+    bool Recursive) {
+  if (!Recursive) {
+    summarize(*SCC[0]);
+    return;
+  }
+
+  // Every pass starts from the summaries of the previous one, which only
+  // grow, so this reaches a fixed point
+  for (unsigned pass = 0; pass < MaxSCCIterations; ++pass) {
+    bool changed = false;
+    for (auto i = SCC.begin(), e = SCC.end(); i != e; ++i)
+      changed |= summarize(**i);
+    if (!changed)
+      return;
+  }
+
+  for (auto i = SCC.begin(), e = SCC.end(); i != e; ++i)
+    summaries_[index_.find(*i)->second].Unknown = ModRef;
+}
+
+bool ModRefSummaries::summarize(const Function &F) {
+  ++NumSummaryPasses;
+
+  Summary S;
+  S.Args.resize(F.arg_size(), None);
+  for (const_inst_iterator i = inst_begin(F), e = inst_end(F); i != e; ++i) {
+    const Instruction *I = &*i;
+    if (!I->mayReadFromMemory() && !I->mayWriteToMemory())
+      continue;
+
+    if (const LoadInst *LI = dyn_cast<LoadInst>(I)) {
+      if (LI->isUnordered())
+        addAccess(F, S, LI->getPointerOperand(), Ref);
+      else
+        S.Unknown = ModRef;
+    }
+    else if (const StoreInst *SI = dyn_cast<StoreInst>(I)) {
+      if (SI->isUnordered())
+        addAccess(F, S, SI->getPointerOperand(), Mod);
+      else
+        S.Unknown = ModRef;
+    }
+    else if (const VAArgInst *VI = dyn_cast<VAArgInst>(I)) {
+      // The va_list is updated and the variable arguments are read
+      addAccess(F, S, VI->getPointerOperand(), ModRef);
+      S.Unknown |= Ref;
+    }
+    else if (const AtomicRMWInst *AI = dyn_cast<AtomicRMWInst>(I)) {
+      addAccess(F, S, AI->getPointerOperand(), ModRef);
+    }
+    else if (const AtomicCmpXchgInst *AI = dyn_cast<AtomicCmpXchgInst>(I)) {
+      addAccess(F, S, AI->getPointerOperand(), ModRef);
+    }
+    else if (isa<CallInst>(I) || isa<InvokeInst>(I)) {
+      addCall(F, S, ImmutableCallSite(I));
+    }
+    else {
+      // Fences and anything else touching memory
+      S.Unknown = ModRef;
+    }
+  }
+
+  // Only the worker summarizing F writes its entry
+  Summary &old = summaries_[index_.find(&F)->second];
+  if (S == old)
+    return false;
+  old = S;
+  return true;
+}
+
+void ModRefSummaries::addGlobal(Summary &S, const GlobalValue *G,
+    unsigned MR) const {
+  unsigned id = globalIds_.lookup(G);
+  auto it = std::lower_bound(S.Globals.begin(), S.Globals.end(), id,
+      [this](const std::pair<const GlobalValue *, unsigned> &A, unsigned B) {
+        return globalIds_.lookup(A.first) < B;
+      });
+  if (it != S.Globals.end() && it->first == G) {
+    it->second |= MR;
+    return;
+  }
+  if (S.Globals.size() == MaxGlobals) {
+    S.Unknown |= MR;
+    return;
+  }
+  S.Globals.insert(it, std::make_pair(G, MR));
+}
+
+void ModRefSummaries::addAccess(const Function &F, Summary &S,
+    const Value *Ptr, unsigned MR) const {
+  const Value *O = GetUnderlyingObject(Ptr, TD_);
+
+  // The allocas of F are gone when it returns
+  if (isa<AllocaInst>(O))
+    return;
+
+  if (const Argument *A = dyn_cast<Argument>(O)) {
+    if (A->getParent() == &F) {
+      S.Args[A->getArgNo()] |= MR;
+      return;
+    }
+  }
+  else if (const GlobalVariable *G = dyn_cast<GlobalVariable>(O)) {
+    addGlobal(S, G, MR);
+    return;
+  }
+
+  S.Unknown |= MR;
+}
+
+void ModRefSummaries::addCall(const Function &F, Summary &S,
+    ImmutableCallSite CS) const {
+  if (CS.doesNotAccessMemory())
+    return;
+  unsigned limit = CS.onlyReadsMemory() ? unsigned(Ref) : unsigned(ModRef);
+
+  const Summary *C = getCallee(CS);
+  if (C == NULL) {
+    S.Unknown |= limit;
+    return;
+  }
+
+  // The accesses of the callee through its arguments are accesses through
+  // the actual arguments in F
+  S.Unknown |= C->Unknown & limit;
+  for (unsigned i = 0; i < CS.arg_size(); ++i) {
+    unsigned mr = (i < C->Args.size() ? C->Args[i] : C->VarArgs) & limit;
+    if (mr != None && CS.getArgument(i)->getType()->isPointerTy())
+      addAccess(F, S, CS.getArgument(i), mr);
+  }
+  for (auto gi = C->Globals.begin(), ge = C->Globals.end(); gi != ge; ++gi) {
+    if (gi->second & limit)
+      addGlobal(S, gi->first, gi->second & limit);
+  }
+}
+
+bool ModRefSummaries::mayAccess(ImmutableCallSite CS,
+    const AliasAnalysis::Location &Loc, unsigned Need,
+    AliasAnalysis &AA) const {
+  if (CS.doesNotAccessMemory())
+    return false;
+  if (CS.onlyReadsMemory())
+    Need &= Ref;
+  if (Need == None)
+    return false;
+
+  const Summary *C = getCallee(CS);
+  if (C == NULL || (C->Unknown & Need))
+    return true;
+
+  for (unsigned i = 0; i < CS.arg_size(); ++i) {
+    unsigned mr = i < C->Args.size() ? C->Args[i] : C->VarArgs;
+    const Value *arg = CS.getArgument(i);
+    if ((mr & Need) && arg->getType()->isPointerTy()
+        && AA.alias(AliasAnalysis::Location(arg), Loc) != AliasAnalysis::NoAlias)
+      return true;
+  }
+  for (auto gi = C->Globals.begin(), ge = C->Globals.end(); gi != ge; ++gi) {
+    if ((gi->second & Need)
+        && AA.alias(AliasAnalysis::Location(gi->first), Loc)
+          != AliasAnalysis::NoAlias)
+      return true;
+  }
+  return false;
+}
+
+StableDigest ModRefSummaries::hashCallees(const Function &F) const {
+  StableHasher H;
+  H.add(computed_);
+  for (const_inst_iterator i = inst_begin(F), e = inst_end(F); i != e; ++i) {
+    if (!isa<CallInst>(&*i) && !isa<InvokeInst>(&*i))
+      continue;
+    const Summary *C = getCallee(ImmutableCallSite(&*i));
+    if (C == NULL)
+      continue;
+
+    // Globals are hashed by name (by position if they have none) so the
+    // hash is stable between runs
+    H.add(C->Unknown);
+    H.add(C->VarArgs);
+    H.add(C->Args.size());
+    for (auto ai = C->Args.begin(), ae = C->Args.end(); ai != ae; ++ai)
+      H.add(*ai);
+    H.add(C->Globals.size());
+    for (auto gi = C->Globals.begin(), ge = C->Globals.end(); gi != ge; ++gi) {
+      if (gi->first->hasName())
+        H.add(gi->first->getName());
+      else
+        H.add(globalIds_.lookup(gi->first));
+      H.add(gi->second);
+    }
+  }
+  return H.finish();
+}
@@ -0,0 +1,151 @@
+// Author: Markus Kusano
+//
+// Interprocedural mod/ref summaries of the functions of a module.
+//
+// The summary of a function records which memory a call to it may read
+// (Ref) or write (Mod), in terms the caller can map to its own values:
+//
+//  - Args: the objects pointed to by each pointer argument
+//  - Globals: a small set of global variables
+//  - Unknown: any other memory (e.g., through a pointer loaded from memory)
+//
+// Accesses to the callee's own allocas are not visible to callers and are
+// not recorded. A summary is computed from the loads, stores and calls of a
+// function (the memory instructions DataDependence queries); the effects of
+// a call are the summary of the callee with its arguments replaced by the
+// actual arguments. Declarations are summarized from
+// AliasAnalysis::getModRefBehavior().
+//
+// The summaries are computed bottom-up over the strongly connected
+// components (SCCs) of the call graph: the functions of an SCC are iterated
+// to a fixed point after the summaries of all the functions they call are
+// done. SCCs whose callees are all done are independent of each other and
+// are computed in parallel.
+//
+// DataDependence uses mayAccess() to skip calls reported as Clobbers by
+// MemoryDependenceAnalysis that cannot touch the queried location:
+//
+//  ModRefSummaries S;
+//  S.compute(M, getAnalysis<CallGraph>(), AA, TD, NumThreads);
+//  DataDep.getDataDependencies(F, MDA, AA, TLI, &S);
+
+#ifndef MOD_REF_SUMMARY_H
+#define MOD_REF_SUMMARY_H
+
+#include "StableHash.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CallSite.h"
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+using namespace llvm;
+
+class ModRefSummaries {
+  public:
+    // Access kinds, as in AliasAnalysis::ModRefResult
+    enum Access {
+      None = 0,
+      Ref = 1,
+      Mod = 2,
+      ModRef = 3
+    };
+
+    struct Summary {
+      Summary();
+
+      bool operator==(const Summary &Other) const;
+      bool operator!=(const Summary &Other) const;
+
+      // Access to memory not covered by Args and Globals
+      unsigned Unknown;
+
+      // Access through each formal argument (None for non-pointers) and
+      // through the pointers passed as variable arguments
+      SmallVector<unsigned char, 4> Args;
+      unsigned VarArgs;
+
+      // Accessed globals and how, in the order of the module's global list
+      // so the summaries (and the globals past MaxGlobals) are the same in
+      // every run
+      SmallVector<std::pair<const GlobalValue *, unsigned>, 4> Globals;
+    };
+
+    // A summary naming more globals than this records the others as Unknown
+    static const unsigned MaxGlobals = 16;
+
+    // An SCC still changing after this many passes is summarized as Unknown
+    static const unsigned MaxSCCIterations = 32;
+
+    ModRefSummaries();
+
+    // Computes the summaries of all the functions of M. AA is only used on
+    // the calling thread (for the declarations); the defined functions are
+    // summarized on NumThreads workers.
+    void compute(Module &M, CallGraph &CG, AliasAnalysis &AA,
+        const DataLayout *TD, unsigned NumThreads);
+
+    // Returns true if compute() has been called
+    bool computed() const;
+
+    // Drops all the summaries, e.g., after functions changed. compute()
+    // must be called again before they are used.
+    void clear();
+
+    // Returns the summary of F, or NULL if F has none
+    const Summary *getSummary(const Function *F) const;
+
+    // Returns true if the call CS may access Loc in one of the ways in Need
+    // (a combination of Access values)
+    bool mayAccess(ImmutableCallSite CS, const AliasAnalysis::Location &Loc,
+        unsigned Need, AliasAnalysis &AA) const;
+
+    // Hash of the summaries of the functions called by F. The dependencies
+    // of F computed with these summaries only change if this does. The hash
+    // is the same in every run (see StableHash.h).
+    StableDigest hashCallees(const Function &F) const;
+
+  private:
+    bool computed_;
+    const DataLayout *TD_;
+
+    // Function -> index into summaries_. All the entries are created before
+    // the workers start so the map is only read concurrently.
+    DenseMap<const Function *, unsigned> index_;
+    std::vector<Summary> summaries_;
+
+    // GlobalVariable -> position in the module, the order of
+    // Summary::Globals
+    DenseMap<const GlobalValue *, unsigned> globalIds_;
+
+    // Returns the summary of the callee of CS, or NULL if it is unknown
+    const Summary *getCallee(ImmutableCallSite CS) const;
+
+    // Recomputes the summary of F from its instructions and the current
+    // summaries of its callees. Returns true if the summary changed.
+    bool summarize(const Function &F);
+
+    // Computes the summaries of the functions of one SCC. A non-recursive
+    // SCC (one function that does not call itself) needs a single pass.
+    void summarizeSCC(ArrayRef<const Function *> SCC, bool Recursive);
+
+    // Records an access of the kinds in MR to G in S
+    void addGlobal(Summary &S, const GlobalValue *G, unsigned MR) const;
+
+    // Records an access of the kinds in MR through Ptr in F to S
+    void addAccess(const Function &F, Summary &S, const Value *Ptr,
+        unsigned MR) const;
+
+    // Records the effects of the call CS in F to S
+    void addCall(const Function &F, Summary &S, ImmutableCallSite CS) const;
+};
+
+#endif // MOD_REF_SUMMARY_H
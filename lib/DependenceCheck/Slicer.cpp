@@ -0,0 +1,281 @@
+// Author: Markus Kusano
+//
+// See Slicer.h for more information
+
+#define DEBUG_TYPE "depcheck"
+#include "Slicer.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Instructions.h"
+
+STATISTIC(NumSliceQueries, "Number of slice queries");
+STATISTIC(NumSliceSteps, "Number of instructions expanded by slice queries");
+STATISTIC(NumSliceMemoHits, "Number of kept slices reused by slice queries");
+STATISTIC(NumSliceMemoDrops,
+    "Number of kept slices dropped to stay within the memory budget");
+
+// Builds CSR arrays from a list of (row, target) edges
+static void buildCSR(unsigned Rows,
+    const std::vector<std::pair<unsigned, unsigned> > &Edges,
+    std::vector<unsigned> &Offsets, std::vector<unsigned> &Targets) {
+  Offsets.assign(Rows + 1, 0);
+  for (auto i = Edges.begin(), e = Edges.end(); i != e; ++i)
+    ++Offsets[i->first + 1];
+  for (unsigned i = 0; i < Rows; ++i)
+    Offsets[i + 1] += Offsets[i];
+
+  std::vector<unsigned> next(Offsets.begin(), Offsets.end() - 1);
+  Targets.resize(Edges.size());
+  for (auto i = Edges.begin(), e = Edges.end(); i != e; ++i)
+    Targets[next[i->first]++] = i->second;
+}
+
+Slicer::Slicer(const DataDependence::FunctionDeps &Data,
+    const CompactCDG &Control) {
+  numInsts_ = Data.size();
+  numBlocks_ = Data.numBlocks();
+  assert(Control.size() == numBlocks_ && "results of different functions");
+
+  blockStarts_.reserve(numBlocks_ + 1);
+  blockOf_.reserve(numInsts_);
+  for (unsigned b = 0; b < numBlocks_; ++b) {
+    blockStarts_.push_back(blockOf_.size());
+    blockOf_.resize(blockOf_.size() + Data.getBlock(b)->size(), b);
+  }
+  blockStarts_.push_back(blockOf_.size());
+  assert(blockOf_.size() == numInsts_ && "function changed");
+
+  // Backward data edges (I -> what I depends on)
+  std::vector<std::pair<unsigned, unsigned> > edges;
+  for (unsigned i = 0; i < numInsts_; ++i) {
+    Instruction *inst = Data.getInst(i);
+    unsigned id;
+
+    for (auto oi = inst->op_begin(), oe = inst->op_end(); oi != oe; ++oi) {
+      Instruction *op = dyn_cast<Instruction>(oi->get());
+      if (op && Data.getId(op, id))
+        edges.push_back(std::make_pair(i, id));
+    }
+
+    // The value of a PHI depends on the branch taken into its block
+    if (PHINode *phi = dyn_cast<PHINode>(inst)) {
+      for (unsigned j = 0; j < phi->getNumIncomingValues(); ++j) {
+        if (Data.getBlockId(phi->getIncomingBlock(j), id))
+          edges.push_back(std::make_pair(i, blockStarts_[id + 1] - 1));
+      }
+    }
+
+    const DataDependence::DepInfo &local = Data.getLocalDep(i);
+    if (local.valid() && local.DepInst_ && Data.getId(local.DepInst_, id))
+      edges.push_back(std::make_pair(i, id));
+
+    ArrayRef<DataDependence::NonLocalDep> deps = Data.getNonLocalDeps(i);
+    for (auto di = deps.begin(), de = deps.end(); di != de; ++di) {
+      if (di->hasDepInst())
+        edges.push_back(std::make_pair(i, unsigned(di->DepInst_)));
+    }
+  }
+  buildCSR(numInsts_, edges, dataOffsets_[Backward], dataTargets_[Backward]);
+
+  for (auto i = edges.begin(), e = edges.end(); i != e; ++i)
+    std::swap(i->first, i->second);
+  buildCSR(numInsts_, edges, dataOffsets_[Forward], dataTargets_[Forward]);
+
+  // Control edges. The CDG holds both directions.
+  for (unsigned d = 0; d < 2; ++d) {
+    ctrlOffsets_[d].reserve(numBlocks_ + 1);
+    ctrlTargets_[d].reserve(Control.numEdges());
+  }
+  for (unsigned b = 0; b < numBlocks_; ++b) {
+    ctrlOffsets_[Forward].push_back(ctrlTargets_[Forward].size());
+    SmallVector<unsigned, 16> deps;
+    Control.dependents(b, deps);
+    ctrlTargets_[Forward].insert(ctrlTargets_[Forward].end(), deps.begin(),
+        deps.end());
+
+    ArrayRef<unsigned> ctrls = Control.controllers(b);
+    ctrlOffsets_[Backward].push_back(ctrlTargets_[Backward].size());
+    ctrlTargets_[Backward].insert(ctrlTargets_[Backward].end(), ctrls.begin(),
+        ctrls.end());
+  }
+  for (unsigned d = 0; d < 2; ++d)
+    ctrlOffsets_[d].push_back(ctrlTargets_[d].size());
+
+  clearMemo();
+}
+
+unsigned Slicer::size() const {
+  return numInsts_;
+}
+
+void Slicer::clearMemo() {
+  for (unsigned d = 0; d < 2; ++d) {
+    closures_[d].clear();
+    closures_[d].resize(numBlocks_);
+    hasClosure_[d].clear();
+    hasClosure_[d].resize(numBlocks_);
+    slices_[d].clear();
+  }
+  uses_.clear();
+  memoBytes_ = 0;
+}
+
+const BitVector *Slicer::findSlice(unsigned Criterion, Direction Dir) {
+  auto it = slices_[Dir].find(Criterion);
+  if (it == slices_[Dir].end())
+    return NULL;
+  uses_.splice(uses_.begin(), uses_, it->second.Use);
+  return &it->second.Slice;
+}
+
+void Slicer::keepSlice(unsigned Criterion, Direction Dir,
+    const BitVector &Slice) {
+  size_t bytes = (numInsts_ + 7) / 8;
+  if (bytes > MaxMemoBytes || slices_[Dir].count(Criterion))
+    return;
+
+  while (memoBytes_ + bytes > MaxMemoBytes) {
+    const std::pair<unsigned, unsigned> &last = uses_.back();
+    slices_[last.first].erase(last.second);
+    uses_.pop_back();
+    memoBytes_ -= bytes;
+    ++NumSliceMemoDrops;
+  }
+
+  uses_.push_front(std::make_pair(unsigned(Dir), Criterion));
+  MemoEntry &entry = slices_[Dir][Criterion];
+  entry.Slice = Slice;
+  entry.Use = uses_.begin();
+  memoBytes_ += bytes;
+}
+
+const BitVector &Slicer::getClosure(unsigned B, Direction Dir) {
+  BitVector &closure = closures_[Dir][B];
+  if (hasClosure_[Dir].test(B))
+    return closure;
+
+  // Blocks reachable from B over the control edges. B itself is only
+  // included if it is reached again (e.g., a loop exit that controls its
+  // own loop).
+  closure.resize(numBlocks_);
+  SmallVector<unsigned, 32> worklist;
+  worklist.push_back(B);
+  while (!worklist.empty()) {
+    unsigned b = worklist.pop_back_val();
+    const std::vector<unsigned> &offsets = ctrlOffsets_[Dir];
+    for (unsigned j = offsets[b]; j < offsets[b + 1]; ++j) {
+      unsigned t = ctrlTargets_[Dir][j];
+      if (closure.test(t))
+        continue;
+      closure.set(t);
+      worklist.push_back(t);
+    }
+  }
+
+  hasClosure_[Dir].set(B);
+  return closure;
+}
+
+void Slicer::slice(unsigned Criterion, Direction Dir, BitVector &Slice) {
+  assert(Criterion < numInsts_ && "instruction ID out of range");
+  if (const BitVector *kept = findSlice(Criterion, Dir)) {
+    ++NumSliceQueries;
+    ++NumSliceMemoHits;
+    Slice = *kept;
+    return;
+  }
+
+  traverse(ArrayRef<unsigned>(Criterion), Dir, Slice);
+  keepSlice(Criterion, Dir, Slice);
+}
+
+void Slicer::slice(ArrayRef<unsigned> Criteria, Direction Dir,
+    BitVector &Slice) {
+  if (Criteria.size() == 1) {
+    slice(Criteria[0], Dir, Slice);
+    return;
+  }
+  traverse(Criteria, Dir, Slice);
+}
+
+void Slicer::traverse(ArrayRef<unsigned> Criteria, Direction Dir,
+    BitVector &Slice) {
+  ++NumSliceQueries;
+
+  Slice.clear();
+  Slice.resize(numInsts_);
+
+  // Blocks whose control summary has been added to the slice. For Backward
+  // this means the terminators of the blocks controlling it are in the
+  // slice; for Forward that all the instructions of the blocks depending on
+  // it are.
+  BitVector doneBlocks(numBlocks_);
+
+  SmallVector<unsigned, 64> worklist;
+  for (auto i = Criteria.begin(), e = Criteria.end(); i != e; ++i) {
+    assert(*i < numInsts_ && "instruction ID out of range");
+    if (!Slice.test(*i)) {
+      Slice.set(*i);
+      worklist.push_back(*i);
+    }
+  }
+
+  while (!worklist.empty()) {
+    unsigned i = worklist.pop_back_val();
+
+    // A kept slice is closed under the dependencies so nothing in it needs
+    // to be expanded
+    if (const BitVector *kept = findSlice(i, Dir)) {
+      ++NumSliceMemoHits;
+      Slice |= *kept;
+      continue;
+    }
+    ++NumSliceSteps;
+
+    const std::vector<unsigned> &offsets = dataOffsets_[Dir];
+    for (unsigned j = offsets[i]; j < offsets[i + 1]; ++j) {
+      unsigned t = dataTargets_[Dir][j];
+      if (!Slice.test(t)) {
+        Slice.set(t);
+        worklist.push_back(t);
+      }
+    }
+
+    unsigned b = blockOf_[i];
+    if (Dir == Backward) {
+      if (doneBlocks.test(b))
+        continue;
+
+      // The summary of every block in the closure is contained in the
+      // closure, so they are all done at once
+      const BitVector &closure = getClosure(b, Backward);
+      doneBlocks.set(b);
+      for (int c = closure.find_first(); c != -1; c = closure.find_next(c)) {
+        doneBlocks.set(c);
+        unsigned term = blockStarts_[c + 1] - 1;
+        if (!Slice.test(term)) {
+          Slice.set(term);
+          worklist.push_back(term);
+        }
+      }
+    }
+    else {
+      // Only the terminator decides which dependent blocks execute
+      if (i != blockStarts_[b + 1] - 1 || doneBlocks.test(b))
+        continue;
+
+      const BitVector &closure = getClosure(b, Forward);
+      doneBlocks.set(b);
+      for (int c = closure.find_first(); c != -1; c = closure.find_next(c)) {
+        doneBlocks.set(c);
+        for (unsigned t = blockStarts_[c]; t < blockStarts_[c + 1]; ++t) {
+          if (!Slice.test(t)) {
+            Slice.set(t);
+            worklist.push_back(t);
+          }
+        }
+      }
+    }
+  }
+}
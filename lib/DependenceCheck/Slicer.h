@@ -0,0 +1,144 @@
+// Author: Markus Kusano
+//
+// Backward and forward slicing over the program dependence graph (PDG) of a
+// single function.
+//
+// The PDG is built from the results of DataDependence and ControlDependence.
+// An instruction I depends on:
+//
+//  - the instructions defining its operands (SSA def-use edges)
+//  - the instructions of its local and non-local memory dependencies
+//  - for a PHI node, the terminators of its incoming blocks
+//  - the terminators of the blocks I's block is control dependent on
+//
+// A backward slice of I contains every instruction I transitively depends
+// on; a forward slice every instruction that transitively depends on I.
+// Both include I itself.
+//
+// Instructions and blocks are identified by the dense IDs of
+// DataDependence::FunctionDeps. The Slicer copies the edges it needs when
+// it is built so it stays valid when other functions are analyzed; it must
+// be rebuilt if the results of its function change.
+//
+// Work is reused between queries in two ways:
+//
+//  - The transitive control dependencies of a block (in both directions)
+//    are computed once and kept as a per-block summary. A traversal that
+//    reaches a block adds the whole summary in one step.
+//  - The slices of recent single-criterion queries are kept, up to
+//    MaxMemoBytes; once they take more, the least recently used slice is
+//    dropped. A later traversal that reaches one of these instructions adds
+//    its slice instead of walking it again.
+//
+// The block summaries take at most numBlocks^2 bits in each direction; a
+// kept slice takes one bit per instruction.
+//
+// Example:
+//
+//  Slicer S(*DataDep.getFunctionDeps(&F), *ControlDep.getCompactCDG(&F));
+//  BitVector slice;
+//  S.slice(Id, Slicer::Backward, slice);
+//  for (int i = slice.find_first(); i != -1; i = slice.find_next(i))
+//    ... instruction with the ID i is in the slice ...
+
+#ifndef SLICER_H
+#define SLICER_H
+
+#include "ControlDependence.h"
+#include "DataDependence.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include <list>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+using namespace llvm;
+
+class Slicer {
+  public:
+    enum Direction {
+      Backward = 0,
+      Forward = 1
+    };
+
+    // Data and Control must be the results of the same function
+    Slicer(const DataDependence::FunctionDeps &Data, const CompactCDG &Control);
+
+    // Number of instructions in the function
+    unsigned size() const;
+
+    // Sets Slice to the slice of the instruction with the ID Criterion. Slice
+    // has one bit per instruction ID.
+    void slice(unsigned Criterion, Direction Dir, BitVector &Slice);
+
+    // Sets Slice to the union of the slices of all the Criteria. This is
+    // calculated in a single traversal.
+    void slice(ArrayRef<unsigned> Criteria, Direction Dir, BitVector &Slice);
+
+    // Frees the kept slices and block summaries
+    void clearMemo();
+
+    // Bytes of kept slices (in both directions) after which the least
+    // recently used one is dropped
+    static const size_t MaxMemoBytes = 4 << 20;
+
+  private:
+    unsigned numInsts_;
+    unsigned numBlocks_;
+
+    // First instruction ID of each block (numBlocks_ + 1 entries) and the
+    // block of each instruction
+    std::vector<unsigned> blockStarts_;
+    std::vector<unsigned> blockOf_;
+
+    // Dependence edges in CSR form, indexed by Direction. For Backward the
+    // row of an instruction holds what it depends on; for Forward what
+    // depends on it.
+    std::vector<unsigned> dataOffsets_[2];
+    std::vector<unsigned> dataTargets_[2];
+
+    // Control dependence edges between blocks in CSR form, indexed by
+    // Direction. For Backward the row of a block holds the blocks it is
+    // control dependent on; for Forward the blocks dependent on it.
+    std::vector<unsigned> ctrlOffsets_[2];
+    std::vector<unsigned> ctrlTargets_[2];
+
+    // Transitive control dependencies of each block, one bit per block.
+    // Only valid if the block's bit in hasClosure_ is set.
+    std::vector<BitVector> closures_[2];
+    BitVector hasClosure_[2];
+
+    // A kept slice and its position in uses_
+    struct MemoEntry {
+      BitVector Slice;
+      std::list<std::pair<unsigned, unsigned> >::iterator Use;
+    };
+
+    // Criterion -> slice of the single-criterion queries
+    DenseMap<unsigned, MemoEntry> slices_[2];
+
+    // (Direction, criterion) of the kept slices, most recently used first
+    std::list<std::pair<unsigned, unsigned> > uses_;
+
+    // Bytes held by the kept slices
+    size_t memoBytes_;
+
+    // Returns the kept slice of Criterion, or NULL, and marks it as used
+    const BitVector *findSlice(unsigned Criterion, Direction Dir);
+
+    // Keeps Slice as the slice of Criterion, dropping the least recently
+    // used slices beyond MaxMemoBytes
+    void keepSlice(unsigned Criterion, Direction Dir, const BitVector &Slice);
+
+    // Returns the transitive control dependencies of block B
+    const BitVector &getClosure(unsigned B, Direction Dir);
+
+    // The traversal shared by both slice() functions
+    void traverse(ArrayRef<unsigned> Criteria, Direction Dir, BitVector &Slice);
+};
+
+#endif // SLICER_H
@@ -0,0 +1,169 @@
+// Author: Markus Kusano
+//
+// See StableHash.h for more information
+
+#include "StableHash.h"
+
+#include <string.h>
+
+namespace {
+  // Per-round shift amounts and the constants floor(abs(sin(i + 1)) * 2^32)
+  const uint32_t Shifts[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+  };
+
+  const uint32_t Sines[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+    0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+    0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+    0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+    0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+    0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+  };
+
+  uint32_t rotateLeft(uint32_t X, uint32_t N) {
+    return (X << N) | (X >> (32 - N));
+  }
+} // end anonymous namespace
+
+bool StableDigest::operator==(const StableDigest &Other) const {
+  return memcmp(Bytes, Other.Bytes, sizeof(Bytes)) == 0;
+}
+
+bool StableDigest::operator!=(const StableDigest &Other) const {
+  return !(*this == Other);
+}
+
+uint64_t StableDigest::low64() const {
+  uint64_t v = 0;
+  for (unsigned i = 0; i < 8; ++i)
+    v |= uint64_t(Bytes[i]) << (8 * i);
+  return v;
+}
+
+std::string StableDigest::toHex() const {
+  static const char Digits[] = "0123456789abcdef";
+  std::string s;
+  for (unsigned i = 0; i < sizeof(Bytes); ++i) {
+    s += Digits[Bytes[i] >> 4];
+    s += Digits[Bytes[i] & 0xf];
+  }
+  return s;
+}
+
+StableHasher::StableHasher() : length_(0) {
+  state_[0] = 0x67452301;
+  state_[1] = 0xefcdab89;
+  state_[2] = 0x98badcfe;
+  state_[3] = 0x10325476;
+}
+
+void StableHasher::add(uint64_t Value) {
+  uint8_t bytes[8];
+  for (unsigned i = 0; i < 8; ++i)
+    bytes[i] = uint8_t(Value >> (8 * i));
+  addBytes(bytes, sizeof(bytes));
+}
+
+void StableHasher::add(StringRef String) {
+  add(uint64_t(String.size()));
+  addBytes(String.data(), String.size());
+}
+
+void StableHasher::add(const StableDigest &Digest) {
+  addBytes(Digest.Bytes, sizeof(Digest.Bytes));
+}
+
+void StableHasher::addBytes(const void *Data, size_t Size) {
+  const uint8_t *p = static_cast<const uint8_t *>(Data);
+  unsigned used = length_ % 64;
+  length_ += Size;
+
+  // Complete the buffered block first
+  if (used != 0) {
+    size_t n = 64 - used < Size ? 64 - used : Size;
+    memcpy(buffer_ + used, p, n);
+    p += n;
+    Size -= n;
+    if (used + n < 64)
+      return;
+    transform(buffer_);
+  }
+
+  for (; Size >= 64; p += 64, Size -= 64)
+    transform(p);
+  memcpy(buffer_, p, Size);
+}
+
+StableDigest StableHasher::finish() {
+  // Pad with a one bit, zeros up to 56 bytes modulo 64 and the message
+  // length in bits
+  uint64_t bits = length_ * 8;
+  static const uint8_t Padding[64] = { 0x80 };
+  unsigned used = length_ % 64;
+  addBytes(Padding, used < 56 ? 56 - used : 120 - used);
+
+  uint8_t size[8];
+  for (unsigned i = 0; i < 8; ++i)
+    size[i] = uint8_t(bits >> (8 * i));
+  addBytes(size, sizeof(size));
+
+  StableDigest D;
+  for (unsigned i = 0; i < 16; ++i)
+    D.Bytes[i] = uint8_t(state_[i / 4] >> (8 * (i % 4)));
+  return D;
+}
+
+void StableHasher::transform(const uint8_t *Block) {
+  uint32_t m[16];
+  for (unsigned i = 0; i < 16; ++i) {
+    m[i] = uint32_t(Block[4 * i]) | (uint32_t(Block[4 * i + 1]) << 8)
+      | (uint32_t(Block[4 * i + 2]) << 16) | (uint32_t(Block[4 * i + 3]) << 24);
+  }
+
+  uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+  for (unsigned i = 0; i < 64; ++i) {
+    uint32_t f;
+    unsigned g;
+    if (i < 16) {
+      f = (b & c) | (~b & d);
+      g = i;
+    }
+    else if (i < 32) {
+      f = (d & b) | (~d & c);
+      g = (5 * i + 1) % 16;
+    }
+    else if (i < 48) {
+      f = b ^ c ^ d;
+      g = (3 * i + 5) % 16;
+    }
+    else {
+      f = c ^ (b | ~d);
+      g = (7 * i) % 16;
+    }
+
+    uint32_t t = d;
+    d = c;
+    c = b;
+    b = b + rotateLeft(a + f + Sines[i] + m[g], Shifts[i]);
+    a = t;
+  }
+
+  state_[0] += a;
+  state_[1] += b;
+  state_[2] += c;
+  state_[3] += d;
+}
@@ -0,0 +1,72 @@
+// Author: Markus Kusano
+//
+// Hash that is the same in every run and on every host, for keys that are
+// written to disk (see DepCache.h).
+//
+// llvm/ADT/Hashing.h is only meant for hash tables: its seed may change
+// between runs and its results between LLVM versions. StableHasher is MD5
+// (RFC 1321) over a canonical serialization of the values it is given:
+// integers as 8 little-endian bytes and strings with their length in front,
+// so two different sequences of values never serialize to the same bytes.
+// MD5 is not used for security, only to make collisions of the 128 bit
+// digests negligible.
+//
+//  StableHasher H;
+//  H.add(F.getName());
+//  H.add(F.size());
+//  StableDigest D = H.finish();
+
+#ifndef STABLE_HASH_H
+#define STABLE_HASH_H
+
+#include "llvm/ADT/StringRef.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+using namespace llvm;
+
+struct StableDigest {
+  uint8_t Bytes[16];
+
+  bool operator==(const StableDigest &Other) const;
+  bool operator!=(const StableDigest &Other) const;
+
+  // The first 8 bytes as a little-endian integer (e.g., for file names)
+  uint64_t low64() const;
+
+  // The 32 hex digits of the digest
+  std::string toHex() const;
+};
+
+class StableHasher {
+  public:
+    StableHasher();
+
+    // Adds an integer (of any width, as 8 bytes)
+    void add(uint64_t Value);
+
+    // Adds a string and its length
+    void add(StringRef String);
+
+    // Adds a digest (e.g., of a nested structure)
+    void add(const StableDigest &Digest);
+
+    // Adds Size raw bytes. Only use this for data of a fixed size.
+    void addBytes(const void *Data, size_t Size);
+
+    // Returns the digest of everything added. The hasher must not be used
+    // afterwards.
+    StableDigest finish();
+
+  private:
+    uint32_t state_[4];
+    uint64_t length_; // bytes added so far
+    uint8_t buffer_[64];
+
+    // Processes the 64 byte block Block
+    void transform(const uint8_t *Block);
+};
+
+#endif // STABLE_HASH_H
@@ -0,0 +1,49 @@
+// Author: Markus Kusano
+//
+// See WorkerPool.h for more information
+
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(unsigned NumThreads) : next_(0) {
+  numThreads_ = NumThreads == 0 ? 1 : NumThreads;
+  numItems_ = 0;
+}
+
+WorkerPool::~WorkerPool() {
+  wait();
+}
+
+unsigned WorkerPool::size() const {
+  return numThreads_;
+}
+
+void WorkerPool::start(unsigned NumItems, WorkFn Work) {
+  wait();
+
+  numItems_ = NumItems;
+  work_ = Work;
+  next_ = 0;
+
+  for (unsigned i = 0; i < numThreads_; ++i)
+    threads_.push_back(std::thread(&WorkerPool::workerLoop, this, i));
+}
+
+void WorkerPool::wait() {
+  for (auto i = threads_.begin(), e = threads_.end(); i != e; ++i)
+    i->join();
+  threads_.clear();
+}
+
+void WorkerPool::run(unsigned NumItems, WorkFn Work) {
+  start(NumItems, Work);
+  wait();
+}
+
+void WorkerPool::workerLoop(unsigned Worker) {
+  for (;;) {
+    unsigned item = next_++;
+    if (item >= numItems_)
+      return;
+    work_(Worker, item);
+  }
+}
@@ -0,0 +1,68 @@
+// Author: Markus Kusano
+//
+// A small pool of worker threads used to run independent per-function work
+// in parallel.
+//
+// The pool is given a number of work items and a function to run on each of
+// them. Items are handed out to the workers one at a time. For example:
+//
+//  WorkerPool Pool(NumThreads);
+//  Pool.start(Functions.size(), [&](unsigned Worker, unsigned Item) {
+//    Shards[Worker].process(*Functions[Item]);
+//  });
+//  // ... the calling thread is free to do other work here ...
+//  Pool.wait();
+//
+// The worker index passed to the function is in [0, size()) and can be used
+// to index thread-local result shards. The work function must only touch
+// state that is private to the worker or otherwise synchronized.
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+  public:
+    // Work function: called with the worker index and the item index
+    typedef std::function<void(unsigned, unsigned)> WorkFn;
+
+    // Create a pool with NumThreads workers. At least one worker is always
+    // created.
+    explicit WorkerPool(unsigned NumThreads);
+
+    // Waits for any outstanding work
+    ~WorkerPool();
+
+    // Number of workers in the pool
+    unsigned size() const;
+
+    // Starts the workers on the items [0, NumItems). This returns
+    // immediately; call wait() to block until all items are done. start()
+    // must not be called again before wait() has returned.
+    void start(unsigned NumItems, WorkFn Work);
+
+    // Block until all the items passed to start() have been processed
+    void wait();
+
+    // Convenience function: start() followed by wait()
+    void run(unsigned NumItems, WorkFn Work);
+
+  private:
+    // Body of each worker thread
+    void workerLoop(unsigned Worker);
+
+    unsigned numThreads_;
+    unsigned numItems_;
+    WorkFn work_;
+
+    // Index of the next item to hand out
+    std::atomic<unsigned> next_;
+
+    std::vector<std::thread> threads_;
+};
+
+#endif // WORKER_POOL_H
@@ -0,0 +1,178 @@
+#!/usr/bin/env python
+#
+# Author: Markus Kusano
+#
+# Generates synthetic LLVM IR (LLVM 3.3 syntax) that stresses the different
+# parts of the DependenceCheck pass. Usage:
+#
+#   gen_ir.py <shape> <size> [-o <file.ll>]
+#
+# Shapes:
+#
+#   ifnest     <size> nested if statements in one function. Stresses the
+#              post-dominator tree walk (deep trees, long paths).
+#   switch     One switch with <size> cases. Stresses the set S (many edges
+#              leaving one block).
+#   chain      One block with <size> alternating stores and loads to a few
+#              addresses. Stresses the local dependence queries.
+#   diamond    <size> diamonds in sequence, each storing on both sides and
+#              loading in the join, plus a load at the end that is reached
+#              through all of them. Stresses the non-local queries.
+#   manyfuncs  <size> small functions. Stresses the per-function overhead
+#              (analysis setup, threads, export, cache).
+
+from __future__ import print_function
+
+import sys
+
+# Number of i32 slots of the array the generated code accesses
+SLOTS = 8
+
+
+def slot(out, name, ptr, index):
+    out.append('  %%%s = getelementptr inbounds i32* %s, i64 %d'
+               % (name, ptr, index))
+
+
+def gen_ifnest(size):
+    out = ['define i32 @ifnest(i32 %n, i32* %p) {', 'entry:',
+           '  br label %if0']
+    for i in range(size):
+        nxt = 'if%d' % (i + 1) if i + 1 < size else 'join%d' % i
+        out += ['if%d:' % i,
+                '  %%c%d = icmp sgt i32 %%n, %d' % (i, i),
+                '  br i1 %%c%d, label %%then%d, label %%join%d' % (i, i, i),
+                'then%d:' % i]
+        slot(out, 't%d' % i, '%p', i % SLOTS)
+        out += ['  store i32 %d, i32* %%t%d, align 4' % (i, i),
+                '  br label %%%s' % nxt]
+    for i in reversed(range(size)):
+        out.append('join%d:' % i)
+        slot(out, 'j%d' % i, '%p', i % SLOTS)
+        out.append('  %%v%d = load i32* %%j%d, align 4' % (i, i))
+        if i > 0:
+            out.append('  br label %%join%d' % (i - 1))
+    out += ['  ret i32 %v0', '}']
+    return out
+
+
+def gen_switch(size):
+    out = ['define i32 @switch(i32 %n, i32* %p) {', 'entry:',
+           '  switch i32 %n, label %default [']
+    for i in range(size):
+        out.append('    i32 %d, label %%case%d' % (i, i))
+    out.append('  ]')
+    for i in range(size):
+        out.append('case%d:' % i)
+        slot(out, 's%d' % i, '%p', i % SLOTS)
+        out += ['  store i32 %d, i32* %%s%d, align 4' % (i, i),
+                '  br label %exit']
+    out += ['default:', '  br label %exit', 'exit:',
+            '  %v = load i32* %p, align 4', '  ret i32 %v', '}']
+    return out
+
+
+def gen_chain(size):
+    out = ['define i32 @chain(i32* %p) {', 'entry:']
+    for i in range(SLOTS):
+        slot(out, 'a%d' % i, '%p', i)
+    out.append('  %v0 = load i32* %a0, align 4')
+    for i in range(1, size + 1):
+        out += ['  store i32 %%v%d, i32* %%a%d, align 4'
+                % (i - 1, i % SLOTS),
+                '  %%v%d = load i32* %%a%d, align 4'
+                % (i, (i * 3) % SLOTS)]
+    out += ['  ret i32 %%v%d' % size, '}']
+    return out
+
+
+def gen_diamond(size):
+    out = ['define i32 @diamond(i32 %n, i32* %p) {', 'entry:',
+           '  br label %head0']
+    for i in range(size):
+        k = i % (SLOTS - 1)
+        out += ['head%d:' % i,
+                '  %%c%d = icmp sgt i32 %%n, %d' % (i, i),
+                '  br i1 %%c%d, label %%left%d, label %%right%d' % (i, i, i),
+                'left%d:' % i]
+        slot(out, 'l%d' % i, '%p', k)
+        out += ['  store i32 %d, i32* %%l%d, align 4' % (i, i),
+                '  br label %%join%d' % i,
+                'right%d:' % i]
+        slot(out, 'r%d' % i, '%p', k + 1)
+        out += ['  store i32 %d, i32* %%r%d, align 4' % (i, i),
+                '  br label %%join%d' % i,
+                'join%d:' % i]
+        slot(out, 'q%d' % i, '%p', k)
+        out += ['  %%v%d = load i32* %%q%d, align 4' % (i, i),
+                '  br label %%%s' % ('head%d' % (i + 1) if i + 1 < size
+                                     else 'exit')]
+    out += ['exit:']
+    slot(out, 'e', '%p', SLOTS - 1)
+    out += ['  %v = load i32* %e, align 4', '  ret i32 %v', '}']
+    return out
+
+
+def gen_manyfuncs(size):
+    out = []
+    for i in range(size):
+        out += ['define i32 @f%d(i32 %%n, i32* %%p) {' % i, 'entry:',
+                '  %c = icmp sgt i32 %n, 0',
+                '  br i1 %c, label %then, label %else',
+                'then:',
+                '  store i32 %d, i32* %%p, align 4' % i,
+                '  br label %join',
+                'else:']
+        slot(out, 'e', '%p', 1)
+        out += ['  store i32 %n, i32* %e, align 4',
+                '  br label %join',
+                'join:',
+                '  %v = load i32* %p, align 4',
+                '  ret i32 %v',
+                '}', '']
+    return out
+
+
+SHAPES = {
+    'ifnest': gen_ifnest,
+    'switch': gen_switch,
+    'chain': gen_chain,
+    'diamond': gen_diamond,
+    'manyfuncs': gen_manyfuncs,
+}
+
+
+def usage():
+    print('usage: %s <%s> <size> [-o <file.ll>]'
+          % (sys.argv[0], '|'.join(sorted(SHAPES))), file=sys.stderr)
+    sys.exit(1)
+
+
+def main():
+    args = sys.argv[1:]
+    output = None
+    if len(args) == 4 and args[2] == '-o':
+        output = args[3]
+        args = args[:2]
+    if len(args) != 2 or args[0] not in SHAPES:
+        usage()
+    try:
+        size = int(args[1])
+    except ValueError:
+        usage()
+    if size < 1:
+        usage()
+
+    lines = ['; Generated by gen_ir.py %s %d' % (args[0], size), '']
+    lines += SHAPES[args[0]](size)
+    text = '\n'.join(lines) + '\n'
+
+    if output is None:
+        sys.stdout.write(text)
+    else:
+        with open(output, 'w') as f:
+            f.write(text)
+
+
+if __name__ == '__main__':
+    main()
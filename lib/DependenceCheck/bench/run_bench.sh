@@ -0,0 +1,150 @@
+#!/bin/sh
+#
+# Benchmark driver for the DependenceCheck pass.
+#
+# Generates the stress inputs with gen_ir.py, runs the pass on each of them
+# with every engine and thread count, and records the wall time, peak RSS,
+# the -stats counters and the -time-passes phase timings in
+# ${OUT}/results.csv with one metric per line:
+#
+#   build,input,engine,threads,metric,value
+#
+# All the settings below can be overridden from the environment, e.g.:
+#
+#   ENGINES=frontier THREADS="1 4" SCALE=2 ./run_bench.sh
+#
+# To compare two builds of the pass (e.g., before and after a change to the
+# data structures) point DEPCHECK_BASE at the older DependenceCheck.so; every
+# configuration is then run with both builds. Both builds must accept the
+# options used below.
+
+# Modify LLVM_PATH to the top-level directory where LLVM is installed
+# llvm 3.3
+LLVM_PATH=${LLVM_PATH:-/home/markus/src/install-3.3}
+OPT=${OPT:-${LLVM_PATH}/bin/opt}
+LLVMAS=${LLVMAS:-${LLVM_PATH}/bin/llvm-as}
+
+# DependenceCheck library location
+DEPCHECK=${DEPCHECK:-/home/markus/src/dependence/install/lib/DependenceCheck.so}
+DEPCHECK_BASE=${DEPCHECK_BASE:-}
+
+PYTHON=${PYTHON:-python}
+TIME=${TIME:-/usr/bin/time}
+
+ENGINES=${ENGINES:-"ferrante frontier"}
+THREADS=${THREADS:-"1"}
+
+# Multiplies the size of every generated input
+SCALE=${SCALE:-1}
+
+OUT=${OUT:-results}
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+
+# Inputs as <shape>:<size>
+INPUTS="ifnest:$((2000 * SCALE)) switch:$((5000 * SCALE)) \
+chain:$((20000 * SCALE)) diamond:$((500 * SCALE)) \
+manyfuncs:$((5000 * SCALE))"
+
+mkdir -p "${OUT}/inputs" "${OUT}/logs" || exit 1
+CSV="${OUT}/results.csv"
+echo "build,input,engine,threads,metric,value" >"$CSV"
+
+# Generates ${OUT}/inputs/<shape>.<size>.bc unless it already exists
+gen_input() {
+  shape=$1
+  size=$2
+  base="${OUT}/inputs/${shape}.${size}"
+  if [ ! -f "${base}.bc" ]; then
+    echo "Generating ${shape} ${size}"
+    $PYTHON "${BENCH_DIR}/gen_ir.py" "$shape" "$size" -o "${base}.ll" || exit 1
+    $LLVMAS "${base}.ll" -o "${base}.bc" || exit 1
+  fi
+}
+
+# Appends the metrics of one run to the CSV.
+#
+# -stats lines look like "   12 depcheck - Number of ...". -time-passes
+# rows of the phase timer group end with the phase name; after removing the
+# percentages the wall time is the field before the name.
+record() {
+  prefix=$1
+  timefile=$2
+  log=$3
+
+  awk -v p="$prefix" '{ printf "%s,wall_seconds,%s\n%s,peak_rss_kb,%s\n", p, $1, p, $2 }' \
+    "$timefile" >>"$CSV"
+
+  awk -v p="$prefix" '
+    $2 == "depcheck" && $3 == "-" {
+      desc = $0
+      sub(/^[^-]*- /, "", desc)
+      gsub(/,/, ";", desc)
+      printf "%s,stat:%s,%s\n", p, desc, $1
+    }
+    /Dependence Check phases/ { inPhases = 1; next }
+    inPhases && /^===/ { next }
+    inPhases && $NF == "Total" { inPhases = 0; next }
+    inPhases {
+      line = $0
+      gsub(/\( *[0-9.]+%\)/, "", line)
+      n = split(line, f, " ")
+      if (n >= 2 && f[n - 1] ~ /^[0-9.]+$/)
+        printf "%s,phase:%s,%s\n", p, f[n], f[n - 1]
+    }' "$log" >>"$CSV"
+}
+
+# Runs the pass built as $2 (labeled $1) on $3 with engine $4 and $5 threads
+run_one() {
+  build=$1
+  lib=$2
+  input=$3
+  engine=$4
+  threads=$5
+
+  name=$(basename "$input" .bc)
+  log="${OUT}/logs/${build}.${name}.${engine}.${threads}.log"
+  timefile="${log}.time"
+
+  echo "Running: ${build} ${name} engine=${engine} threads=${threads}"
+  $TIME -f "%e %M" -o "$timefile" \
+    $OPT -basicaa -memdep -load "$lib" -depcheck \
+      -depcheck-cd-engine="$engine" -depcheck-threads="$threads" \
+      -stats -time-passes -disable-output "$input" 2>"$log"
+  if [ $? -ne 0 ]; then
+    echo "[Warning] run failed, see $log"
+    return
+  fi
+
+  # /usr/bin/time may prefix its line with the exit status of the command
+  tail -n 1 "$timefile" >"${timefile}.last" && mv "${timefile}.last" "$timefile"
+  record "${build},${name},${engine},${threads}" "$timefile" "$log"
+}
+
+for i in $INPUTS; do
+  gen_input "${i%%:*}" "${i##*:}"
+done
+
+for i in $INPUTS; do
+  input="${OUT}/inputs/${i%%:*}.${i##*:}.bc"
+  for engine in $ENGINES; do
+    for threads in $THREADS; do
+      run_one new "$DEPCHECK" "$input" "$engine" "$threads"
+      if [ -n "$DEPCHECK_BASE" ]; then
+        run_one base "$DEPCHECK_BASE" "$input" "$engine" "$threads"
+      fi
+    done
+  done
+done
+
+# Wall time and peak RSS side by side for a quick comparison
+printf "%-40s %12s %12s\n" "build,input,engine,threads" "wall (s)" "RSS (KB)"
+awk -F, '
+  $5 == "wall_seconds" { wall[$1 "," $2 "," $3 "," $4] = $6 }
+  $5 == "peak_rss_kb" { rss[$1 "," $2 "," $3 "," $4] = $6 }
+  END {
+    for (k in wall)
+      printf "%-40s %12s %12s\n", k, wall[k], rss[k]
+  }' "$CSV" | sort
+
+echo "Results written to $CSV"
@@ -0,0 +1,27 @@
+; Regression input for the query budgets: the load in %join is reached from
+; three blocks, so with -depcheck-max-query-blocks=1 its non-local query is
+; cut short and recorded as Unknown without an instruction. -analyze must
+; print it instead of crashing.
+;
+;  opt -basicaa -analyze -load DependenceCheck.so -depcheck \
+;      -depcheck-max-query-blocks=1 <budget.bc
+
+@A = global i32 0, align 4
+
+define i32 @main(i32 %argc) nounwind {
+entry:
+  %cmp = icmp sgt i32 %argc, 1
+  br i1 %cmp, label %then, label %else
+
+then:
+  store i32 1, i32* @A, align 4
+  br label %join
+
+else:
+  store i32 2, i32* @A, align 4
+  br label %join
+
+join:
+  %v = load i32* @A, align 4
+  ret i32 %v
+}
@@ -0,0 +1,38 @@
+; Regression input for -depcheck-cache. The first run stores both functions,
+; the second restores both, and a run on cache_changed.ll (where @g stores 1
+; instead of 0) restores @f and stores @g again:
+;
+;  opt -basicaa -load DependenceCheck.so -depcheck -depcheck-cache=cache.dir \
+;      -stats -disable-output <cache.bc
+;  opt -basicaa -load DependenceCheck.so -depcheck -depcheck-cache=cache.dir \
+;      -stats -disable-output <cache_changed.bc
+
+@A = global i32 0, align 4
+
+define i32 @f(i32 %x) nounwind {
+entry:
+  %cmp = icmp sgt i32 %x, 0
+  br i1 %cmp, label %then, label %join
+
+then:
+  store i32 %x, i32* @A, align 4
+  br label %join
+
+join:
+  %v = load i32* @A, align 4
+  ret i32 %v
+}
+
+define i32 @g(i32 %x) nounwind {
+entry:
+  %cmp = icmp eq i32 %x, 0
+  br i1 %cmp, label %then, label %join
+
+then:
+  store i32 0, i32* @A, align 4
+  br label %join
+
+join:
+  %v = load i32* @A, align 4
+  ret i32 %v
+}
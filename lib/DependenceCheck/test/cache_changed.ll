@@ -0,0 +1,31 @@
+; cache.ll with @g changed (see cache.ll)
+
+@A = global i32 0, align 4
+
+define i32 @f(i32 %x) nounwind {
+entry:
+  %cmp = icmp sgt i32 %x, 0
+  br i1 %cmp, label %then, label %join
+
+then:
+  store i32 %x, i32* @A, align 4
+  br label %join
+
+join:
+  %v = load i32* @A, align 4
+  ret i32 %v
+}
+
+define i32 @g(i32 %x) nounwind {
+entry:
+  %cmp = icmp eq i32 %x, 0
+  br i1 %cmp, label %then, label %join
+
+then:
+  store i32 1, i32* @A, align 4
+  br label %join
+
+join:
+  %v = load i32* @A, align 4
+  ret i32 %v
+}
@@ -0,0 +1,30 @@
+; Regression input for the sharing of call results: both arms of the diamond
+; have the predecessor set {entry}, so the call in %right reuses the
+; non-local results of the identical call in %left instead of querying
+; MemoryDependenceAnalysis again. With -stats, "Number of non-local call
+; queries answered by an identical call" is 1.
+;
+;  opt -basicaa -analyze -stats -load DependenceCheck.so -depcheck \
+;      <call_batch.bc
+
+@A = global i32 0, align 4
+
+declare void @update(i32*)
+
+define void @main(i32 %argc) nounwind {
+entry:
+  store i32 0, i32* @A, align 4
+  %cmp = icmp sgt i32 %argc, 1
+  br i1 %cmp, label %left, label %right
+
+left:
+  call void @update(i32* @A)
+  br label %join
+
+right:
+  call void @update(i32* @A)
+  br label %join
+
+join:
+  ret void
+}
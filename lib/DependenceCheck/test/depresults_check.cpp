@@ -0,0 +1,170 @@
+// Author: Markus Kusano
+//
+// Test driver for DepResults.h: opens a binary export or diff file and
+// writes every function record as one JSON object per line, in the format
+// of -depcheck-export-format=jsonl. Dumping a binary export must give the
+// same text as the JSON lines export of the same run (see run_test.sh).
+//
+//  depresults_check [-diff] <file>
+//
+// With -diff the file must be a diff file, otherwise an export file. A file
+// that cannot be opened, or a malformed record, is reported on stderr and
+// the exit status is 1. Built without LLVM from DepRecord.cpp and
+// DepResults.cpp (see Makefile).
+
+#include "DepResults.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+using namespace depformat;
+
+// DataDependence::depTypeToString() without LLVM
+static const char *typeName(uint32_t Type) {
+  switch (Type) {
+    case 0:
+      return "Clobber";
+    case 1:
+      return "Def";
+    case 2:
+      return "NonFuncLocal";
+    case 3:
+      return "NonLocal";
+    case 4:
+      return "Unknown";
+    case 99:
+      return "Invalid";
+  }
+  return "?";
+}
+
+static void printString(const char *S, uint32_t Length) {
+  putchar('"');
+  for (uint32_t i = 0; i < Length; ++i) {
+    unsigned char ch = S[i];
+    if (ch == '"' || ch == '\\')
+      printf("\\%c", ch);
+    else if (ch < 0x20)
+      printf("\\u%04x", ch);
+    else
+      putchar(ch);
+  }
+  putchar('"');
+}
+
+// Writes an ID, using null for NoId
+static void printId(uint32_t Id) {
+  if (Id == NoId)
+    printf("null");
+  else
+    printf("%u", Id);
+}
+
+// Writes an encoded address (see DepFormat.h)
+static void printAddress(uint32_t Address) {
+  if (Address == QueryPointer)
+    printf("\"query\"");
+  else if (Address != NoId && (Address & ArgumentFlag))
+    printf("{\"arg\":%u}", Address & ~ArgumentFlag);
+  else
+    printId(Address);
+}
+
+static void printRecord(const DepRecordView &R) {
+  printf("{\"function\":%u,\"name\":", R.functionId());
+  printString(R.name(), R.nameLength());
+  printf(",\"blocks\":%u,\"insts\":%u,\"block_starts\":[", R.numBlocks(),
+      R.numInsts());
+  for (uint32_t i = 0; i <= R.numBlocks(); ++i)
+    printf("%s%u", i ? "," : "", R.blockStarts()[i]);
+  putchar(']');
+
+  printf(",\"local\":[");
+  for (uint32_t i = 0; i < R.numLocal(); ++i) {
+    const LocalDep &L = R.localDeps()[i];
+    printf("%s[%u,", i ? "," : "", L.Inst);
+    printId(L.DepInst);
+    printf(",\"%s\"]", typeName(L.Type));
+  }
+  putchar(']');
+
+  printf(",\"nonlocal\":[");
+  for (uint32_t s = 0; s < R.numNonLocalInsts(); ++s) {
+    const NonLocalSpan &span = R.nonLocalSpans()[s];
+    printf("%s[%u,[", s ? "," : "", span.Inst);
+    for (uint32_t j = 0; j < span.Count; ++j) {
+      const NonLocalDep &D = R.nonLocalResults()[span.First + j];
+      printf("%s[", j ? "," : "");
+      printId(D.Block);
+      putchar(',');
+      printId(D.DepInst);
+      printf(",\"%s\",", typeName(D.Type));
+      printAddress(D.Address);
+      putchar(']');
+    }
+    printf("]]");
+  }
+  putchar(']');
+
+  printf(",\"control\":[");
+  bool first = true;
+  for (uint32_t b = 0; b < R.numBlocks(); ++b) {
+    uint32_t count;
+    const uint32_t *deps = DepResults::getDependents(R, b, count);
+    if (count == 0)
+      continue;
+    printf("%s[%u,[", first ? "" : ",", b);
+    for (uint32_t j = 0; j < count; ++j)
+      printf("%s%u", j ? "," : "", deps[j]);
+    printf("]]");
+    first = false;
+  }
+  putchar(']');
+
+  printf(",\"control_branches\":[");
+  for (uint32_t i = 0; i < R.numCDBranches(); ++i) {
+    const CDBranch &B = R.cdBranches()[i];
+    printf("%s[%u,%u,%u]", i ? "," : "", B.Controller, B.Dependent,
+        B.Successor);
+  }
+  printf("]}\n");
+}
+
+int main(int argc, char **argv) {
+  bool diff = argc == 3 && strcmp(argv[1], "-diff") == 0;
+  if (argc != 2 && !diff) {
+    fprintf(stderr, "usage: %s [-diff] <file>\n", argv[0]);
+    return 1;
+  }
+  const char *path = argv[argc - 1];
+
+  DepResults results;
+  std::string error;
+  if (!results.open(path, &error)) {
+    fprintf(stderr, "error: %s\n", error.c_str());
+    return 1;
+  }
+  if (results.isDiff() != diff) {
+    fprintf(stderr, "error: %s\n", diff ? "not a diff file"
+        : "unexpected diff file");
+    return 1;
+  }
+
+  for (uint32_t i = 0; i < results.numFunctions(); ++i) {
+    const DepRecordView *R = results.getRecord(i);
+    if (R == NULL) {
+      fprintf(stderr, "error: malformed record %u\n", i);
+      return 1;
+    }
+
+    // The index lookup must find the same record
+    if (results.getFunction(R->functionId()) != R) {
+      fprintf(stderr, "error: function %u not found in the index\n",
+          R->functionId());
+      return 1;
+    }
+    printRecord(*R);
+  }
+  return 0;
+}
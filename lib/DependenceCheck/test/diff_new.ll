@@ -0,0 +1,11 @@
+; The new version of diff_old.ll (see there)
+
+@A = global i32 0, align 4
+@B = global i32 0, align 4
+
+define i32 @f() nounwind {
+entry:
+  store i32 1, i32* @B, align 4
+  %v = load i32* @A, align 4
+  ret i32 %v
+}
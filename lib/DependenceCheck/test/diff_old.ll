@@ -0,0 +1,19 @@
+; Regression input for -depcheck-diff-against and DepResults.h, the old
+; version of diff_new.ll. The load depends on the store (Def); in the new
+; version the store writes @B, so the load has no dependence in the
+; function (NonFuncLocal). The diff file has the removed Def and the added
+; NonFuncLocal of the load; the NonFuncLocal of the store is unchanged.
+;
+;  opt -load DependenceCheck.so -depcheck -depcheck-diff-against=diff_old.bc \
+;      -depcheck-diff-out=diff.bin -disable-output <diff_new.bc
+;  depresults_check -diff diff.bin
+
+@A = global i32 0, align 4
+@B = global i32 0, align 4
+
+define i32 @f() nounwind {
+entry:
+  store i32 1, i32* @A, align 4
+  %v = load i32* @A, align 4
+  ret i32 %v
+}
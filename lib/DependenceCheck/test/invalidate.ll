@@ -0,0 +1,39 @@
+; Regression input for invalidation. -depcheck-query queries both functions,
+; invalidates @f as a transform that changed it would, and queries both
+; again: only the data dependencies of @f are calculated a second time and
+; its control dependence graph is reused since its CFG did not change. With
+; -stats, 3 functions have their data dependencies calculated, 2 control
+; dependence graphs are built and 1 is reused.
+;
+;  opt -basicaa -load DependenceCheck.so -depcheck-lazy -depcheck-query \
+;      -depcheck-query-invalidate=f -stats -disable-output <invalidate.bc
+
+@A = global i32 0, align 4
+
+define i32 @f(i32 %x) nounwind {
+entry:
+  %cmp = icmp sgt i32 %x, 0
+  br i1 %cmp, label %then, label %join
+
+then:
+  store i32 %x, i32* @A, align 4
+  br label %join
+
+join:
+  %v = load i32* @A, align 4
+  ret i32 %v
+}
+
+define i32 @g(i32 %x) nounwind {
+entry:
+  %cmp = icmp eq i32 %x, 0
+  br i1 %cmp, label %then, label %join
+
+then:
+  store i32 0, i32* @A, align 4
+  br label %join
+
+join:
+  %v = load i32* @A, align 4
+  ret i32 %v
+}
@@ -0,0 +1,53 @@
+; Regression input for the loop dependencies (-depcheck-loop-deps). In
+; @increment every iteration reads and writes only A[i], so both pairs are
+; loop independent and the loop is parallel. In @shift the iteration i reads
+; A[i] and writes A[i + 1], which the next iteration reads: the load depends
+; on the store of the previous iteration (distance 1) and the store on the
+; load of the next one (distance -1), so the loop is not parallel.
+;
+; MemoryDependenceAnalysis cannot translate most of these addresses around
+; the back edge and reports Unknown for them; those accesses are paired
+; with the accesses of the loop they could conflict with.
+;
+;  opt -basicaa -analyze -load DependenceCheck.so -depcheck \
+;      -depcheck-loop-deps <loop.bc
+
+target datalayout = "e-p:64:64:64-i32:32:32-i64:64:64"
+
+@A = global [100 x i32] zeroinitializer, align 16
+
+define void @increment() nounwind {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds [100 x i32]* @A, i64 0, i64 %i
+  %v = load i32* %p, align 4
+  %add = add nsw i32 %v, 1
+  store i32 %add, i32* %p, align 4
+  %i.next = add nsw i64 %i, 1
+  %done = icmp eq i64 %i.next, 100
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+define void @shift() nounwind {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %p = getelementptr inbounds [100 x i32]* @A, i64 0, i64 %i
+  %v = load i32* %p, align 4
+  %i.next = add nsw i64 %i, 1
+  %q = getelementptr inbounds [100 x i32]* @A, i64 0, i64 %i.next
+  store i32 %v, i32* %q, align 4
+  %done = icmp eq i64 %i.next, 99
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
@@ -24,8 +24,113 @@ DEPCHECK=/home/markus/src/dependence/install/lib/DependenceCheck.so
 #opt -analyze -basicaa -print-memdeps <non_local.bc >non_local.results
 #$OPT --version
 
-echo "Running: $OPT -analyze -basicaa -load $DEPCHECK -depcheck <simple.bc"
+echo "Running: $OPT -basicaa -memdep -analyze -load $DEPCHECK -depcheck <simple.bc"
 $OPT -basicaa -memdep -analyze -load $DEPCHECK -depcheck <simple.bc >simple.results
 
 #echo  "Running : $OPT -basicaa -memdep -analyze -load $DEPCHECK -depcheck <non_local.bc >non_local.results"
 #$OPT -basicaa -memdep -analyze -load $DEPCHECK -depcheck <non_local.bc >non_local.results
+
+# budget.ll: a query cut short by the budget has no instruction (only the
+# data dependencies are compared)
+echo "Running: $OPT -basicaa -memdep -analyze -load $DEPCHECK -depcheck -depcheck-max-query-blocks=1 <budget.bc"
+$OPT -basicaa -memdep -analyze -load $DEPCHECK -depcheck -depcheck-max-query-blocks=1 <budget.bc \
+  | sed -n '/^Local Dependence map size/,/^BasicBlock:/p' | grep -v '^BasicBlock:' >budget.out
+diff -u budget.results budget.out
+
+# call_batch.ll: the second call shares the results of the first (-stats)
+echo "Running: $OPT -basicaa -memdep -analyze -stats -load $DEPCHECK -depcheck <call_batch.bc"
+$OPT -basicaa -memdep -analyze -stats -load $DEPCHECK -depcheck <call_batch.bc 2>call_batch_stats.log \
+  | sed -n '/^Local Dependence map size/,/^BasicBlock:/p' | grep -v '^BasicBlock:' >call_batch.out
+diff -u call_batch.results call_batch.out
+grep 'call dependence queries\|call queries answered' call_batch_stats.log \
+  | sed 's/^ *//; s/  */ /g' | sort >call_batch_stats.out
+diff -u call_batch_stats.results call_batch_stats.out
+
+# DependenceQuery.cpp: another pass asking DependenceCheck through its API
+echo "Running: $OPT -basicaa -load $DEPCHECK -depcheck-lazy -depcheck-query -disable-output <budget.bc"
+$OPT -basicaa -load $DEPCHECK -depcheck-lazy -depcheck-query -disable-output <budget.bc >query.out
+diff -u query.results query.out
+
+# invalidate.ll: only the invalidated function is recalculated and its CDG is
+# reused (-stats, with the columns squeezed and the lines sorted)
+echo "Running: $OPT -basicaa -load $DEPCHECK -depcheck-lazy -depcheck-query -depcheck-query-invalidate=f -stats -disable-output <invalidate.bc"
+$OPT -basicaa -load $DEPCHECK -depcheck-lazy -depcheck-query -depcheck-query-invalidate=f -stats -disable-output <invalidate.bc 2>&1 >/dev/null \
+  | grep 'control dependence graphs\|data dependencies were calculated' \
+  | sed 's/^ *//; s/  */ /g' | sort >invalidate.out
+diff -u invalidate.results invalidate.out
+
+# loop.ll: a parallel and a loop-carried loop (only the loop nests are
+# compared)
+echo "Running: $OPT -basicaa -analyze -load $DEPCHECK -depcheck -depcheck-loop-deps <loop.bc"
+$OPT -basicaa -analyze -load $DEPCHECK -depcheck -depcheck-loop-deps <loop.bc \
+  | sed -n '/^Loop nest/,/^BasicBlock:/p' | grep -v '^BasicBlock:' >loop.out
+diff -u loop.results loop.out
+
+# cache.ll: the second run restores both functions from the cache and the
+# run on cache_changed.ll only analyzes the changed @g. Results cut short by
+# a budget (budget.ll) are never stored. (-stats of each run, squeezed and
+# sorted)
+cache_stats() {
+  echo "run: $*"
+  $OPT -basicaa -load $DEPCHECK -depcheck -stats -disable-output "$@" 2>&1 >/dev/null \
+    | grep 'cache' | sed 's/^ *//; s/  */ /g' | sort
+}
+rm -rf cache.dir budget_cache.dir
+echo "Running: $OPT -basicaa -load $DEPCHECK -depcheck -stats -disable-output -depcheck-cache=cache.dir <cache.bc (twice, then <cache_changed.bc)"
+{
+  cache_stats -depcheck-cache=cache.dir <cache.bc
+  cache_stats -depcheck-cache=cache.dir <cache.bc
+  cache_stats -depcheck-cache=cache.dir <cache_changed.bc
+  cache_stats -depcheck-cache=budget_cache.dir -depcheck-max-query-blocks=1 <budget.bc
+  cache_stats -depcheck-cache=budget_cache.dir -depcheck-max-query-blocks=1 <budget.bc
+} >cache.out
+diff -u cache.results cache.out
+
+# depresults_check.cpp: a binary export read back through DepResults.h is
+# the same as the JSON lines export, a diff file (diff_old.ll and
+# diff_new.ll) reads back as diff.results, and a truncated file and a record
+# whose size was zeroed are rejected (run make depresults_check first)
+echo "Running: $OPT -basicaa -load $DEPCHECK -depcheck -depcheck-export=budget.bin -disable-output <budget.bc (and -depcheck-export-format=jsonl)"
+$OPT -basicaa -load $DEPCHECK -depcheck -depcheck-export=budget.bin -disable-output <budget.bc
+$OPT -basicaa -load $DEPCHECK -depcheck -depcheck-export=budget.jsonl -depcheck-export-format=jsonl -disable-output <budget.bc
+./depresults_check budget.bin >budget_dump.out
+diff -u budget.jsonl budget_dump.out
+
+echo "Running: $OPT -load $DEPCHECK -depcheck -depcheck-diff-against=diff_old.bc -depcheck-diff-out=diff.bin -disable-output <diff_new.bc"
+$OPT -load $DEPCHECK -depcheck -depcheck-diff-against=diff_old.bc -depcheck-diff-out=diff.bin -disable-output <diff_new.bc
+./depresults_check -diff diff.bin >diff.out
+diff -u diff.results diff.out
+
+head -c 100 budget.bin >truncated.bin
+cp budget.bin zero_size.bin
+printf '\0\0\0\0' | dd of=zero_size.bin bs=1 seek=12 conv=notrunc 2>/dev/null
+{
+  echo "truncated:"
+  ./depresults_check truncated.bin 2>&1 >/dev/null && echo "accepted"
+  echo "zero record size:"
+  ./depresults_check zero_size.bin 2>&1 >/dev/null && echo "accepted"
+} >malformed.out
+diff -u malformed.results malformed.out
+
+# DepServer.h: a scripted session of -depcheck-serve on budget.bc (block and
+# instruction IDs in budget.ll), a line longer than the server accepts and a
+# request after it on a second connection, and shutdown on a third
+echo "Running: $OPT -basicaa -load $DEPCHECK -depcheck -depcheck-serve=dep.sock -disable-output <budget.bc"
+rm -f dep.sock
+$OPT -basicaa -load $DEPCHECK -depcheck -depcheck-serve=dep.sock -disable-output <budget.bc &
+server=$!
+tries=0
+while [ ! -S dep.sock ] && [ $tries -lt 30 ]; do
+  sleep 1
+  tries=$((tries + 1))
+done
+{
+  printf '%s\n' 'info main' 'deps main 0' 'deps main 2' 'cdeps main 0' \
+    'cdeps main 1' 'controllers main 1' 'controllers main 3' \
+    'slice main backward 6' 'slice main forward 2' 'deps main 99' \
+    'frobnicate' 'info nosuch' 'quit' | nc -U dep.sock
+  { head -c 1100000 /dev/zero | tr '\0' 'a'; printf '\nquit\n'; } | nc -U dep.sock
+  printf 'shutdown\n' | nc -U dep.sock
+} >server.out
+wait $server
+diff -u server.results server.out